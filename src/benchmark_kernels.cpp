@@ -0,0 +1,183 @@
+#include <CLI/CLI.hpp>
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "log_macros.h"
+#include "data_tools/simd_kernels.h"
+#include "data_tools/data_row.h"
+#include "data_tools/row_kernels.h"
+#include "data_tools/dense_matrix.h"
+#include "representative_subset_calculator/kernel_matrix/relevance_calculator.h"
+
+struct BenchmarkAppData {
+    size_t columns = 1024;
+    size_t nonZeros = 64;
+    size_t shortLength = 20;
+    size_t repetitions = 1000000;
+    size_t rows = 4096;
+};
+
+static void addCmdOptions(CLI::App &app, BenchmarkAppData &appData) {
+    app.add_option("--columns", appData.columns, "Length of the dense rows, also the number of columns sparse rows are gathered from.");
+    app.add_option("--nonZeros", appData.nonZeros, "Number of non zeros in the sparse row.");
+    app.add_option("--shortLength", appData.shortLength, "Length of the short vectors, like the c_i * c_j products of fast greedy. Usually the size of the subset.");
+    app.add_option("--repetitions", appData.repetitions, "Number of times each kernel is called.");
+    app.add_option("--rows", appData.rows, "Rows of the dense dataset used to time NaiveRelevanceCalculator::get against random pairs.");
+}
+
+/**
+ * Calls kernel repetitions times and returns the average nanoseconds per call.
+ */
+template <typename Kernel>
+static double timeKernel(const size_t repetitions, Kernel kernel) {
+    volatile float sink = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < repetitions; i++) {
+        sink = sink + kernel();
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / repetitions;
+}
+
+int main(int argc, char** argv) {
+    LoggerHelper::setupLoggers();
+    CLI::App app{"Times the dot product kernels at every SIMD level this CPU supports."};
+    BenchmarkAppData appData;
+    addCmdOptions(app, appData);
+    CLI11_PARSE(app, argc, argv);
+
+    if (appData.columns == 0 || appData.nonZeros > appData.columns) {
+        throw std::invalid_argument("columns must be greater than 0 and at least nonZeros");
+    }
+
+    std::default_random_engine eng(0);
+    std::normal_distribution<float> distribution;
+    std::uniform_int_distribution<unsigned int> column(0, appData.columns - 1);
+    std::vector<float> a(appData.columns), b(appData.columns), values(appData.nonZeros);
+    std::vector<unsigned int> columns(appData.nonZeros);
+    for (size_t i = 0; i < appData.columns; i++) {
+        a[i] = distribution(eng);
+        b[i] = distribution(eng);
+    }
+    for (size_t i = 0; i < appData.nonZeros; i++) {
+        values[i] = distribution(eng);
+        columns[i] = column(eng);
+    }
+    std::sort(columns.begin(), columns.end());
+    const size_t shortLength = std::min(appData.shortLength, appData.columns);
+
+    spdlog::info("active SIMD level is {}", SimdKernels::toString(SimdKernels::active().level));
+
+    double scalarDense = 0, scalarGather = 0, scalarShort = 0;
+    for (const SimdLevel level : {SimdLevel::SCALAR, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        if (!SimdKernels::supports(level)) {
+            spdlog::info("{} is not supported on this CPU", SimdKernels::toString(level));
+            continue;
+        }
+
+        const SimdKernels::Table kernels(SimdKernels::forLevel(level));
+        const double dense = timeKernel(appData.repetitions, [&]() {
+            return kernels.dot(a.data(), b.data(), appData.columns);
+        });
+        const double gather = timeKernel(appData.repetitions, [&]() {
+            return kernels.gatherDot(a.data(), columns.data(), values.data(), appData.nonZeros);
+        });
+        const double shortDot = timeKernel(appData.repetitions, [&]() {
+            return kernels.dot(a.data(), b.data(), shortLength);
+        });
+
+        if (level == SimdLevel::SCALAR) {
+            scalarDense = dense;
+            scalarGather = gather;
+            scalarShort = shortDot;
+        }
+
+        spdlog::info(
+            "{0}: dense {1:.2f}ns ({2:.2f}x), sparse gather {3:.2f}ns ({4:.2f}x), short {5:.2f}ns ({6:.2f}x)",
+            SimdKernels::toString(level),
+            dense, scalarDense / dense,
+            gather, scalarGather / gather,
+            shortDot, scalarShort / shortDot
+        );
+    }
+
+    // The same products, through DataRow::dotProduct and through rows resolved once.
+    std::vector<unsigned int> otherColumns(appData.nonZeros);
+    std::vector<float> otherValues(appData.nonZeros);
+    for (size_t i = 0; i < appData.nonZeros; i++) {
+        otherColumns[i] = column(eng);
+        otherValues[i] = distribution(eng);
+    }
+    std::sort(otherColumns.begin(), otherColumns.end());
+
+    std::vector<std::unique_ptr<DataRow>> rows;
+    rows.push_back(std::unique_ptr<DataRow>(new DenseDataRowView(a.data(), appData.columns)));
+    rows.push_back(std::unique_ptr<DataRow>(new DenseDataRowView(b.data(), appData.columns)));
+    rows.push_back(std::unique_ptr<DataRow>(new SparseDataRowView(columns.data(), values.data(), appData.nonZeros, appData.columns)));
+    rows.push_back(std::unique_ptr<DataRow>(new SparseDataRowView(otherColumns.data(), otherValues.data(), appData.nonZeros, appData.columns)));
+    std::vector<RowRef> refs;
+    for (const auto & row : rows) {
+        refs.push_back(RowRef::of(*row));
+    }
+
+    const std::vector<std::pair<std::string, std::pair<size_t, size_t>>> pairs({
+        {"dense/dense", {0, 1}},
+        {"dense/sparse", {0, 2}},
+        {"sparse/sparse", {2, 3}}
+    });
+    for (const auto & pair : pairs) {
+        const DataRow &x(*rows[pair.second.first]);
+        const DataRow &y(*rows[pair.second.second]);
+        const RowRef &xRef(refs[pair.second.first]);
+        const RowRef &yRef(refs[pair.second.second]);
+
+        const double visitor = timeKernel(appData.repetitions, [&]() {
+            return x.dotProduct(y);
+        });
+        const double resolved = timeKernel(appData.repetitions, [&]() {
+            return RowRef::dot(xRef, yRef);
+        });
+
+        spdlog::info(
+            "{0}: visitor {1:.2f}ns, resolved rows {2:.2f}ns, {3:.2f}ns saved per call",
+            pair.first, visitor, resolved, visitor - resolved
+        );
+    }
+
+    // Random pairs of a whole dataset, as NaiveRelevanceCalculator::get sees them.
+    std::vector<std::vector<float>> raw(appData.rows, std::vector<float>(appData.columns));
+    for (auto & row : raw) {
+        for (auto & v : row) {
+            v = distribution(eng);
+        }
+    }
+    std::unique_ptr<DenseMatrixData> data(DenseMatrixData::load(raw));
+    NaiveRelevanceCalculator calc(*data);
+    std::uniform_int_distribution<size_t> pick(0, appData.rows - 1);
+    std::vector<std::pair<size_t, size_t>> indices(4096);
+    for (auto & index : indices) {
+        index = {pick(eng), pick(eng)};
+    }
+
+    size_t next = 0;
+    const double visitorGet = timeKernel(appData.repetitions, [&]() {
+        const auto & index = indices[next++ % indices.size()];
+        return data->getRow(index.first).dotProduct(data->getRow(index.second));
+    });
+    next = 0;
+    const double resolvedGet = timeKernel(appData.repetitions, [&]() {
+        const auto & index = indices[next++ % indices.size()];
+        return calc.get(index.first, index.second);
+    });
+
+    spdlog::info(
+        "dataset get: visitor {0:.2f}ns, resolved dataset {1:.2f}ns, {2:.2f}ns saved per call",
+        visitorGet, resolvedGet, visitorGet - resolvedGet
+    );
+
+    return 0;
+}
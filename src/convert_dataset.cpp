@@ -0,0 +1,64 @@
+#include <CLI/CLI.hpp>
+
+#include <fstream>
+#include <chrono>
+
+#include "log_macros.h"
+#include "data_tools/dataset_converter.h"
+
+struct ConvertAppData {
+    std::string inputFile;
+    std::string outputFile;
+    unsigned int adjacencyListColumnCount = 0;
+    bool doNotNormalize = false;
+    size_t chunkLines = DatasetConverter::DEFAULT_CHUNK_LINES;
+};
+
+static void addCmdOptions(CLI::App &app, ConvertAppData &appData) {
+    app.add_option("-i,--input", appData.inputFile, "Path to the text input file. Should contain data in row vector format, or an adjacency list.")->required();
+    app.add_option("-o,--output", appData.outputFile, "Path to write the binary dataset to. Load it with --loadBinary.")->required();
+    app.add_option("--adjacencyListColumnCount", appData.adjacencyListColumnCount, "To convert an adjacnency list, set this value to the number of columns per row expected in the underlying matrix.");
+    app.add_flag("--doNotNormalize", appData.doNotNormalize, "Store rows as they are in the input. By default rows are normalized once here so later loads can skip normalization.");
+    app.add_option("--chunkLines", appData.chunkLines, "The number of lines that are read and then parsed in parallel at a time.");
+}
+
+int main(int argc, char** argv) {
+    LoggerHelper::setupLoggers();
+    CLI::App app{"Converts a text dataset into the memory mapped binary dataset format."};
+    ConvertAppData appData;
+    addCmdOptions(app, appData);
+    CLI11_PARSE(app, argc, argv);
+
+    if (appData.chunkLines == 0) {
+        throw std::invalid_argument("chunkLines must be greater than 0");
+    }
+
+    std::ifstream inputFile(appData.inputFile);
+    if (!inputFile.is_open()) {
+        throw std::invalid_argument("Could not open the input file");
+    }
+
+    std::ofstream outputFile(appData.outputFile, std::ios::binary);
+    if (!outputFile.is_open()) {
+        throw std::invalid_argument("Could not open the output file");
+    }
+
+    spdlog::info("Converting {0} with {1:d} threads...", appData.inputFile, omp_get_max_threads());
+    const auto start = std::chrono::steady_clock::now();
+
+    DatasetConverter::convert(
+        inputFile, 
+        outputFile, 
+        appData.adjacencyListColumnCount, 
+        !appData.doNotNormalize, 
+        appData.chunkLines
+    );
+
+    inputFile.close();
+    outputFile.close();
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    spdlog::info("Wrote {0} in {1:f} seconds", appData.outputFile, elapsed.count());
+
+    return 0;
+}
@@ -41,6 +41,8 @@ struct GenUserFileAppData {
 
     std::string userListFile = NO_FILE_SPECIFIED;
     float topU;
+
+    size_t kernelCacheBytes = 1ULL << 30;
 };
 
 static void addCmdOptions(CLI::App &app, GenUserFileAppData &appData) {
@@ -52,6 +54,7 @@ static void addCmdOptions(CLI::App &app, GenUserFileAppData &appData) {
     app.add_option("--rowNonZeros", appData.numberOfRowNonZeros, "The number of row nonzeros required for a row to be considered. All other rows are dropped")->required();
     app.add_option("--columnsNonZeros", appData.numberOfColumnNonZeros, "The number of column nonzeros required for a column to be considered. All other columns are dropped")->required();
     app.add_option("--topN", appData.topN, "The number of elements to consider for CU per element in PU")->required();
+    app.add_option("--kernelCacheBytes", appData.kernelCacheBytes, "Most bytes of kernel matrix entries to keep cached between comparisons. Evicted entries are recomputed when needed again. Defaults to 1GiB.");
 
     CLI::App *usersFromFileCommand = app.add_subcommand("usersFromFile", "User this command if you have a set of users you want to generate usermode data for.");
     CLI::App *topUsersCommand = app.add_subcommand("topUsers", "Use this command if you want to generate usermode data for the top users in the dataset.");
@@ -240,17 +243,10 @@ int main(int argc, char** argv) {
         throw std::invalid_argument("topU cannot be greater than 1.0");
     }
 
-    std::ifstream inputFile;
-    inputFile.open(appData.inputFile);
-    std::unique_ptr<LineFactory> getter(
-        std::unique_ptr<FromFileLineFactory>(
-            new FromFileLineFactory(inputFile)
-        )
-    );
+    std::unique_ptr<LineFactory> getter(MappedFileLineFactory::open(appData.inputFile));
 
     std::unique_ptr<DataRowFactory> factory(Orchestrator::getDataRowFactory(appData.adjacencyListColumnCount, true));
     std::unique_ptr<FullyLoadedData> data(FullyLoadedData::load(*factory, *getter));
-    inputFile.close();
 
     spdlog::info("Finished loading dataset of rows {0:d} and columns {1:d} ...", data->totalRows(), data->totalColumns());
 
@@ -274,6 +270,10 @@ int main(int argc, char** argv) {
 
     spdlog::info("dropped {0:d} columns from the underlying dataset", removeSet.size());
 
+    // The top N search compares rows against nearly every other row, so each of those rows is
+    //  summed from the rows that share one of its columns instead of merged with every row.
+    data->buildColumnIndex();
+
     std::vector<size_t> v(columnsToEvaluate.begin(), columnsToEvaluate.end());
     std::unordered_set<size_t> usersToEvaluate(appData.userListFile == NO_FILE_SPECIFIED ? selectTopUsers(appData, *data, v) : loadUsersFromFile(appData, *data, columnsToEvaluate));
 
@@ -317,7 +317,9 @@ int main(int argc, char** argv) {
     std::vector<size_t> userList(usersToEvaluate.begin(), usersToEvaluate.end());
 
     std::unique_ptr<NaiveRelevanceCalculator> calc(NaiveRelevanceCalculator::from(*data));
-    std::unique_ptr<LazyKernelMatrix> matrix(ThreadSafeLazyKernelMatrix::from(*data, *calc));
+    std::unique_ptr<CachedLazyKernelMatrix> matrix(CachedLazyKernelMatrix::from(*data, *calc, appData.kernelCacheBytes));
+    Timers timers;
+    timers.recordKernelMatrixBytes(matrix->getStorageBytes());
 
     #pragma omp parallel for
     for (size_t k = 0; k < userList.size(); k++) {
@@ -328,15 +330,20 @@ int main(int argc, char** argv) {
         const std::unordered_set<size_t> elements_in_pu(pu.begin(), pu.end());
         std::unordered_set<size_t> cu;
 
+        // Every row of pu is compared against the same candidates, everything outside of pu.
+        std::vector<size_t> candidates;
+        for (const size_t j : rowsToEvaluate) {
+            if (elements_in_pu.find(j) == elements_in_pu.end()) {
+                candidates.push_back(j);
+            }
+        }
+        std::vector<float> candidateScores(candidates.size());
+
         for (const size_t i : pu) {
+            matrix->getRow(i, candidates.data(), candidates.size(), candidateScores.data());
             std::vector<std::pair<size_t, double>> scores;
-            for (const size_t j : rowsToEvaluate) {
-                if (i == j || elements_in_pu.find(j) != elements_in_pu.end()) {
-                    continue;
-                }
-
-                const double score = matrix->get(i, j);
-                scores.push_back({j, score});
+            for (size_t t = 0; t < candidates.size(); t++) {
+                scores.push_back({candidates[t], candidateScores[t]});
             }
 
             auto comp = [](auto &left, auto &right) {
@@ -365,10 +372,13 @@ int main(int argc, char** argv) {
         const size_t u = userList[k];
         std::unordered_map<size_t, double> ru;
         double magnitude = 0.0;
+        const std::vector<size_t>& pu = p[u];
+        std::vector<float> puScores(pu.size());
         for (const size_t cu_i : c[u]) {
+            matrix->getRow(cu_i, pu.data(), pu.size(), puScores.data());
             double score = 0.0;
-            for (const size_t pu_j : p[u]) {
-                score += matrix->get(cu_i, pu_j);
+            for (const float puScore : puScores) {
+                score += puScore;
             }
             ru.insert({cu_i, score});
             magnitude += std::pow(score, 2);
@@ -382,6 +392,10 @@ int main(int argc, char** argv) {
         r[u] = std::move(ru);
     }
 
+    const KernelCache::Counters counters(matrix->getCounters());
+    timers.recordKernelCache(counters.hits, counters.misses, counters.evictions);
+    spdlog::info("timers: {}", timers.outputToJson().dump());
+
     // Order of information per row
     // UID TID LCU CU1 CU2 ... CU_LCU RU1 ... RU_LRU
     // UID: User ID
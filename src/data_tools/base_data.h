@@ -9,6 +9,9 @@
 #include "data_row.h"
 #include "data_row_visitor.h"
 #include "data_row_factory.h"
+#include "compressed_sparse_rows.h"
+#include "inverted_column_index.h"
+#include "dense_matrix.h"
 #include "../representative_subset_calculator/representative_subset.h"
 
 #ifndef BASE_DATA_H
@@ -17,9 +20,13 @@
 struct diagnostics {
     float sparsity;
     size_t numberOfNonEmptyCells;
+    size_t storageBytes;
 } typedef Diagnostics;
 
 class BaseData {
+    private:
+    std::unique_ptr<const InvertedColumnIndex> columnIndex;
+
     public:
     virtual ~BaseData() {}
     /**
@@ -35,6 +42,26 @@ class BaseData {
     virtual size_t getRemoteIndexForRow(const size_t localRowIndex) const = 0; 
     virtual size_t getLocalIndexFromGlobalIndex(const size_t globalIndex) const = 0;
 
+    /**
+     * Indexes the rows of this dataset by column, see getColumnIndex. Only call this once every
+     *  row is loaded, rows that change afterwards are not reflected in the index.
+     */
+    void buildColumnIndex() {
+        this->columnIndex = InvertedColumnIndex::fromDataRows(
+            this->totalRows(), 
+            this->totalColumns(), 
+            [this](const size_t i) -> const DataRow& { return this->getRow(i); }
+        );
+    }
+
+    /**
+     * The index built by buildColumnIndex, by local row, or nullptr if none was built. Datasets 
+     *  that wrap another dataset do not share its index.
+     */
+    const InvertedColumnIndex* getColumnIndex() const {
+        return this->columnIndex.get();
+    }
+
     void print_DEBUG() const {
         class PrintVisitor : public DataRowVisitor {
             public:
@@ -64,33 +91,55 @@ class BaseData {
     Diagnostics DEBUG_getDiagnostics() const {
         size_t rows = this->totalRows();
         if (rows == 0) {
-            return Diagnostics{0, 0};
+            return Diagnostics{0, 0, 0};
         }
 
+        /**
+         * Storage is estimated from the layout of each row type rather than measured. Rows held
+         * through a unique_ptr also pay for that pointer.
+         */
         class DiagnosticsVisitor : public ReturningDataRowVisitor<Diagnostics> {
             private:
             std::vector<float> sparsity;
             size_t totalNonEmptyCells;
+            size_t storageBytes;
             size_t i;
             
             public:
             DiagnosticsVisitor(size_t rows) 
-            : sparsity(rows), i(0), totalNonEmptyCells(0) {}
+            : sparsity(rows), i(0), totalNonEmptyCells(0), storageBytes(0) {}
 
             void visitDenseDataRow(const std::vector<float>& data) {
                 sparsity[i++] = 0.0;
                 totalNonEmptyCells += data.size();
+                storageBytes += sizeof(std::unique_ptr<DataRow>) + sizeof(DenseDataRow) + data.capacity() * sizeof(float);
             }
 
             void visitSparseDataRow(const std::map<size_t, float>& data, size_t totalColumns) {
                 sparsity[i++] = (float)((float)(totalColumns - data.size()) / (float)totalColumns);
                 totalNonEmptyCells += data.size();
+                // libstdc++ red-black tree node header followed by the key/value pair
+                const size_t mapNodeBytes = 32 + sizeof(std::pair<const size_t, float>);
+                storageBytes += sizeof(std::unique_ptr<DataRow>) + sizeof(SparseDataRow) + data.size() * mapNodeBytes;
+            }
+
+            void visitSparseDataRowView(const unsigned int* _columns, const float* _values, const size_t nonZeros, const size_t totalColumns) {
+                sparsity[i++] = (float)((float)(totalColumns - nonZeros) / (float)totalColumns);
+                totalNonEmptyCells += nonZeros;
+                storageBytes += sizeof(SparseDataRowView) + sizeof(size_t) + nonZeros * (sizeof(unsigned int) + sizeof(float));
+            }
+
+            void visitDenseDataRowView(const float* _data, const size_t totalColumns) {
+                sparsity[i++] = 0.0;
+                totalNonEmptyCells += totalColumns;
+                storageBytes += sizeof(DenseDataRowView) + DenseMatrix::paddedColumns(totalColumns) * sizeof(float);
             }
 
             Diagnostics get() {
                 return Diagnostics{
                     std::accumulate(sparsity.begin(), sparsity.end(), (float)0.0) / sparsity.size(),
-                    totalNonEmptyCells
+                    totalNonEmptyCells,
+                    storageBytes
                 };
             }
         };
@@ -348,6 +397,249 @@ class LoadedSegmentedData : public BaseData {
     }
 };
 
+/**
+ * Holds the local partition of a sparse dataset in CSR format. Rows are handed out as 
+ * SparseDataRowViews into the shared arrays, so there is no per-row or per-non-zero allocation.
+ */
+class CompressedSparseRowData : public BaseData {
+    private:
+    const CompressedSparseRows storage;
+    const std::vector<SparseDataRowView> rows;
+    const std::vector<size_t> localRowToGlobalRow;
+
+    // Left empty when every row is loaded, in which case local rows are global rows.
+    const std::optional<std::unordered_map<size_t, size_t>> globalRowToLocalRow;
+
+    // Disable pass by value. This object is too large for pass by value to make sense implicitly.
+    //  Use an explicit constructor to pass by value.
+    CompressedSparseRowData(const BaseData&);
+
+    static std::vector<SparseDataRowView> buildViews(const CompressedSparseRows &storage) {
+        std::vector<SparseDataRowView> views;
+        views.reserve(storage.totalRows());
+        for (size_t i = 0; i < storage.totalRows(); i++) {
+            views.push_back(storage.getRow(i));
+        }
+
+        return views;
+    }
+
+    public:
+    static std::unique_ptr<BaseData> load(
+        DataRowFactory &factory, 
+        LineFactory &source, 
+        const size_t totalColumns
+    ) {
+        CompressedSparseRows storage(totalColumns);
+        std::vector<size_t> localRowToGlobalRow;
+        while (factory.maybeAppend(source, storage)) {
+            localRowToGlobalRow.push_back(localRowToGlobalRow.size());
+        }
+
+        storage.shrinkToFit();
+        return std::unique_ptr<BaseData>(
+            new CompressedSparseRowData(std::move(storage), std::move(localRowToGlobalRow), std::nullopt)
+        );
+    }
+
+    static std::unique_ptr<BaseData> load(
+        DataRowFactory &factory, 
+        LineFactory &source, 
+        const size_t totalColumns,
+        const std::vector<unsigned int> &rankMapping, 
+        const unsigned int rank
+    ) {
+        CompressedSparseRows storage(totalColumns);
+        std::vector<size_t> localRowToGlobalRow;
+        std::unordered_map<size_t, size_t> globalRowToLocalRow;
+
+        for (size_t globalRow = 0; globalRow < rankMapping.size(); globalRow++) {
+            if (rankMapping[globalRow] != rank) {
+                factory.skipNext(source);
+            } else {
+                if (!factory.maybeAppend(source, storage)) {
+                    throw std::invalid_argument("Retrieved nullptr which is unexpected during a multi-machine load. The number of rows you have provided was incorrect.");
+                }
+
+                globalRowToLocalRow.insert({globalRow, localRowToGlobalRow.size()});
+                localRowToGlobalRow.push_back(globalRow);
+            }
+        }
+
+        storage.shrinkToFit();
+        return std::unique_ptr<BaseData>(
+            new CompressedSparseRowData(std::move(storage), std::move(localRowToGlobalRow), std::move(globalRowToLocalRow))
+        );
+    }
+
+    CompressedSparseRowData(
+        CompressedSparseRows storage,
+        std::vector<size_t> localRowToGlobalRow,
+        std::optional<std::unordered_map<size_t, size_t>> globalRowToLocalRow
+    ) : 
+        storage(std::move(storage)), 
+        rows(buildViews(this->storage)),
+        localRowToGlobalRow(std::move(localRowToGlobalRow)), 
+        globalRowToLocalRow(std::move(globalRowToLocalRow)) 
+    {}
+
+    const DataRow& getRow(size_t i) const {
+        return this->rows[i];
+    }
+
+    size_t totalRows() const {
+        return this->rows.size();
+    }
+
+    size_t totalColumns() const {
+        return this->storage.getTotalColumns();
+    }
+
+    size_t getRemoteIndexForRow(const size_t localRowIndex) const {
+        return this->localRowToGlobalRow[localRowIndex];
+    }
+
+    size_t getLocalIndexFromGlobalIndex(const size_t globalIndex) const {
+        if (!this->globalRowToLocalRow.has_value()) {
+            return globalIndex;
+        }
+
+        const std::unordered_map<size_t, size_t> &mapping(this->globalRowToLocalRow.value());
+        if (mapping.find(globalIndex) == mapping.end()) {
+            spdlog::error("failed mapping for {0:d} out of {1:d} possible mappings", globalIndex, mapping.size());
+        }
+        return mapping.at(globalIndex);
+    }
+};
+
+/**
+ * Holds the local partition of a dense dataset in a single aligned row-major buffer. Rows are
+ * handed out as DenseDataRowViews, and kernels that know about this class can read the buffer
+ * directly through getMatrix().
+ */
+class DenseMatrixData : public BaseData {
+    private:
+    const DenseMatrix matrix;
+    const std::vector<DenseDataRowView> rows;
+    const std::vector<size_t> localRowToGlobalRow;
+
+    // Left empty when every row is loaded, in which case local rows are global rows.
+    const std::optional<std::unordered_map<size_t, size_t>> globalRowToLocalRow;
+
+    // Disable pass by value. This object is too large for pass by value to make sense implicitly.
+    //  Use an explicit constructor to pass by value.
+    DenseMatrixData(const BaseData&);
+
+    static std::vector<DenseDataRowView> buildViews(const DenseMatrix &matrix) {
+        std::vector<DenseDataRowView> views;
+        views.reserve(matrix.totalRows());
+        for (size_t i = 0; i < matrix.totalRows(); i++) {
+            views.push_back(matrix.getRow(i));
+        }
+
+        return views;
+    }
+
+    public:
+    static std::unique_ptr<BaseData> load(DataRowFactory &factory, LineFactory &source) {
+        DenseMatrix matrix;
+        std::vector<size_t> localRowToGlobalRow;
+        while (factory.maybeAppend(source, matrix)) {
+            localRowToGlobalRow.push_back(localRowToGlobalRow.size());
+        }
+
+        matrix.shrinkToFit();
+        return std::unique_ptr<BaseData>(
+            new DenseMatrixData(std::move(matrix), std::move(localRowToGlobalRow), std::nullopt)
+        );
+    }
+
+    static std::unique_ptr<BaseData> load(
+        DataRowFactory &factory, 
+        LineFactory &source, 
+        const std::vector<unsigned int> &rankMapping, 
+        const unsigned int rank
+    ) {
+        DenseMatrix matrix;
+        std::vector<size_t> localRowToGlobalRow;
+        std::unordered_map<size_t, size_t> globalRowToLocalRow;
+
+        for (size_t globalRow = 0; globalRow < rankMapping.size(); globalRow++) {
+            if (rankMapping[globalRow] != rank) {
+                factory.skipNext(source);
+            } else {
+                if (!factory.maybeAppend(source, matrix)) {
+                    throw std::invalid_argument("Retrieved nullptr which is unexpected during a multi-machine load. The number of rows you have provided was incorrect.");
+                }
+
+                globalRowToLocalRow.insert({globalRow, localRowToGlobalRow.size()});
+                localRowToGlobalRow.push_back(globalRow);
+            }
+        }
+
+        matrix.shrinkToFit();
+        return std::unique_ptr<BaseData>(
+            new DenseMatrixData(std::move(matrix), std::move(localRowToGlobalRow), std::move(globalRowToLocalRow))
+        );
+    }
+
+    static std::unique_ptr<DenseMatrixData> load(const std::vector<std::vector<float>> &raw) {
+        DenseMatrix matrix;
+        std::vector<size_t> localRowToGlobalRow;
+        for (const std::vector<float> &row : raw) {
+            matrix.append(DenseDataRowView(row.data(), row.size()));
+            localRowToGlobalRow.push_back(localRowToGlobalRow.size());
+        }
+
+        return std::unique_ptr<DenseMatrixData>(
+            new DenseMatrixData(std::move(matrix), std::move(localRowToGlobalRow), std::nullopt)
+        );
+    }
+
+    DenseMatrixData(
+        DenseMatrix matrix,
+        std::vector<size_t> localRowToGlobalRow,
+        std::optional<std::unordered_map<size_t, size_t>> globalRowToLocalRow
+    ) : 
+        matrix(std::move(matrix)), 
+        rows(buildViews(this->matrix)),
+        localRowToGlobalRow(std::move(localRowToGlobalRow)), 
+        globalRowToLocalRow(std::move(globalRowToLocalRow)) 
+    {}
+
+    const DenseMatrix &getMatrix() const {
+        return this->matrix;
+    }
+
+    const DataRow& getRow(size_t i) const {
+        return this->rows[i];
+    }
+
+    size_t totalRows() const {
+        return this->rows.size();
+    }
+
+    size_t totalColumns() const {
+        return this->matrix.getTotalColumns();
+    }
+
+    size_t getRemoteIndexForRow(const size_t localRowIndex) const {
+        return this->localRowToGlobalRow[localRowIndex];
+    }
+
+    size_t getLocalIndexFromGlobalIndex(const size_t globalIndex) const {
+        if (!this->globalRowToLocalRow.has_value()) {
+            return globalIndex;
+        }
+
+        const std::unordered_map<size_t, size_t> &mapping(this->globalRowToLocalRow.value());
+        if (mapping.find(globalIndex) == mapping.end()) {
+            spdlog::error("failed mapping for {0:d} out of {1:d} possible mappings", globalIndex, mapping.size());
+        }
+        return mapping.at(globalIndex);
+    }
+};
+
 class ReceivedData : public BaseData {
     private:
     std::unique_ptr<std::vector<std::pair<size_t, std::unique_ptr<DataRow>>>> base;
@@ -0,0 +1,340 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "base_data.h"
+#include "mapped_file.h"
+#include "dense_matrix.h"
+#include "compressed_sparse_rows.h"
+
+#ifndef BINARY_DATASET_H
+#define BINARY_DATASET_H
+
+/**
+ * Header at the start of every binary dataset. All sections start on a 64 byte boundary
+ * and every integer is stored in native (little endian) byte order.
+ *
+ *  [header][row offsets, rows + 1 uint64][payload]
+ *
+ * For dense datasets the payload is rows * stride floats where each row is zero padded to
+ * the stride, and row offsets are in floats. For sparse datasets the payload is nonZeros
+ * uint32 columns followed by nonZeros float values, and row offsets are in non-zeros.
+ */
+struct BinaryDatasetHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t kind;
+    uint32_t normalized;
+    uint32_t reserved;
+    uint64_t rows;
+    uint64_t columns;
+    uint64_t nonZeros;
+    uint64_t stride;
+    uint64_t offsetsStart;
+    uint64_t columnsStart;
+    uint64_t valuesStart;
+    uint64_t fileBytes;
+};
+
+class BinaryDataset {
+    public:
+    static constexpr const char* MAGIC = "RASTRE\0";
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t DENSE = 0;
+    static constexpr uint32_t SPARSE = 1;
+
+    static void write(std::ostream &output, const DenseMatrix &matrix, const bool normalized) {
+        BinaryDatasetHeader header(buildHeader(DENSE, matrix.totalRows(), matrix.getTotalColumns(), normalized));
+        header.stride = matrix.getStride();
+        header.nonZeros = matrix.totalRows() * matrix.getTotalColumns();
+        header.columnsStart = header.valuesStart;
+        header.fileBytes = header.valuesStart + header.rows * header.stride * sizeof(float);
+
+        std::vector<uint64_t> offsets(header.rows + 1);
+        for (size_t i = 0; i <= header.rows; i++) {
+            offsets[i] = i * header.stride;
+        }
+
+        writeHeaderAndOffsets(output, header, offsets);
+        for (size_t i = 0; i < header.rows; i++) {
+            output.write(reinterpret_cast<const char*>(matrix.getRowData(i)), header.stride * sizeof(float));
+        }
+    }
+
+    static void write(std::ostream &output, const CompressedSparseRows &rows, const bool normalized) {
+        BinaryDatasetHeader header(buildHeader(SPARSE, rows.totalRows(), rows.getTotalColumns(), normalized));
+        header.nonZeros = rows.nonZeros();
+        header.columnsStart = header.valuesStart;
+        header.valuesStart = align(header.columnsStart + header.nonZeros * sizeof(uint32_t));
+        header.fileBytes = header.valuesStart + header.nonZeros * sizeof(float);
+
+        std::vector<uint64_t> offsets(rows.getOffsets(), rows.getOffsets() + header.rows + 1);
+        writeHeaderAndOffsets(output, header, offsets);
+
+        output.write(reinterpret_cast<const char*>(rows.getColumns()), header.nonZeros * sizeof(uint32_t));
+        pad(output, header.columnsStart + header.nonZeros * sizeof(uint32_t), header.valuesStart);
+        output.write(reinterpret_cast<const char*>(rows.getValues()), header.nonZeros * sizeof(float));
+    }
+
+    /**
+     * Maps every row of the file without copying. Rows are only copied when the file was not
+     * normalized but normalization was requested.
+     */
+    static std::unique_ptr<BaseData> load(const std::string &path, const bool normalize) {
+        std::shared_ptr<MappedFile> file(MappedFile::open(path));
+        const BinaryDatasetHeader header(readHeader(*file));
+
+        if (normalize && !header.normalized) {
+            std::vector<unsigned int> rankMapping(header.rows, 0);
+            return copyRows(file, header, normalize, rankMapping, 0, false);
+        }
+
+        warnIfNormalized(header, normalize);
+        std::vector<size_t> localRowToGlobalRow(header.rows);
+        for (size_t i = 0; i < header.rows; i++) {
+            localRowToGlobalRow[i] = i;
+        }
+
+        if (header.kind == DENSE) {
+            const float* data = reinterpret_cast<const float*>(file->getData() + header.valuesStart);
+            DenseMatrix matrix(DenseMatrix::wrap(file, data, header.rows, header.columns, header.stride));
+            return std::unique_ptr<BaseData>(
+                new DenseMatrixData(std::move(matrix), std::move(localRowToGlobalRow), std::nullopt)
+            );
+        }
+
+        CompressedSparseRows rows(CompressedSparseRows::wrap(
+            file,
+            reinterpret_cast<const size_t*>(file->getData() + header.offsetsStart),
+            reinterpret_cast<const unsigned int*>(file->getData() + header.columnsStart),
+            reinterpret_cast<const float*>(file->getData() + header.valuesStart),
+            header.rows,
+            header.columns
+        ));
+        return std::unique_ptr<BaseData>(
+            new CompressedSparseRowData(std::move(rows), std::move(localRowToGlobalRow), std::nullopt)
+        );
+    }
+
+    /**
+     * Copies only the rows assigned to this rank, found through the row offset table, so no
+     * other part of the file is read.
+     */
+    static std::unique_ptr<BaseData> load(
+        const std::string &path,
+        const bool normalize,
+        const std::vector<unsigned int> &rankMapping,
+        const unsigned int rank
+    ) {
+        std::shared_ptr<MappedFile> file(MappedFile::open(path));
+        const BinaryDatasetHeader header(readHeader(*file));
+        warnIfNormalized(header, normalize);
+        return copyRows(file, header, normalize, rankMapping, rank, true);
+    }
+
+    static BinaryDatasetHeader readHeader(const MappedFile &file) {
+        if (file.size() < sizeof(BinaryDatasetHeader)) {
+            throw std::invalid_argument("ERROR: binary dataset is smaller than its header");
+        }
+
+        BinaryDatasetHeader header;
+        std::memcpy(&header, file.getData(), sizeof(BinaryDatasetHeader));
+
+        if (std::memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0) {
+            throw std::invalid_argument("ERROR: input is not a binary dataset, did you mean to omit --loadBinary?");
+        }
+
+        if (header.version != VERSION) {
+            spdlog::error("binary dataset has version {0:d} but this build reads version {1:d}", header.version, VERSION);
+            throw std::invalid_argument("ERROR: unsupported binary dataset version");
+        }
+
+        if (header.kind != DENSE && header.kind != SPARSE) {
+            throw std::invalid_argument("ERROR: unrecognized binary dataset kind");
+        }
+
+        if (header.fileBytes != file.size()) {
+            spdlog::error("binary dataset should have {0:d} bytes but has {1:d}", header.fileBytes, file.size());
+            throw std::invalid_argument("ERROR: binary dataset is truncated or corrupt");
+        }
+
+        const bool dense = header.kind == DENSE;
+        if (dense && header.stride < header.columns) {
+            spdlog::error("binary dataset has a stride of {0:d} for {1:d} columns", header.stride, header.columns);
+            throw std::invalid_argument("ERROR: binary dataset is truncated or corrupt");
+        }
+
+        if (header.rows == UINT64_MAX
+            || !isSectionInFile(file, header.offsetsStart, header.rows + 1, sizeof(uint64_t))
+            || (dense && (header.rows > 0 && header.stride > UINT64_MAX / header.rows))
+            || (dense && !isSectionInFile(file, header.valuesStart, header.rows * header.stride, sizeof(float)))
+            || (!dense && !isSectionInFile(file, header.columnsStart, header.nonZeros, sizeof(uint32_t)))
+            || (!dense && !isSectionInFile(file, header.valuesStart, header.nonZeros, sizeof(float)))) {
+            spdlog::error("a section of the binary dataset does not fit in its {0:d} bytes", file.size());
+            throw std::invalid_argument("ERROR: binary dataset is truncated or corrupt");
+        }
+
+        // Rows are found through the offsets, so every row has to start and end inside the payload.
+        const uint64_t* offsets = reinterpret_cast<const uint64_t*>(file.getData() + header.offsetsStart);
+        for (size_t i = 0; i <= header.rows; i++) {
+            uint64_t lowest = i * header.stride;
+            uint64_t highest = i * header.stride;
+            if (!dense) {
+                lowest = i == header.rows ? header.nonZeros : i == 0 ? 0 : offsets[i - 1];
+                highest = i == 0 ? 0 : header.nonZeros;
+            }
+
+            if (offsets[i] < lowest || offsets[i] > highest) {
+                spdlog::error("row offset {0:d} of the binary dataset is out of order or out of range", i);
+                throw std::invalid_argument("ERROR: binary dataset is truncated or corrupt");
+            }
+        }
+
+        // Mapped sparse rows are used as they are, and the sparse kernels merge rows by column, 
+        //  so every row must have strictly increasing columns. Like text inputs, adjacency lists 
+        //  may number their columns from 1, up to and including the column count.
+        const uint32_t* columns = reinterpret_cast<const uint32_t*>(file.getData() + header.columnsStart);
+        for (size_t i = 0; !dense && i < header.rows; i++) {
+            for (uint64_t k = offsets[i]; k < offsets[i + 1]; k++) {
+                if (columns[k] > header.columns || (k > offsets[i] && columns[k] <= columns[k - 1])) {
+                    spdlog::error("row {0:d} of the binary dataset has column {1:d} out of order or out of range", i, columns[k]);
+                    throw std::invalid_argument("ERROR: binary dataset is truncated or corrupt");
+                }
+            }
+        }
+
+        return header;
+    }
+
+    private:
+    static_assert(sizeof(size_t) == sizeof(uint64_t), "row offsets are mapped directly as size_t");
+    static_assert(sizeof(unsigned int) == sizeof(uint32_t), "sparse columns are mapped directly as unsigned int");
+
+    static uint64_t align(const uint64_t position) {
+        return ((position + DenseMatrix::ALIGNMENT_BYTES - 1) / DenseMatrix::ALIGNMENT_BYTES) * DenseMatrix::ALIGNMENT_BYTES;
+    }
+
+    static void pad(std::ostream &output, const uint64_t from, const uint64_t to) {
+        const std::vector<char> zeros(to - from, 0);
+        output.write(zeros.data(), zeros.size());
+    }
+
+    /**
+     * Whether count values of width bytes starting at start lie inside the file and start 
+     *  aligned to their width, so they can be used in place.
+     */
+    static bool isSectionInFile(const MappedFile &file, const uint64_t start, const uint64_t count, const uint64_t width) {
+        return start % width == 0 && start <= file.size() && count <= (file.size() - start) / width;
+    }
+
+    static BinaryDatasetHeader buildHeader(
+        const uint32_t kind,
+        const size_t rows,
+        const size_t columns,
+        const bool normalized
+    ) {
+        BinaryDatasetHeader header;
+        std::memset(&header, 0, sizeof(BinaryDatasetHeader));
+        std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+        header.version = VERSION;
+        header.kind = kind;
+        header.normalized = normalized;
+        header.rows = rows;
+        header.columns = columns;
+        header.offsetsStart = align(sizeof(BinaryDatasetHeader));
+        header.valuesStart = align(header.offsetsStart + (rows + 1) * sizeof(uint64_t));
+        return header;
+    }
+
+    static void writeHeaderAndOffsets(
+        std::ostream &output,
+        const BinaryDatasetHeader &header,
+        const std::vector<uint64_t> &offsets
+    ) {
+        output.write(reinterpret_cast<const char*>(&header), sizeof(BinaryDatasetHeader));
+        pad(output, sizeof(BinaryDatasetHeader), header.offsetsStart);
+        output.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+        pad(output, header.offsetsStart + offsets.size() * sizeof(uint64_t), header.columnsStart);
+    }
+
+    static void warnIfNormalized(const BinaryDatasetHeader &header, const bool normalize) {
+        if (header.normalized && !normalize) {
+            spdlog::warn("binary dataset was normalized when it was written, rows will be used as is");
+        }
+    }
+
+    static std::unique_ptr<BaseData> copyRows(
+        const std::shared_ptr<MappedFile> &file,
+        const BinaryDatasetHeader &header,
+        const bool normalize,
+        const std::vector<unsigned int> &rankMapping,
+        const unsigned int rank,
+        const bool segmented
+    ) {
+        if (rankMapping.size() > header.rows) {
+            spdlog::error("expected at least {0:d} rows but the binary dataset only has {1:d}", rankMapping.size(), header.rows);
+            throw std::invalid_argument("The number of rows you have provided was incorrect.");
+        }
+
+        const bool normalizeRows = normalize && !header.normalized;
+        const uint64_t* offsets = reinterpret_cast<const uint64_t*>(file->getData() + header.offsetsStart);
+        const float* values = reinterpret_cast<const float*>(file->getData() + header.valuesStart);
+        const uint32_t* columns = reinterpret_cast<const uint32_t*>(file->getData() + header.columnsStart);
+
+        DenseMatrix matrix;
+        CompressedSparseRows rows(header.columns);
+        std::vector<size_t> localRowToGlobalRow;
+        std::unordered_map<size_t, size_t> globalRowToLocalRow;
+
+        for (size_t globalRow = 0; globalRow < rankMapping.size(); globalRow++) {
+            if (rankMapping[globalRow] != rank) {
+                continue;
+            }
+
+            if (header.kind == DENSE) {
+                matrix.push(values + offsets[globalRow], header.columns);
+                matrix.finishRow();
+                if (normalizeRows) {
+                    matrix.normalizeLastRow();
+                }
+            } else {
+                for (uint64_t i = offsets[globalRow]; i < offsets[globalRow + 1]; i++) {
+                    rows.push(columns[i], values[i]);
+                }
+                rows.finishRow();
+                if (normalizeRows) {
+                    rows.normalizeLastRow();
+                }
+            }
+
+            if (segmented) {
+                globalRowToLocalRow.insert({globalRow, localRowToGlobalRow.size()});
+            }
+            localRowToGlobalRow.push_back(globalRow);
+        }
+
+        std::optional<std::unordered_map<size_t, size_t>> mapping(std::nullopt);
+        if (segmented) {
+            mapping = std::move(globalRowToLocalRow);
+        }
+
+        if (header.kind == DENSE) {
+            matrix.shrinkToFit();
+            return std::unique_ptr<BaseData>(
+                new DenseMatrixData(std::move(matrix), std::move(localRowToGlobalRow), std::move(mapping))
+            );
+        }
+
+        rows.shrinkToFit();
+        return std::unique_ptr<BaseData>(
+            new CompressedSparseRowData(std::move(rows), std::move(localRowToGlobalRow), std::move(mapping))
+        );
+    }
+};
+
+#endif
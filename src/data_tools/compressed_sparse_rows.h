@@ -0,0 +1,244 @@
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+
+#include "data_row.h"
+#include "data_row_visitor.h"
+
+#ifndef COMPRESSED_SPARSE_ROWS_H
+#define COMPRESSED_SPARSE_ROWS_H
+
+/**
+ * Stores a set of sparse rows in compressed sparse row (CSR) format; one offset array, one
+ * sorted column array and one value array shared by every row. Rows are appended one value
+ * at a time and sealed with finishRow(), or the arrays can be wrapped from read-only storage
+ * owned by someone else, such as a mapped file.
+ */
+class CompressedSparseRows {
+    private:
+    size_t totalColumns;
+    std::vector<size_t> offsets;
+    std::vector<unsigned int> columns;
+    std::vector<float> values;
+
+    // Only set when these rows wrap external storage, in which case the vectors stay empty.
+    std::shared_ptr<const void> owner;
+    const size_t* externalOffsets;
+    const unsigned int* externalColumns;
+    const float* externalValues;
+    size_t externalRows;
+
+    const size_t* offsetData() const {
+        return this->owner != nullptr ? this->externalOffsets : this->offsets.data();
+    }
+
+    const unsigned int* columnData() const {
+        return this->owner != nullptr ? this->externalColumns : this->columns.data();
+    }
+
+    const float* valueData() const {
+        return this->owner != nullptr ? this->externalValues : this->values.data();
+    }
+
+    class AppendingVisitor : public DataRowVisitor {
+        private:
+        CompressedSparseRows &rows;
+
+        public:
+        AppendingVisitor(CompressedSparseRows &rows) : rows(rows) {}
+
+        void visitDenseDataRow(const std::vector<float>& data) {
+            for (size_t i = 0; i < data.size(); i++) {
+                if (data[i] != 0) {
+                    rows.push(i, data[i]);
+                }
+            }
+        }
+
+        void visitSparseDataRow(const std::map<size_t, float>& data, size_t _totalColumns) {
+            for (const auto & p : data) {
+                rows.push(p.first, p.second);
+            }
+        }
+
+        void visitSparseDataRowView(const unsigned int* columns, const float* values, const size_t nonZeros, const size_t _totalColumns) {
+            for (size_t i = 0; i < nonZeros; i++) {
+                rows.push(columns[i], values[i]);
+            }
+        }
+    };
+
+    public:
+    CompressedSparseRows(const size_t totalColumns) : 
+        totalColumns(totalColumns), 
+        offsets({0}), 
+        owner(nullptr),
+        externalOffsets(nullptr),
+        externalColumns(nullptr),
+        externalValues(nullptr),
+        externalRows(0)
+    {}
+
+    /**
+     * Wraps rows + 1 offsets and the column and value arrays they index, all owned by owner.
+     * Columns of every row must already be sorted and unique.
+     */
+    static CompressedSparseRows wrap(
+        std::shared_ptr<const void> owner,
+        const size_t* offsets,
+        const unsigned int* columns,
+        const float* values,
+        const size_t rows,
+        const size_t totalColumns
+    ) {
+        CompressedSparseRows result(totalColumns);
+        result.offsets.clear();
+        result.owner = std::move(owner);
+        result.externalOffsets = offsets;
+        result.externalColumns = columns;
+        result.externalValues = values;
+        result.externalRows = rows;
+        return result;
+    }
+
+    void push(const size_t column, const float value) {
+        this->columns.push_back(column);
+        this->values.push_back(value);
+    }
+
+    void append(const DataRow &row) {
+        AppendingVisitor visitor(*this);
+        row.voidVisit(visitor);
+        this->finishRow();
+    }
+
+    /**
+     * Seals the values pushed since the last call as a new row. Input rows are usually already
+     * sorted, otherwise they are sorted here. Repeated columns keep their first value to match
+     * the std::map::insert semantics of SparseDataRow.
+     */
+    void finishRow() {
+        if (this->owner != nullptr) {
+            throw std::invalid_argument("ERROR: cannot append rows to wrapped sparse rows");
+        }
+
+        const size_t start = this->offsets.back();
+        if (!std::is_sorted(this->columns.begin() + start, this->columns.end())) {
+            std::vector<std::pair<unsigned int, float>> row;
+            for (size_t i = start; i < this->columns.size(); i++) {
+                row.push_back({this->columns[i], this->values[i]});
+            }
+
+            std::stable_sort(row.begin(), row.end(), [](const auto &a, const auto &b) {
+                return a.first < b.first;
+            });
+
+            for (size_t i = 0; i < row.size(); i++) {
+                this->columns[start + i] = row[i].first;
+                this->values[start + i] = row[i].second;
+            }
+        }
+
+        size_t end = start;
+        for (size_t i = start; i < this->columns.size(); i++) {
+            if (i == start || this->columns[i] != this->columns[end - 1]) {
+                this->columns[end] = this->columns[i];
+                this->values[end] = this->values[i];
+                end++;
+            }
+        }
+        this->columns.resize(end);
+        this->values.resize(end);
+
+        this->offsets.push_back(end);
+    }
+
+    /**
+     * Divides the last finished row by its euclidian norm. Mirrors NormalizedDataRowFactory so
+     * that rows normalized here are identical to rows normalized by the factory.
+     */
+    void normalizeLastRow() {
+        this->normalizeRow(this->totalRows() - 1);
+    }
+
+    /**
+     * Same as normalizeLastRow for any finished row. Different rows can be normalized in parallel.
+     */
+    void normalizeRow(const size_t i) {
+        if (this->owner != nullptr) {
+            throw std::invalid_argument("ERROR: cannot modify wrapped sparse rows");
+        }
+
+        const size_t start = this->offsets[i];
+        const size_t end = this->offsets[i + 1];
+        const long double eclidian_norm = std::sqrt(
+            std::inner_product(this->values.begin() + start, this->values.begin() + end, this->values.begin() + start, 0.0L)
+        );
+
+        for (size_t v = start; v < end; v++) {
+            this->values[v] = this->values[v] / eclidian_norm;
+        }
+    }
+
+    void shrinkToFit() {
+        this->offsets.shrink_to_fit();
+        this->columns.shrink_to_fit();
+        this->values.shrink_to_fit();
+    }
+
+    size_t totalRows() const {
+        return this->owner != nullptr ? this->externalRows : this->offsets.size() - 1;
+    }
+
+    size_t getTotalColumns() const {
+        return this->totalColumns;
+    }
+
+    size_t nonZeros() const {
+        return this->offsetData()[this->totalRows()];
+    }
+
+    size_t getStorageBytes() const {
+        if (this->owner != nullptr) {
+            return (this->externalRows + 1) * sizeof(size_t)
+                + this->nonZeros() * (sizeof(unsigned int) + sizeof(float));
+        }
+
+        return this->offsets.capacity() * sizeof(size_t)
+            + this->columns.capacity() * sizeof(unsigned int)
+            + this->values.capacity() * sizeof(float);
+    }
+
+    /**
+     * Views are only valid until the next row is appended.
+     */
+    SparseDataRowView getRow(const size_t i) const {
+        const size_t* rowOffsets = this->offsetData();
+        return SparseDataRowView(
+            this->columnData() + rowOffsets[i],
+            this->valueData() + rowOffsets[i],
+            rowOffsets[i + 1] - rowOffsets[i],
+            this->totalColumns
+        );
+    }
+
+    /**
+     * The raw arrays, rows + 1 offsets followed by nonZeros() columns and values.
+     */
+    const size_t* getOffsets() const {
+        return this->offsetData();
+    }
+
+    const unsigned int* getColumns() const {
+        return this->columnData();
+    }
+
+    const float* getValues() const {
+        return this->valueData();
+    }
+};
+
+#endif
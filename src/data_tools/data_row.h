@@ -90,4 +90,71 @@ class SparseDataRow : public DataRow {
     }
 };
 
+/**
+ * A non-owning row that points into compressed sparse row storage. The arrays backing 
+ * this row must outlive it.
+ */
+class SparseDataRowView : public DataRow {
+    private:
+    const unsigned int* columns;
+    const float* values;
+    size_t nonZeros;
+    size_t totalColumns;
+
+    public:
+    SparseDataRowView(
+        const unsigned int* columns, 
+        const float* values, 
+        const size_t nonZeros, 
+        const size_t totalColumns
+    ) : 
+        columns(columns),
+        values(values),
+        nonZeros(nonZeros),
+        totalColumns(totalColumns)
+    {}
+
+    size_t size() const {
+        return this->totalColumns;
+    }
+
+    float dotProduct(const DataRow& dataRow) const {
+        SparseViewDotProductDataRowVisitor visitor(columns, values, nonZeros);
+        return dataRow.visit(visitor);
+    }
+
+    void voidVisit(DataRowVisitor &visitor) const {
+        visitor.visitSparseDataRowView(columns, values, nonZeros, this->totalColumns);
+    }
+};
+
+/**
+ * A non-owning row that points into a dense row-major matrix. The matrix backing this row
+ * must outlive it.
+ */
+class DenseDataRowView : public DataRow {
+    private:
+    const float* data;
+    size_t totalColumns;
+
+    public:
+    DenseDataRowView(const float* data, const size_t totalColumns) : 
+        data(data),
+        totalColumns(totalColumns)
+    {}
+
+    size_t size() const {
+        return this->totalColumns;
+    }
+
+    float dotProduct(const DataRow& dataRow) const {
+        DenseViewDotProductDataRowVisitor visitor(data, totalColumns);
+        return dataRow.visit(visitor);
+    }
+
+    void voidVisit(DataRowVisitor &visitor) const {
+        visitor.visitDenseDataRowView(data, this->totalColumns);
+    }
+};
+
 #endif
\ No newline at end of file
@@ -6,9 +6,19 @@
 #include <optional>
 #include <numeric>
 #include <random>
+#include <string_view>
+#include <cstring>
+#include <limits>
+#include <array>
+#include <cstdint>
+#include <cmath>
 
 #include "data_row.h"
+#include "number_parser.h"
+#include "mapped_file.h"
 #include "data_row_visitor.h"
+#include "compressed_sparse_rows.h"
+#include "dense_matrix.h"
 
 #ifndef DATA_ROW_FACTOR_H
 #define DATA_ROW_FACTOR_H
@@ -100,23 +110,172 @@ class UniformRandomNumberGenerator : public RandomNumberGenerator {
     }
 };
 
+/**
+ * Philox4x32-10 from Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3". Maps a
+ * counter and a key to 128 random bits, so element i of a stream is computed directly from
+ * i instead of by stepping through every element before it.
+ */
+class Philox {
+    private:
+    static constexpr uint32_t MULTIPLIER_0 = 0xD2511F53;
+    static constexpr uint32_t MULTIPLIER_1 = 0xCD9E8D57;
+    static constexpr uint32_t WEYL_0 = 0x9E3779B9;
+    static constexpr uint32_t WEYL_1 = 0xBB67AE85;
+    static constexpr size_t ROUNDS = 10;
+
+    public:
+    typedef std::array<uint32_t, 4> Block;
+    typedef std::array<uint32_t, 2> Key;
+
+    static Block generate(Block counter, Key key) {
+        for (size_t round = 0; round < ROUNDS; round++) {
+            const uint64_t product0 = static_cast<uint64_t>(MULTIPLIER_0) * counter[0];
+            const uint64_t product1 = static_cast<uint64_t>(MULTIPLIER_1) * counter[2];
+            counter = {
+                static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+                static_cast<uint32_t>(product1),
+                static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+                static_cast<uint32_t>(product0)
+            };
+            key[0] += WEYL_0;
+            key[1] += WEYL_1;
+        }
+
+        return counter;
+    }
+
+    static Key keyFor(const uint64_t seed) {
+        return {static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)};
+    }
+
+    static Block counterFor(const uint64_t block) {
+        return {static_cast<uint32_t>(block), static_cast<uint32_t>(block >> 32), 0, 0};
+    }
+
+    /**
+     * Maps 32 random bits to [0, 1).
+     */
+    static float toUnitInterval(const uint32_t bits) {
+        return (bits >> 8) * (1.0f / (1u << 24));
+    }
+};
+
+/**
+ * Uniform numbers in [0, 1) drawn from Philox. Skipping ahead is constant time.
+ */
+class PhiloxUniformRandomNumberGenerator : public RandomNumberGenerator {
+    private:
+    const Philox::Key key;
+    uint64_t element;
+
+    uint64_t cachedBlock;
+    Philox::Block cached;
+
+    PhiloxUniformRandomNumberGenerator(const Philox::Key key, const uint64_t element) 
+    : key(key), element(element), cachedBlock(-1) {}
+
+    public:
+    static std::unique_ptr<RandomNumberGenerator> create(const long unsigned int seed) {
+        return std::unique_ptr<RandomNumberGenerator>(new PhiloxUniformRandomNumberGenerator(Philox::keyFor(seed), 0));
+    }
+
+    void skipNextElements(size_t elementsToSkip) {
+        this->element += elementsToSkip;
+    }
+
+    float getNumber() {
+        // Each block holds four numbers.
+        const uint64_t block = this->element >> 2;
+        if (block != this->cachedBlock) {
+            this->cached = Philox::generate(Philox::counterFor(block), this->key);
+            this->cachedBlock = block;
+        }
+
+        return Philox::toUnitInterval(this->cached[this->element++ & 3]);
+    }
+
+    std::unique_ptr<RandomNumberGenerator> copy() {
+        return std::unique_ptr<RandomNumberGenerator>(new PhiloxUniformRandomNumberGenerator(this->key, this->element));
+    }
+};
+
+/**
+ * Standard normal numbers drawn from Philox with the Box-Muller transform. Skipping ahead is 
+ * constant time.
+ */
+class PhiloxNormalRandomNumberGenerator : public RandomNumberGenerator {
+    private:
+    const Philox::Key key;
+    uint64_t element;
+
+    uint64_t cachedBlock;
+    Philox::Block cached;
+
+    PhiloxNormalRandomNumberGenerator(const Philox::Key key, const uint64_t element) 
+    : key(key), element(element), cachedBlock(-1) {}
+
+    public:
+    static std::unique_ptr<RandomNumberGenerator> create(const long unsigned int seed) {
+        return std::unique_ptr<RandomNumberGenerator>(new PhiloxNormalRandomNumberGenerator(Philox::keyFor(seed), 0));
+    }
+
+    void skipNextElements(size_t elementsToSkip) {
+        this->element += elementsToSkip;
+    }
+
+    float getNumber() {
+        // Each block holds two pairs of uniform numbers, and each pair makes one number.
+        const uint64_t block = this->element >> 1;
+        if (block != this->cachedBlock) {
+            this->cached = Philox::generate(Philox::counterFor(block), this->key);
+            this->cachedBlock = block;
+        }
+
+        const size_t lane = (this->element++ & 1) * 2;
+        const double radius = 1.0 - Philox::toUnitInterval(this->cached[lane]);
+        const double angle = Philox::toUnitInterval(this->cached[lane + 1]);
+        return std::sqrt(-2.0 * std::log(radius)) * std::cos(2.0 * M_PI * angle);
+    }
+
+    std::unique_ptr<RandomNumberGenerator> copy() {
+        return std::unique_ptr<RandomNumberGenerator>(new PhiloxNormalRandomNumberGenerator(this->key, this->element));
+    }
+};
+
 class LineFactory {
+    private:
+    std::string lastLine;
+
     public:
     virtual ~LineFactory() {}
     virtual std::optional<std::string> maybeGet() = 0;
     virtual void skipNext() = 0;
+
+    /**
+     * Same as maybeGet, but the returned view is only valid until the next line is requested.
+     * Factories that can hand out lines without copying them should override this.
+     */
+    virtual std::optional<std::string_view> maybeGetView() {
+        std::optional<std::string> line(this->maybeGet());
+        if (!line.has_value()) {
+            return std::nullopt;
+        }
+
+        this->lastLine = std::move(line.value());
+        return std::string_view(this->lastLine);
+    }
 };
 
 class FromFileLineFactory : public LineFactory {
     private:
     std::istream &source;
+    std::string buffer;
 
     public:
     FromFileLineFactory(std::istream &source) : source(source) {}
 
     void skipNext() {
-        std::string data;
-        std::getline(source, data);
+        source.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
     }
 
     std::optional<std::string> maybeGet() {
@@ -128,6 +287,67 @@ class FromFileLineFactory : public LineFactory {
 
         return std::move(data);
     }
+
+    /**
+     * Reads into a buffer that is reused between lines, so no line needs its own allocation.
+     */
+    std::optional<std::string_view> maybeGetView() {
+        if (!std::getline(source, this->buffer)) {
+            return std::nullopt;
+        }
+
+        return std::string_view(this->buffer);
+    }
+};
+
+/**
+ * Hands out lines as views straight into a mapped file, so lines are never copied. Views
+ * stay valid for as long as this factory exists.
+ */
+class MappedFileLineFactory : public LineFactory {
+    private:
+    std::shared_ptr<MappedFile> file;
+    size_t position;
+
+    MappedFileLineFactory(std::shared_ptr<MappedFile> file) : file(std::move(file)), position(0) {}
+
+    size_t findLineEnd() const {
+        const void* newline = std::memchr(file->getData() + position, '\n', file->size() - position);
+        return newline == nullptr ? file->size() : static_cast<const char*>(newline) - file->getData();
+    }
+
+    public:
+    static std::unique_ptr<MappedFileLineFactory> open(const std::string &path) {
+        std::shared_ptr<MappedFile> file(MappedFile::open(path));
+        file->adviseSequential();
+        return std::unique_ptr<MappedFileLineFactory>(new MappedFileLineFactory(std::move(file)));
+    }
+
+    void skipNext() {
+        if (this->position < file->size()) {
+            this->position = this->findLineEnd() + 1;
+        }
+    }
+
+    std::optional<std::string> maybeGet() {
+        std::optional<std::string_view> line(this->maybeGetView());
+        if (!line.has_value()) {
+            return std::nullopt;
+        }
+
+        return std::string(line.value());
+    }
+
+    std::optional<std::string_view> maybeGetView() {
+        if (this->position >= file->size()) {
+            return std::nullopt;
+        }
+
+        const size_t end = this->findLineEnd();
+        std::string_view line(file->getData() + this->position, end - this->position);
+        this->position = end + 1;
+        return line;
+    }
 };
 
 class GeneratedLineFactory : public LineFactory {
@@ -179,19 +399,37 @@ class GeneratedDenseLineFactory : public GeneratedLineFactory {
     }
 
     std::optional<std::string> maybeGet() {
-        if (this->currentRow >= this->numRows) {
+        std::stringstream res;
+        const bool generated = this->maybeGenerate([&res](const float value) {
+            if (res.tellp() > 0) {
+                res << delimeter;
+            }
+            res << value;
+        });
+
+        if (!generated) {
             return std::nullopt;
         }
-        
-        std::stringstream res;
 
-        for (size_t i = 0; i < this->numColumns - 1; i++) {
-            res << this->rng->getNumber() << ",";
+        return res.str();
+    }
+
+    /**
+     * Same as maybeGet, but hands each value of the row to insert instead of formatting
+     * a line.
+     */
+    template <typename Insert>
+    bool maybeGenerate(Insert insert) {
+        if (this->currentRow >= this->numRows) {
+            return false;
+        }
+
+        for (size_t i = 0; i < this->numColumns; i++) {
+            insert(this->rng->getNumber());
         }
-        res << this->rng->getNumber();
 
         this->currentRow++;
-        return res.str();
+        return true;
     }
 
     void jumpToLine(const size_t line) {
@@ -208,7 +446,36 @@ class GeneratedDenseLineFactory : public GeneratedLineFactory {
     }
 };
 
-class GeneratedSparseLineFactory : public GeneratedLineFactory {
+/**
+ * Generates an adjacency list, one edge per line.
+ */
+class GeneratedEdgeLineFactory : public GeneratedLineFactory {
+    public:
+    /**
+     * Same as maybeGet, but returns the row, column and value of the next edge instead of
+     * formatting a line.
+     */
+    virtual bool maybeGenerateEdge(size_t &row, size_t &column, float &value) = 0;
+
+    std::optional<std::string> maybeGet() {
+        size_t row, column;
+        float value;
+        if (!this->maybeGenerateEdge(row, column, value)) {
+            return std::nullopt;
+        }
+
+        std::stringstream res;
+
+        // should use a constant to denote the delimeter here, pull from the 
+        //  file that loads sparse rows
+        std::string delimeter = " ";
+        res << row << delimeter << column << delimeter << value;
+
+        return res.str();
+    }
+};
+
+class GeneratedSparseLineFactory : public GeneratedEdgeLineFactory {
     private:
     const size_t numRows;
     const size_t numColumns;
@@ -264,9 +531,9 @@ class GeneratedSparseLineFactory : public GeneratedLineFactory {
         this->jumpToLine(this->currentRow + 1);
     }
 
-    std::optional<std::string> maybeGet() {
+    bool maybeGenerateEdge(size_t &row, size_t &column, float &value) {
         if (this->currentRow >= this->numRows) {
-            return std::nullopt;
+            return false;
         }
 
         float edgeValue = this->edgeValueRng->getNumber();
@@ -285,20 +552,17 @@ class GeneratedSparseLineFactory : public GeneratedLineFactory {
         }
 
         if (this->currentRow >= this->numRows) {
-            return std::nullopt;
+            return false;
         }
 
-        std::stringstream res;
-
-        // should use a constant to denote the delimeter here, pull from the 
-        //  file that loads sparse rows
-        std::string delimeter = " ";
-        res << this->currentRow << delimeter << this->currentColumn << delimeter << edgeValue;
+        row = this->currentRow;
+        column = this->currentColumn;
+        value = edgeValue;
         
         // increment column to avoid repeats
         this->currentColumn++;
 
-        return res.str();
+        return true;
     }
 
     void jumpToLine(const size_t line) {
@@ -321,6 +585,136 @@ class GeneratedSparseLineFactory : public GeneratedLineFactory {
     }
 };
 
+/**
+ * Generates the same kind of adjacency list as GeneratedSparseLineFactory, but jumps from
+ * edge to edge instead of drawing a number for every cell. The gap to the next edge of a row
+ * is geometrically distributed, so a row costs time proportional to its edges. A row draws at
+ * most numColumns + 1 gaps, those of row r start at element r * (numColumns + 1) of gapRng,
+ * and the value of cell (r, c) is element r * numColumns + c of edgeValueRng. With generators
+ * that skip in constant time, like the Philox ones, jumping to any row is constant time too.
+ */
+class GeometricSparseLineFactory : public GeneratedEdgeLineFactory {
+    private:
+    const size_t numRows;
+    const size_t numColumns;
+    const float sparsity;
+    std::unique_ptr<RandomNumberGenerator> edgeValueRng;
+    std::unique_ptr<RandomNumberGenerator> gapRng;
+
+    size_t currentRow;
+    size_t nextColumn;
+    size_t gapsInRow;
+    size_t edgeValuePosition;
+    size_t gapPosition;
+
+    GeometricSparseLineFactory(
+        const size_t numRows,
+        const size_t numColumns,
+        const float sparsity,
+        std::unique_ptr<RandomNumberGenerator> edgeValueRng,
+        std::unique_ptr<RandomNumberGenerator> gapRng,
+        const size_t currentRow,
+        const size_t nextColumn,
+        const size_t gapsInRow,
+        const size_t edgeValuePosition,
+        const size_t gapPosition
+    ) : 
+        numRows(numRows),
+        numColumns(numColumns),
+        sparsity(sparsity),
+        edgeValueRng(std::move(edgeValueRng)),
+        gapRng(std::move(gapRng)),
+        currentRow(currentRow),
+        nextColumn(nextColumn),
+        gapsInRow(gapsInRow),
+        edgeValuePosition(edgeValuePosition),
+        gapPosition(gapPosition)
+    {}
+
+    static float drawAt(RandomNumberGenerator &rng, size_t &position, const size_t element) {
+        rng.skipNextElements(element - position);
+        position = element + 1;
+        return rng.getNumber();
+    }
+
+    /**
+     * Number of empty cells before the next edge, where each cell is empty with probability
+     * sparsity. Returns numColumns when the rest of the row is empty.
+     */
+    size_t nextGap() {
+        const double uniform = 1.0 - drawAt(*this->gapRng, this->gapPosition, this->currentRow * (this->numColumns + 1) + this->gapsInRow++);
+        if (this->sparsity <= 0) {
+            return 0;
+        }
+        if (this->sparsity >= 1) {
+            return this->numColumns;
+        }
+
+        const double gap = std::floor(std::log(uniform) / std::log(static_cast<double>(this->sparsity)));
+        return gap < this->numColumns ? static_cast<size_t>(gap) : this->numColumns;
+    }
+
+    public:
+    static std::unique_ptr<GeometricSparseLineFactory> create(
+        const size_t numRows,
+        const size_t numColumns,
+        const float sparsity,
+        std::unique_ptr<RandomNumberGenerator> edgeValueRng,
+        std::unique_ptr<RandomNumberGenerator> gapRng) {
+        return std::unique_ptr<GeometricSparseLineFactory>(new GeometricSparseLineFactory(
+            numRows, numColumns, sparsity, std::move(edgeValueRng), std::move(gapRng), 0, 0, 0, 0, 0
+        ));
+    }
+
+    void skipNext() {
+        this->jumpToLine(this->currentRow + 1);
+    }
+
+    bool maybeGenerateEdge(size_t &row, size_t &column, float &value) {
+        while (this->currentRow < this->numRows) {
+            const size_t gap = this->nextGap();
+            if (gap < this->numColumns - this->nextColumn) {
+                row = this->currentRow;
+                column = this->nextColumn + gap;
+                value = drawAt(*this->edgeValueRng, this->edgeValuePosition, row * this->numColumns + column);
+                this->nextColumn = column + 1;
+                return true;
+            }
+
+            this->currentRow++;
+            this->nextColumn = 0;
+            this->gapsInRow = 0;
+        }
+
+        return false;
+    }
+
+    void jumpToLine(const size_t line) {
+        if (line <= this->currentRow) {
+            return;
+        }
+
+        this->currentRow = line;
+        this->nextColumn = 0;
+        this->gapsInRow = 0;
+    }
+
+    std::unique_ptr<GeneratedLineFactory> copy() {
+        return std::unique_ptr<GeneratedLineFactory>(new GeometricSparseLineFactory(
+            this->numRows, 
+            this->numColumns, 
+            this->sparsity, 
+            this->edgeValueRng->copy(), 
+            this->gapRng->copy(), 
+            this->currentRow, 
+            this->nextColumn, 
+            this->gapsInRow, 
+            this->edgeValuePosition, 
+            this->gapPosition
+        ));
+    }
+};
+
 class DataRowFactory {
     public:
     virtual std::unique_ptr<DataRow> maybeGet(LineFactory &source) = 0;
@@ -328,6 +722,34 @@ class DataRowFactory {
     virtual std::unique_ptr<DataRow> getFromBinary(std::vector<float> binary) const = 0;
     virtual void skipNext(LineFactory &source) = 0;
     virtual ~DataRowFactory() {}
+
+    /**
+     * Loads the next row directly into CSR storage. Returns false once the source has no more
+     * rows. Factories that can parse without building an intermediate DataRow should override this.
+     */
+    virtual bool maybeAppend(LineFactory &source, CompressedSparseRows &rows) {
+        std::unique_ptr<DataRow> row(this->maybeGet(source));
+        if (row == nullptr) {
+            return false;
+        }
+
+        rows.append(*row);
+        return true;
+    }
+
+    /**
+     * Loads the next row directly into a dense matrix. Returns false once the source has no 
+     * more rows.
+     */
+    virtual bool maybeAppend(LineFactory &source, DenseMatrix &rows) {
+        std::unique_ptr<DataRow> row(this->maybeGet(source));
+        if (row == nullptr) {
+            return false;
+        }
+
+        rows.append(*row);
+        return true;
+    }
     
     // Pretty horrific method to expose, but I need to expose this for 
     //  sparse generation since the sparse generator will always create
@@ -398,6 +820,24 @@ class NormalizedDataRowFactory : public DataRowFactory {
         NormalizingDataRowVisitor visitor;
         return base->visit(visitor);
     }
+
+    bool maybeAppend(LineFactory &source, CompressedSparseRows &rows) {
+        if (!delegate->maybeAppend(source, rows)) {
+            return false;
+        }
+
+        rows.normalizeLastRow();
+        return true;
+    }
+
+    bool maybeAppend(LineFactory &source, DenseMatrix &rows) {
+        if (!delegate->maybeAppend(source, rows)) {
+            return false;
+        }
+
+        rows.normalizeLastRow();
+        return true;
+    }
     
     std::unique_ptr<DataRow> getFromNaiveBinary(std::vector<float> binary) const {
         return delegate->getFromNaiveBinary(binary);
@@ -423,22 +863,57 @@ class NormalizedDataRowFactory : public DataRowFactory {
 
 class DenseDataRowFactory : public DataRowFactory {
     public:
+    using DataRowFactory::maybeAppend;
+
+    /**
+     * Parses one line and hands each value to insert. Does not touch any factory state, so 
+     * lines can be parsed on any thread. Empty tokens are skipped, and every value is parsed
+     * as a double before it is narrowed to a float.
+     */
+    template <typename Insert>
+    static void parseLine(const std::string_view line, Insert insert) {
+        size_t start = 0;
+        while (start < line.size()) {
+            size_t end = line.find_first_of(DELIMETER, start);
+            if (end == std::string_view::npos) {
+                end = line.size();
+            }
+
+            if (end > start) {
+                insert(NumberParser::parse<double>(line.substr(start, end - start)));
+            }
+            start = end + 1;
+        }
+    }
+
     std::unique_ptr<DataRow> maybeGet(LineFactory &source) {
-        std::optional<std::string> data(source.maybeGet());
+        std::optional<std::string_view> data(source.maybeGetView());
         if (!data.has_value()) {
             return nullptr;
         }
         
         std::vector<float> result;
+        parseLine(data.value(), [&result](const float value) {
+            result.push_back(value);
+        });
 
-        char *token;
-        char *rest = data.value().data();
-
-        while ((token = strtok_r(rest, DELIMETER.data(), &rest)))
-            result.push_back(std::stod(std::string(token)));
         return std::unique_ptr<DataRow>(new DenseDataRow(std::move(result)));
     }
 
+    bool maybeAppend(LineFactory &source, DenseMatrix &rows) {
+        std::optional<std::string_view> data(source.maybeGetView());
+        if (!data.has_value()) {
+            return false;
+        }
+
+        parseLine(data.value(), [&rows](const float value) {
+            rows.push(value);
+        });
+
+        rows.finishRow();
+        return true;
+    }
+
     void skipNext(LineFactory &source) {
         source.skipNext();
     }
@@ -467,14 +942,15 @@ class SparseDataRowFactory : public DataRowFactory {
     private:
     const static size_t EXPECTED_ELEMENTS_PER_LINE = 3;
 
-    const size_t totalColumns;
-
     long expectedRow;
     long currentRow;
     float value = 1.0; 
     long to;
     bool hasData;
 
+    protected:
+    const size_t totalColumns;
+
     public:
     SparseDataRowFactory(const size_t totalColumns) : 
         expectedRow(0), 
@@ -524,68 +1000,200 @@ class SparseDataRowFactory : public DataRowFactory {
         this->expectedRow = line;
     }
 
+    /**
+     * Continues from the first line of row, as if every earlier line had been read and the
+     * last of them left column to and value behind for lines that leave those fields out.
+     */
+    void resumeAt(const size_t row, const long to, const float value) {
+        this->expectedRow = row;
+        this->hasData = false;
+        this->to = to;
+        this->value = value;
+    }
+
     std::unique_ptr<DataRowFactory> copy() {
         return std::unique_ptr<DataRowFactory>(new SparseDataRowFactory(this->totalColumns));
     }
 
+    /**
+     * The fields found on one line of an adjacency list, in order row, column, value. Lines
+     * may leave out trailing fields, elements counts how many were present.
+     */
+    struct Edge {
+        long row;
+        long to;
+        float value;
+        size_t elements;
+    };
+
+    /**
+     * Parses a single line without touching any factory state, so lines can be parsed on 
+     * any thread and handed to appendFromEdges in order.
+     */
+    static Edge parseEdge(const std::string_view line) {
+        Edge edge{0, 0, 0, 0};
+        const char* position = line.data();
+        const char* end = line.data() + line.size();
+        float number;
+
+        // The expected format is a two ints a line, and 
+        //  maybe a third reprsenting value.
+        while(edge.elements < EXPECTED_ELEMENTS_PER_LINE && NumberParser::tryParse(position, end, number)) {
+            switch (edge.elements) {
+                case 0:
+                    edge.row = std::floor(number);
+                    break;
+                case 1:
+                    edge.to = std::floor(number);
+                    break;
+                case 2:
+                    edge.value = number;
+                    break;
+            }
+
+            if (position < end && *position == ',')
+                position++;
+
+            edge.elements++;
+        }
+
+        return edge;
+    }
+
+    /**
+     * Same as maybeAppend, but reads already parsed edges. nextEdge returns std::nullopt once
+     * there are no edges left.
+     */
+    template <typename NextEdge>
+    bool appendFromEdges(NextEdge nextEdge, CompressedSparseRows &rows) {
+        const bool foundRow = this->readEdges(nextEdge, [&rows](const size_t column, const float value) {
+            rows.push(column, value);
+        });
+
+        if (foundRow) {
+            rows.finishRow();
+        }
+
+        return foundRow;
+    }
+
+    /**
+     * Same as maybeGet, but reads already parsed edges.
+     */
+    template <typename NextEdge>
+    std::unique_ptr<DataRow> getFromEdges(NextEdge nextEdge) {
+        std::map<size_t, float> result;
+        const bool foundRow = this->readEdges(nextEdge, [&result](const size_t column, const float value) {
+            result.insert({column, value});
+        });
+
+        if (!foundRow) {
+            return nullptr;
+        }
+
+        return this->returnResult(std::move(result), false);
+    }
+
+    /**
+     * Same as skipNext, but reads already parsed edges.
+     */
+    template <typename NextEdge>
+    bool skipFromEdges(NextEdge nextEdge) {
+        return this->readEdges(nextEdge, [](const size_t _column, const float _value) {});
+    }
+
+    using DataRowFactory::maybeAppend;
+
+    bool maybeAppend(LineFactory &source, CompressedSparseRows &rows) {
+        const bool foundRow = this->readRow(source, [&rows](const size_t column, const float value) {
+            rows.push(column, value);
+        });
+
+        if (foundRow) {
+            rows.finishRow();
+        }
+
+        return foundRow;
+    }
+
     private:
     std::unique_ptr<DataRow> maybeGet(LineFactory &source, bool skip) {
         std::map<size_t, float> result;
+        const bool foundRow = this->readRow(source, [&result, skip](const size_t column, const float value) {
+            if (!skip) {
+                result.insert({column, value});
+            }
+        });
+
+        if (!foundRow) {
+            return nullptr;
+        }
+
+        return this->returnResult(std::move(result), skip);
+    }
+
+    /**
+     * Reads every edge of the expected row and hands each one to insert. Returns false once
+     * the source has been exhausted and there is no row left to return.
+     */
+    template <typename Insert>
+    bool readRow(LineFactory &source, Insert insert) {
+        return this->readEdges([&source]() -> std::optional<Edge> {
+            std::optional<std::string_view> line(source.maybeGetView());
+            if (!line.has_value()) {
+                return std::nullopt;
+            }
+            SPDLOG_TRACE("loaded line of {}", line.value());
+
+            return parseEdge(line.value());
+        }, insert);
+    }
+
+    template <typename NextEdge, typename Insert>
+    bool readEdges(NextEdge nextEdge, Insert insert) {
+        size_t inserted = 0;
 
         if (this->hasData) {
             if (this->currentRow == this->expectedRow) {
-                result.insert({to, value});
+                insert(to, value);
+                inserted++;
             } else {
                 this->expectedRow++;
-                return this->returnResult(std::move(result), skip);
+                return true;
             }
         }
 
         while (true) {
-            std::optional<std::string> line(source.maybeGet());
-            if (!line.has_value()) {
-                if (result.size() > 0) {
+            std::optional<Edge> edge(nextEdge());
+            if (!edge.has_value()) {
+                if (inserted > 0) {
                     this->hasData = false;
-                    return this->returnResult(std::move(result), skip);
+                    return true;
                 } else {
-                    return nullptr;
+                    return false;
                 }
             }
-            SPDLOG_TRACE("loaded line of {}", line.value());
 
             this->hasData = false;
 
-            std::istringstream stream(line.value().data());
-            float number;
-            size_t totalSeen = 0;
-
-            // The expected format is a two ints a line, and 
-            //  maybe a third reprsenting value.
-            while(stream >> number && totalSeen < EXPECTED_ELEMENTS_PER_LINE) {
-                switch (totalSeen) {
-                    case 0:
-                        currentRow = std::floor(number);
-                        break;
-                    case 1:
-                        to = std::floor(number);
-                        break;
-                    case 2:
-                        value = number;
-                        break;
-                }
-
-                if (stream.peek() == ',')
-                    stream.ignore();
-
-                totalSeen++;
+            // Fields missing from a line keep the value they had on the previous line.
+            if (edge.value().elements > 0) {
+                currentRow = edge.value().row;
+            }
+            if (edge.value().elements > 1) {
+                to = edge.value().to;
+            }
+            if (edge.value().elements > 2) {
+                value = edge.value().value;
             }
             
             if (currentRow == this->expectedRow) {
-                result.insert({to, value});
+                insert(to, value);
+                inserted++;
             } else if (currentRow > this->expectedRow) {
                 this->expectedRow++;
                 this->hasData = true;
-                return this->returnResult(std::move(result), skip);
+                return true;
             } else {
                 spdlog::error("had current row of {0:d} and expected row of {1:d}", currentRow, this->expectedRow);
                 throw std::invalid_argument("ERROR: cannot backtrack");
@@ -602,4 +1210,109 @@ class SparseDataRowFactory : public DataRowFactory {
     }
 };
 
+/**
+ * Builds dense rows straight from a GeneratedDenseLineFactory instead of formatting each
+ * value into a line and parsing it back. Every value is rounded the way that round trip
+ * rounds it, so rows are identical to reading the generated lines with DenseDataRowFactory.
+ */
+class GeneratedDenseDataRowFactory : public DenseDataRowFactory {
+    private:
+    static GeneratedDenseLineFactory& asGenerator(LineFactory &source) {
+        GeneratedDenseLineFactory* generator = dynamic_cast<GeneratedDenseLineFactory*>(&source);
+        if (generator == nullptr) {
+            throw std::invalid_argument("ERROR: generated dense rows can only be read from a GeneratedDenseLineFactory");
+        }
+
+        return *generator;
+    }
+
+    public:
+    using DataRowFactory::maybeAppend;
+
+    std::unique_ptr<DataRow> maybeGet(LineFactory &source) {
+        std::vector<float> result;
+        const bool generated = asGenerator(source).maybeGenerate([&result](const float value) {
+            result.push_back(NumberParser::reparse<double>(value));
+        });
+
+        if (!generated) {
+            return nullptr;
+        }
+
+        return std::unique_ptr<DataRow>(new DenseDataRow(std::move(result)));
+    }
+
+    bool maybeAppend(LineFactory &source, DenseMatrix &rows) {
+        const bool generated = asGenerator(source).maybeGenerate([&rows](const float value) {
+            rows.push(NumberParser::reparse<double>(value));
+        });
+
+        if (generated) {
+            rows.finishRow();
+        }
+
+        return generated;
+    }
+
+    std::unique_ptr<DataRowFactory> copy() {
+        return std::unique_ptr<DataRowFactory>(new GeneratedDenseDataRowFactory());
+    }
+};
+
+/**
+ * Builds sparse rows straight from a GeneratedEdgeLineFactory instead of formatting each
+ * edge into a line and parsing it back. Edges are rounded the way that round trip rounds
+ * them, so rows are identical to reading the generated lines with SparseDataRowFactory.
+ * Like SparseDataRowFactory, this is a stateful class.
+ */
+class GeneratedSparseDataRowFactory : public SparseDataRowFactory {
+    private:
+    static GeneratedEdgeLineFactory& asGenerator(LineFactory &source) {
+        GeneratedEdgeLineFactory* generator = dynamic_cast<GeneratedEdgeLineFactory*>(&source);
+        if (generator == nullptr) {
+            throw std::invalid_argument("ERROR: generated sparse rows can only be read from a GeneratedEdgeLineFactory");
+        }
+
+        return *generator;
+    }
+
+    // Row and column ids are written as integers but read back as floats.
+    static long reparseIndex(const size_t index) {
+        return static_cast<long>(static_cast<float>(index));
+    }
+
+    static auto edgesFrom(GeneratedEdgeLineFactory &generator) {
+        return [&generator]() -> std::optional<Edge> {
+            size_t row, column;
+            float value;
+            if (!generator.maybeGenerateEdge(row, column, value)) {
+                return std::nullopt;
+            }
+
+            return Edge{reparseIndex(row), reparseIndex(column), NumberParser::reparse<float>(value), 3};
+        };
+    }
+
+    public:
+    GeneratedSparseDataRowFactory(const size_t totalColumns) : SparseDataRowFactory(totalColumns) {}
+
+    using DataRowFactory::maybeAppend;
+
+    std::unique_ptr<DataRow> maybeGet(LineFactory &source) {
+        return this->getFromEdges(edgesFrom(asGenerator(source)));
+    }
+
+    bool maybeAppend(LineFactory &source, CompressedSparseRows &rows) {
+        return this->appendFromEdges(edgesFrom(asGenerator(source)), rows);
+    }
+
+    void skipNext(LineFactory &source) {
+        this->skipFromEdges(edgesFrom(asGenerator(source)));
+    }
+
+    std::unique_ptr<DataRowFactory> copy() {
+        return std::unique_ptr<DataRowFactory>(new GeneratedSparseDataRowFactory(this->totalColumns));
+    }
+};
+
 #endif
\ No newline at end of file
@@ -9,6 +9,32 @@ class DataRowVisitor {
     virtual ~DataRowVisitor() {}
     virtual void visitDenseDataRow(const std::vector<float>& data) = 0;
     virtual void visitSparseDataRow(const std::map<size_t, float>& data, size_t totalColumns) = 0;
+
+    /**
+     * Visits a row that lives inside compressed sparse row storage. Columns are sorted and unique. 
+     * The default rebuilds the row as a map, visitors on a hot path should override this.
+     */
+    virtual void visitSparseDataRowView(
+        const unsigned int* columns, 
+        const float* values, 
+        const size_t nonZeros, 
+        const size_t totalColumns
+    ) {
+        std::map<size_t, float> data;
+        for (size_t i = 0; i < nonZeros; i++) {
+            data.insert(data.end(), {columns[i], values[i]});
+        }
+
+        this->visitSparseDataRow(data, totalColumns);
+    }
+
+    /**
+     * Visits a row that lives inside a dense row-major matrix. The default copies the row into 
+     * a vector, visitors on a hot path should override this.
+     */
+    virtual void visitDenseDataRowView(const float* data, const size_t totalColumns) {
+        this->visitDenseDataRow(std::vector<float>(data, data + totalColumns));
+    }
 };
 
 template <typename T>
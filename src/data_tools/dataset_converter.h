@@ -0,0 +1,146 @@
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <optional>
+#include <exception>
+#include <omp.h>
+
+#include "data_row_factory.h"
+#include "dense_matrix.h"
+#include "compressed_sparse_rows.h"
+#include "binary_dataset.h"
+
+#ifndef DATASET_CONVERTER_H
+#define DATASET_CONVERTER_H
+
+/**
+ * Converts the text inputs read by DenseDataRowFactory and SparseDataRowFactory into the
+ * binary dataset format. The input is read one chunk of lines at a time, lines in a chunk are
+ * tokenized in parallel, and rows are assembled in input order so the result is identical to
+ * loading the text file.
+ */
+class DatasetConverter {
+    public:
+    static const size_t DEFAULT_CHUNK_LINES = 1 << 16;
+
+    static void convert(
+        std::istream &input,
+        std::ostream &output,
+        const size_t adjacencyListColumnCount,
+        const bool normalize,
+        const size_t chunkLines
+    ) {
+        if (adjacencyListColumnCount > 0) {
+            BinaryDataset::write(output, loadSparse(input, adjacencyListColumnCount, normalize, chunkLines), normalize);
+        } else {
+            BinaryDataset::write(output, loadDense(input, normalize, chunkLines), normalize);
+        }
+    }
+
+    static DenseMatrix loadDense(std::istream &input, const bool normalize, const size_t chunkLines) {
+        DenseMatrix matrix;
+
+        while (true) {
+            std::vector<std::string> lines(readChunk(input, chunkLines));
+            if (lines.size() == 0) {
+                break;
+            }
+
+            std::vector<std::vector<float>> rows(lines.size());
+
+            // Exceptions cannot leave a parallel region, so the first one is kept and rethrown.
+            std::exception_ptr error(nullptr);
+
+            #pragma omp parallel for
+            for (size_t i = 0; i < lines.size(); i++) {
+                std::vector<float> &row(rows[i]);
+                try {
+                    DenseDataRowFactory::parseLine(lines[i], [&row](const float value) {
+                        row.push_back(value);
+                    });
+                } catch (...) {
+                    #pragma omp critical
+                    if (error == nullptr) {
+                        error = std::current_exception();
+                    }
+                }
+            }
+
+            if (error != nullptr) {
+                std::rethrow_exception(error);
+            }
+
+            for (const std::vector<float> &row : rows) {
+                matrix.push(row.data(), row.size());
+                matrix.finishRow();
+            }
+        }
+
+        if (normalize) {
+            #pragma omp parallel for
+            for (size_t i = 0; i < matrix.totalRows(); i++) {
+                matrix.normalizeRow(i);
+            }
+        }
+
+        matrix.shrinkToFit();
+        return matrix;
+    }
+
+    static CompressedSparseRows loadSparse(
+        std::istream &input,
+        const size_t adjacencyListColumnCount,
+        const bool normalize,
+        const size_t chunkLines
+    ) {
+        SparseDataRowFactory factory(adjacencyListColumnCount);
+        CompressedSparseRows rows(adjacencyListColumnCount);
+
+        std::vector<SparseDataRowFactory::Edge> edges;
+        size_t position = 0;
+        auto nextEdge = [&input, &edges, &position, chunkLines]() -> std::optional<SparseDataRowFactory::Edge> {
+            if (position == edges.size()) {
+                std::vector<std::string> lines(readChunk(input, chunkLines));
+                edges.resize(lines.size());
+                position = 0;
+
+                #pragma omp parallel for
+                for (size_t i = 0; i < lines.size(); i++) {
+                    edges[i] = SparseDataRowFactory::parseEdge(lines[i]);
+                }
+
+                if (edges.size() == 0) {
+                    return std::nullopt;
+                }
+            }
+
+            return edges[position++];
+        };
+
+        while (factory.appendFromEdges(nextEdge, rows)) {}
+
+        if (normalize) {
+            #pragma omp parallel for
+            for (size_t i = 0; i < rows.totalRows(); i++) {
+                rows.normalizeRow(i);
+            }
+        }
+
+        rows.shrinkToFit();
+        return rows;
+    }
+
+    private:
+    static std::vector<std::string> readChunk(std::istream &input, const size_t chunkLines) {
+        std::vector<std::string> lines;
+        std::string line;
+        while (lines.size() < chunkLines && std::getline(input, line)) {
+            lines.push_back(std::move(line));
+        }
+
+        return lines;
+    }
+};
+
+#endif
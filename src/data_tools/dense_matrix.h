@@ -0,0 +1,249 @@
+#include <vector>
+#include <numeric>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <memory>
+#include <stdexcept>
+
+#include "data_row.h"
+#include "data_row_visitor.h"
+
+#ifndef DENSE_MATRIX_H
+#define DENSE_MATRIX_H
+
+/**
+ * Hands out memory aligned to the given number of bytes so that rows of a DenseMatrix
+ * start on a cache line and can be loaded with aligned vector instructions.
+ */
+template <typename T, size_t Alignment>
+class AlignedAllocator {
+    public:
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() {}
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+    T* allocate(const size_t n) {
+        const size_t bytes = ((n * sizeof(T) + Alignment - 1) / Alignment) * Alignment;
+        void *memory = std::aligned_alloc(Alignment, bytes);
+        if (memory == nullptr) {
+            throw std::bad_alloc();
+        }
+
+        return static_cast<T*>(memory);
+    }
+
+    void deallocate(T* memory, const size_t _n) {
+        std::free(memory);
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment> &) const {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment> &) const {
+        return false;
+    }
+};
+
+/**
+ * Stores a set of dense rows in a single row-major buffer. Every row starts on a 64 byte
+ * boundary and is padded with zeros up to the stride, so kernels can walk whole cache lines
+ * without a remainder loop. Rows are appended one value at a time and sealed with finishRow(),
+ * or the matrix can wrap a read-only buffer owned by someone else, such as a mapped file.
+ */
+class DenseMatrix {
+    public:
+    static const size_t ALIGNMENT_BYTES = 64;
+    static const size_t FLOATS_PER_ALIGNMENT = ALIGNMENT_BYTES / sizeof(float);
+
+    static size_t paddedColumns(const size_t columns) {
+        return ((columns + FLOATS_PER_ALIGNMENT - 1) / FLOATS_PER_ALIGNMENT) * FLOATS_PER_ALIGNMENT;
+    }
+
+    private:
+    size_t columns;
+    size_t stride;
+    size_t rows;
+    std::vector<float, AlignedAllocator<float, ALIGNMENT_BYTES>> values;
+
+    // Only set when this matrix wraps external storage, in which case values stays empty.
+    std::shared_ptr<const void> owner;
+    const float* external;
+
+    const float* base() const {
+        return this->external != nullptr ? this->external : this->values.data();
+    }
+
+    class AppendingVisitor : public DataRowVisitor {
+        private:
+        DenseMatrix &matrix;
+
+        public:
+        AppendingVisitor(DenseMatrix &matrix) : matrix(matrix) {}
+
+        void visitDenseDataRow(const std::vector<float>& data) {
+            this->visitDenseDataRowView(data.data(), data.size());
+        }
+
+        void visitDenseDataRowView(const float* data, const size_t totalColumns) {
+            for (size_t i = 0; i < totalColumns; i++) {
+                matrix.push(data[i]);
+            }
+        }
+
+        void visitSparseDataRow(const std::map<size_t, float>& data, size_t totalColumns) {
+            auto iterator = data.begin();
+            for (size_t i = 0; i < totalColumns; i++) {
+                if (iterator != data.end() && iterator->first == i) {
+                    matrix.push(iterator->second);
+                    iterator++;
+                } else {
+                    matrix.push(0);
+                }
+            }
+        }
+    };
+
+    public:
+    DenseMatrix() : columns(0), stride(0), rows(0), owner(nullptr), external(nullptr) {}
+
+    /**
+     * Wraps rows * stride floats owned by owner. The buffer must be aligned to ALIGNMENT_BYTES, 
+     * stride must be a multiple of FLOATS_PER_ALIGNMENT, and padding must be zero.
+     */
+    static DenseMatrix wrap(
+        std::shared_ptr<const void> owner, 
+        const float* data, 
+        const size_t rows, 
+        const size_t columns, 
+        const size_t stride
+    ) {
+        if (reinterpret_cast<uintptr_t>(data) % ALIGNMENT_BYTES != 0 || stride != paddedColumns(columns)) {
+            throw std::invalid_argument("ERROR: wrapped dense rows must be aligned and padded");
+        }
+
+        DenseMatrix matrix;
+        matrix.owner = std::move(owner);
+        matrix.external = data;
+        matrix.rows = rows;
+        matrix.columns = columns;
+        matrix.stride = stride;
+        return matrix;
+    }
+
+    void push(const float value) {
+        this->values.push_back(value);
+    }
+
+    void push(const float* data, const size_t count) {
+        this->values.insert(this->values.end(), data, data + count);
+    }
+
+    void append(const DataRow &row) {
+        AppendingVisitor visitor(*this);
+        row.voidVisit(visitor);
+        this->finishRow();
+    }
+
+    /**
+     * Seals the values pushed since the last call as a new row. The first row decides the
+     * number of columns, every following row must have the same length.
+     */
+    void finishRow() {
+        if (this->external != nullptr) {
+            throw std::invalid_argument("ERROR: cannot append rows to a wrapped dense matrix");
+        }
+
+        const size_t start = this->rows * this->stride;
+        const size_t rowColumns = this->values.size() - start;
+
+        if (this->rows == 0) {
+            this->columns = rowColumns;
+            this->stride = paddedColumns(rowColumns);
+        } else if (rowColumns != this->columns) {
+            spdlog::error("row {0:d} has {1:d} columns but expected {2:d}", this->rows, rowColumns, this->columns);
+            throw std::invalid_argument("ERROR: every row of a dense matrix must have the same number of columns");
+        }
+
+        this->values.resize(start + this->stride, 0);
+        this->rows++;
+    }
+
+    /**
+     * Divides the last finished row by its euclidian norm. Mirrors NormalizedDataRowFactory so
+     * that rows normalized here are identical to rows normalized by the factory.
+     */
+    void normalizeLastRow() {
+        this->normalizeRow(this->rows - 1);
+    }
+
+    /**
+     * Same as normalizeLastRow for any finished row. Different rows can be normalized in parallel.
+     */
+    void normalizeRow(const size_t i) {
+        if (this->external != nullptr) {
+            throw std::invalid_argument("ERROR: cannot modify a wrapped dense matrix");
+        }
+
+        float *row = this->values.data() + i * this->stride;
+        const long double eclidian_norm = std::sqrt(
+            std::inner_product(row, row + this->columns, row, 0.0L)
+        );
+
+        for (size_t i = 0; i < this->columns; i++) {
+            row[i] = row[i] / eclidian_norm;
+        }
+    }
+
+    void shrinkToFit() {
+        this->values.shrink_to_fit();
+    }
+
+    size_t totalRows() const {
+        return this->rows;
+    }
+
+    size_t getTotalColumns() const {
+        return this->columns;
+    }
+
+    size_t getStride() const {
+        return this->stride;
+    }
+
+    size_t getStorageBytes() const {
+        if (this->external != nullptr) {
+            return this->rows * this->stride * sizeof(float);
+        }
+
+        return this->values.capacity() * sizeof(float);
+    }
+
+    /**
+     * Start of row i, aligned to ALIGNMENT_BYTES. Only valid until the next row is appended.
+     */
+    const float* getRowData(const size_t i) const {
+        return this->base() + i * this->stride;
+    }
+
+    /**
+     * Views are only valid until the next row is appended.
+     */
+    DenseDataRowView getRow(const size_t i) const {
+        return DenseDataRowView(this->getRowData(i), this->columns);
+    }
+};
+
+#endif
@@ -1,8 +1,10 @@
 
 #include <optional>
 #include <iostream>
+#include <algorithm>
 
 #include "data_row_visitor.h"
+#include "simd_kernels.h"
 
 #ifndef DOT_PRODUCT_VISITOR_H
 #define DOT_PRODUCT_VISITOR_H
@@ -17,12 +19,7 @@ class DenseDotProductDataRowVisitor : public ReturningDataRowVisitor<float> {
     : base(input), result(std::nullopt) {}
 
     void visitDenseDataRow(const std::vector<float>& data) {
-        float dotProduct = 0;
-        for (size_t i = 0; i < this->base.size() && i < data.size(); i++) {
-            dotProduct += this->base[i] * data[i];
-        }
-
-        this->result = dotProduct;
+        this->result = SimdKernels::dot(this->base.data(), data.data(), std::min(this->base.size(), data.size()));
     }
 
     void visitSparseDataRow(const std::map<size_t, float>& data, size_t _totalColumns) {
@@ -34,6 +31,14 @@ class DenseDotProductDataRowVisitor : public ReturningDataRowVisitor<float> {
         this->result = dotProduct;
     }
 
+    void visitSparseDataRowView(const unsigned int* columns, const float* values, const size_t nonZeros, const size_t _totalColumns) {
+        this->result = SimdKernels::gatherDot(this->base.data(), columns, values, nonZeros);
+    }
+
+    void visitDenseDataRowView(const float* data, const size_t totalColumns) {
+        this->result = SimdKernels::dot(this->base.data(), data, std::min(this->base.size(), totalColumns));
+    }
+
     float get() {
         return this->result.value();
     }
@@ -57,6 +62,15 @@ class SparseDotProductDataRowVisitor : public ReturningDataRowVisitor<float> {
         this->result = dotProduct;
     }
 
+    void visitDenseDataRowView(const float* data, const size_t _totalColumns) {
+        float dotProduct = 0;
+        for (const auto & p : this->base) {
+            dotProduct += data[p.first] * p.second;
+        }
+
+        this->result = dotProduct;
+    }
+
     void visitSparseDataRow(const std::map<size_t, float>& data, size_t _totalColumns) {
         float dotProduct = 0;
 
@@ -77,6 +91,112 @@ class SparseDotProductDataRowVisitor : public ReturningDataRowVisitor<float> {
         this->result = dotProduct;
     }
 
+    void visitSparseDataRowView(const unsigned int* columns, const float* values, const size_t nonZeros, const size_t _totalColumns) {
+        float dotProduct = 0;
+
+        auto baseIterator = this->base.begin();
+        size_t dataIndex = 0;
+        while (baseIterator != this->base.end() && dataIndex < nonZeros) {
+            if (columns[dataIndex] == baseIterator->first) {
+                dotProduct += values[dataIndex] * baseIterator->second;
+                dataIndex++;
+                baseIterator++;
+            } else if (columns[dataIndex] > baseIterator->first) {
+                baseIterator++;
+            } else  {
+                dataIndex++;
+            }
+        }
+
+        this->result = dotProduct;
+    }
+
+    float get() {
+        return this->result.value();
+    }
+};
+
+class SparseViewDotProductDataRowVisitor : public ReturningDataRowVisitor<float> {
+    private:
+    std::optional<float> result;
+    const unsigned int* baseColumns;
+    const float* baseValues;
+    const size_t baseNonZeros;
+
+    public:
+    SparseViewDotProductDataRowVisitor(const unsigned int* columns, const float* values, const size_t nonZeros) 
+    : result(std::nullopt), baseColumns(columns), baseValues(values), baseNonZeros(nonZeros) {}
+
+    void visitDenseDataRow(const std::vector<float>& data) {
+        this->result = SimdKernels::gatherDot(data.data(), this->baseColumns, this->baseValues, this->baseNonZeros);
+    }
+
+    void visitDenseDataRowView(const float* data, const size_t _totalColumns) {
+        this->result = SimdKernels::gatherDot(data, this->baseColumns, this->baseValues, this->baseNonZeros);
+    }
+
+    void visitSparseDataRow(const std::map<size_t, float>& data, size_t _totalColumns) {
+        SparseDotProductDataRowVisitor delegate(data);
+        delegate.visitSparseDataRowView(this->baseColumns, this->baseValues, this->baseNonZeros, _totalColumns);
+        this->result = delegate.get();
+    }
+
+    void visitSparseDataRowView(const unsigned int* columns, const float* values, const size_t nonZeros, const size_t _totalColumns) {
+        float dotProduct = 0;
+
+        size_t baseIndex = 0;
+        size_t dataIndex = 0;
+        while (baseIndex < this->baseNonZeros && dataIndex < nonZeros) {
+            if (columns[dataIndex] == this->baseColumns[baseIndex]) {
+                dotProduct += values[dataIndex] * this->baseValues[baseIndex];
+                dataIndex++;
+                baseIndex++;
+            } else if (columns[dataIndex] > this->baseColumns[baseIndex]) {
+                baseIndex++;
+            } else  {
+                dataIndex++;
+            }
+        }
+
+        this->result = dotProduct;
+    }
+
+    float get() {
+        return this->result.value();
+    }
+};
+
+class DenseViewDotProductDataRowVisitor : public ReturningDataRowVisitor<float> {
+    private:
+    std::optional<float> result;
+    const float* base;
+    const size_t baseColumns;
+
+    public:
+    DenseViewDotProductDataRowVisitor(const float* input, const size_t columns) 
+    : result(std::nullopt), base(input), baseColumns(columns) {}
+
+    void visitDenseDataRow(const std::vector<float>& data) {
+        this->visitDenseDataRowView(data.data(), data.size());
+    }
+
+    void visitDenseDataRowView(const float* data, const size_t totalColumns) {
+        this->result = SimdKernels::dot(this->base, data, std::min(this->baseColumns, totalColumns));
+    }
+
+    void visitSparseDataRow(const std::map<size_t, float>& data, size_t _totalColumns) {
+        float dotProduct = 0;
+        for (const auto & p : data) {
+            dotProduct += this->base[p.first] * p.second;
+        }
+
+        this->result = dotProduct;
+    }
+
+    void visitSparseDataRowView(const unsigned int* columns, const float* values, const size_t nonZeros, const size_t _totalColumns) {
+        this->result = SimdKernels::gatherDot(this->base, columns, values, nonZeros);
+    }
+
     float get() {
         return this->result.value();
     }
@@ -0,0 +1,200 @@
+#include <map>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+#include "data_row.h"
+#include "data_row_visitor.h"
+#include "row_kernels.h"
+
+#ifndef INVERTED_COLUMN_INDEX_H
+#define INVERTED_COLUMN_INDEX_H
+
+/**
+ * The rows of a dataset grouped by column. Each column keeps a posting list of the rows that
+ * have a value in it, in increasing order, along with those values. The similarities of one
+ * row against every row then only cost a walk over the posting lists of its own non zeros,
+ * instead of a pass over the whole dataset.
+ */
+class InvertedColumnIndex {
+    public:
+    /**
+     * The non zeros of one row in column order, whatever the layout of the row.
+     */
+    class RowEntries : public DataRowVisitor {
+        public:
+        std::vector<unsigned int> columns;
+        std::vector<float> values;
+
+        static RowEntries of(const DataRow &row) {
+            RowEntries entries;
+            row.voidVisit(entries);
+            return entries;
+        }
+
+        SparseRowRef getRow() const {
+            return SparseRowRef{this->columns.data(), this->values.data(), this->columns.size()};
+        }
+
+        void visitDenseDataRow(const std::vector<float>& data) {
+            this->visitDenseDataRowView(data.data(), data.size());
+        }
+
+        void visitDenseDataRowView(const float* data, const size_t totalColumns) {
+            for (size_t c = 0; c < totalColumns; c++) {
+                if (data[c] != 0) {
+                    this->columns.push_back(c);
+                    this->values.push_back(data[c]);
+                }
+            }
+        }
+
+        void visitSparseDataRow(const std::map<size_t, float>& data, size_t _totalColumns) {
+            for (const auto & p : data) {
+                this->columns.push_back(p.first);
+                this->values.push_back(p.second);
+            }
+        }
+
+        void visitSparseDataRowView(const unsigned int* columns, const float* values, const size_t nonZeros, const size_t _totalColumns) {
+            this->columns.assign(columns, columns + nonZeros);
+            this->values.assign(values, values + nonZeros);
+        }
+    };
+
+    private:
+    const size_t rows;
+    std::vector<size_t> offsets;
+    std::vector<unsigned int> postings;
+    std::vector<float> values;
+
+    // Disable pass by value. This object is too large for pass by value to make sense implicitly.
+    InvertedColumnIndex(const InvertedColumnIndex &);
+
+    InvertedColumnIndex(const size_t rows, const size_t columns) : rows(rows), offsets(columns + 1, 0) {}
+
+    /**
+     * Two passes over the rows, one to size every posting list and one to fill them. Rows are
+     *  visited in order, so every posting list comes out sorted. Columns past the expected count
+     *  grow the index rather than being dropped.
+     */
+    template <typename GetRow>
+    static std::unique_ptr<InvertedColumnIndex> build(const size_t rows, const size_t columns, GetRow getRow) {
+        std::unique_ptr<InvertedColumnIndex> index(new InvertedColumnIndex(rows, columns));
+        for (size_t i = 0; i < rows; i++) {
+            const SparseRowRef row(getRow(i));
+            for (size_t k = 0; k < row.nonZeros; k++) {
+                if (row.columns[k] + 1 >= index->offsets.size()) {
+                    index->offsets.resize(row.columns[k] + 2, 0);
+                }
+                index->offsets[row.columns[k] + 1]++;
+            }
+        }
+
+        const size_t indexed = index->offsets.size() - 1;
+        for (size_t c = 0; c < indexed; c++) {
+            index->offsets[c + 1] += index->offsets[c];
+        }
+
+        index->postings.resize(index->offsets[indexed]);
+        index->values.resize(index->offsets[indexed]);
+        std::vector<size_t> next(index->offsets.begin(), index->offsets.end() - 1);
+        for (size_t i = 0; i < rows; i++) {
+            const SparseRowRef row(getRow(i));
+            for (size_t k = 0; k < row.nonZeros; k++) {
+                const size_t position = next[row.columns[k]]++;
+                index->postings[position] = i;
+                index->values[position] = row.values[k];
+            }
+        }
+
+        return index;
+    }
+
+    public:
+    static std::unique_ptr<InvertedColumnIndex> fromRows(const std::vector<SparseRowRef> &rows, const size_t columns) {
+        return build(rows.size(), columns, [&rows](const size_t i) { return rows[i]; });
+    }
+
+    /**
+     * Indexes rows of any layout. Rows without raw sparse storage are decoded twice, once for
+     *  each pass, rather than held all at once.
+     */
+    template <typename GetDataRow>
+    static std::unique_ptr<InvertedColumnIndex> fromDataRows(const size_t rows, const size_t columns, GetDataRow getDataRow) {
+        RowEntries entries;
+        return build(rows, columns, [&entries, &getDataRow](const size_t i) {
+            entries.columns.clear();
+            entries.values.clear();
+            getDataRow(i).voidVisit(entries);
+            return entries.getRow();
+        });
+    }
+
+    size_t totalRows() const {
+        return this->rows;
+    }
+
+    size_t totalColumns() const {
+        return this->offsets.size() - 1;
+    }
+
+    size_t totalNonZeros() const {
+        return this->postings.size();
+    }
+
+    /**
+     * The rows with a value in column, sorted, and their values at the same positions.
+     */
+    const unsigned int* getPostings(const size_t column) const {
+        return this->postings.data() + this->offsets[column];
+    }
+
+    const float* getValues(const size_t column) const {
+        return this->values.data() + this->offsets[column];
+    }
+
+    size_t getPostingCount(const size_t column) const {
+        return this->offsets[column + 1] - this->offsets[column];
+    }
+
+    /**
+     * The number of products accumulate does for row, which is also how many of the posting
+     *  lists it reads.
+     */
+    size_t getPostingCount(const SparseRowRef &row) const {
+        size_t total = 0;
+        for (size_t k = 0; k < row.nonZeros && row.columns[k] < this->totalColumns(); k++) {
+            total += this->getPostingCount(row.columns[k]);
+        }
+
+        return total;
+    }
+
+    /**
+     * Adds the products of row with every indexed row from first up to last into output,
+     *  which is indexed by row. Products are added in column order, so starting from zeros
+     *  every entry is bit-identical to RowKernels::dot of the two sparse rows. Columns of row
+     *  that no indexed row has a value in add nothing.
+     */
+    void accumulate(const SparseRowRef &row, float* output, const unsigned int first, const unsigned int last) const {
+        for (size_t k = 0; k < row.nonZeros && row.columns[k] < this->totalColumns(); k++) {
+            const unsigned int column = row.columns[k];
+            const unsigned int* columnRows = this->getPostings(column);
+            const unsigned int* columnEnd = columnRows + this->getPostingCount(column);
+            const float* columnValues = this->getValues(column);
+            const unsigned int* start = first == 0 ? columnRows : std::lower_bound(columnRows, columnEnd, first);
+            for (const unsigned int* i = start; i != columnEnd && *i < last; i++) {
+                output[*i] += columnValues[i - columnRows] * row.values[k];
+            }
+        }
+    }
+
+    size_t getStorageBytes() const {
+        return this->offsets.capacity() * sizeof(size_t)
+            + this->postings.capacity() * sizeof(unsigned int)
+            + this->values.capacity() * sizeof(float);
+    }
+};
+
+#endif
@@ -0,0 +1,75 @@
+#include <string>
+#include <memory>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+/**
+ * A read-only mapping of an entire file. Pages are shared with every other process that maps
+ * the same file, so ranks on the same node only pay for the dataset once.
+ */
+class MappedFile {
+    private:
+    const char* data;
+    size_t bytes;
+
+    MappedFile(const MappedFile &);
+
+    MappedFile(const char* data, const size_t bytes) : data(data), bytes(bytes) {}
+
+    public:
+    static std::shared_ptr<MappedFile> open(const std::string &path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            spdlog::error("could not open {}", path);
+            throw std::invalid_argument("ERROR: could not open input file");
+        }
+
+        struct stat status;
+        if (fstat(fd, &status) != 0) {
+            ::close(fd);
+            throw std::invalid_argument("ERROR: could not stat input file");
+        }
+
+        const size_t bytes = status.st_size;
+        void *mapping = bytes == 0 ? nullptr : mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+
+        if (mapping == MAP_FAILED) {
+            spdlog::error("could not map {0} of {1:d} bytes", path, bytes);
+            throw std::invalid_argument("ERROR: could not map input file");
+        }
+
+        return std::shared_ptr<MappedFile>(new MappedFile(static_cast<const char*>(mapping), bytes));
+    }
+
+    ~MappedFile() {
+        if (this->data != nullptr) {
+            munmap(const_cast<char*>(this->data), this->bytes);
+        }
+    }
+
+    /**
+     * Hints that the file will be read front to back, so the kernel can read ahead further.
+     */
+    void adviseSequential() const {
+        if (this->data != nullptr) {
+            madvise(const_cast<char*>(this->data), this->bytes, MADV_SEQUENTIAL);
+        }
+    }
+
+    const char* getData() const {
+        return this->data;
+    }
+
+    size_t size() const {
+        return this->bytes;
+    }
+};
+
+#endif
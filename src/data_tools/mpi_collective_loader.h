@@ -0,0 +1,502 @@
+#include <mpi.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <climits>
+#include <optional>
+#include <exception>
+#include <stdexcept>
+#include <unordered_map>
+#include <omp.h>
+
+#include "base_data.h"
+#include "data_row_factory.h"
+#include "parallel_text_loader.h"
+#include "dense_matrix.h"
+#include "compressed_sparse_rows.h"
+
+#ifndef MPI_COLLECTIVE_LOADER_H
+#define MPI_COLLECTIVE_LOADER_H
+
+/**
+ * Loads a text input with every rank reading a disjoint share of the file through MPI-IO,
+ * instead of every rank reading the whole file. Each rank parses the lines that start in its
+ * share with every thread, then rows are sent to the rank that owns them in a single
+ * MPI_Alltoallv. Must be called by every rank of MPI_COMM_WORLD.
+ *
+ * Rows are sent as a RowRecordHeader followed by the row, count floats for dense rows or
+ * count (column, value) pairs for sparse rows. Every record is padded to 8 bytes.
+ */
+class MpiCollectiveLoader {
+    private:
+    static constexpr MPI_Offset READ_BLOCK_BYTES = 1 << 30;
+    static constexpr MPI_Offset TAIL_BLOCK_BYTES = 1 << 16;
+
+    struct RowRecordHeader {
+        uint64_t row;
+        uint64_t count;
+    };
+
+    struct SparseEntry {
+        uint32_t column;
+        float value;
+    };
+
+    /**
+     * The adjacency list fields that carry over from one line to the next. fields marks which
+     * of row, column and value were set by at least one line.
+     */
+    struct CarriedState {
+        int64_t row;
+        int64_t to;
+        float value;
+        uint32_t fields;
+    };
+
+    static constexpr uint32_t ROW_FIELD = 1;
+    static constexpr uint32_t TO_FIELD = 2;
+    static constexpr uint32_t VALUE_FIELD = 4;
+
+    /**
+     * The share of the input read by this rank. Lines that start in the share are found at
+     * [firstLine, data.size()) and the last of them is read to its end.
+     */
+    struct LocalText {
+        std::vector<char> data;
+        size_t firstLine;
+    };
+
+    public:
+    static std::unique_ptr<BaseData> load(
+        const std::string &path,
+        const size_t adjacencyListColumnCount,
+        const bool normalize,
+        const std::vector<unsigned int> &rankMapping,
+        const int rank,
+        const int worldSize
+    ) {
+        LocalText text(readShare(path, rank, worldSize));
+
+        std::vector<std::vector<char>> sendBuffers(worldSize);
+        if (adjacencyListColumnCount > 0) {
+            encodeSparseRows(text, rankMapping, rank, worldSize, sendBuffers);
+        } else {
+            encodeDenseRows(text, rankMapping, rank, sendBuffers);
+        }
+        text.data = std::vector<char>();
+
+        std::vector<int> receiveDisplacements;
+        const std::vector<char> received(exchange(sendBuffers, worldSize, receiveDisplacements));
+
+        std::vector<size_t> localRowToGlobalRow;
+        std::unordered_map<size_t, size_t> globalRowToLocalRow;
+        const unsigned int owner = rank;
+        for (size_t globalRow = 0; globalRow < rankMapping.size(); globalRow++) {
+            if (rankMapping[globalRow] == owner) {
+                globalRowToLocalRow.insert({globalRow, localRowToGlobalRow.size()});
+                localRowToGlobalRow.push_back(globalRow);
+            }
+        }
+
+        // Records are received in order of the rank that sent them, so the pieces of a row
+        //  that spans several shares stay in file order.
+        std::vector<std::vector<const RowRecordHeader*>> pieces(localRowToGlobalRow.size());
+        size_t position = 0;
+        while (position < received.size()) {
+            const RowRecordHeader* record = reinterpret_cast<const RowRecordHeader*>(received.data() + position);
+            pieces[globalRowToLocalRow.at(record->row)].push_back(record);
+            position += recordBytes(record->count, adjacencyListColumnCount > 0);
+        }
+
+        if (adjacencyListColumnCount > 0) {
+            CompressedSparseRows rows(adjacencyListColumnCount);
+            for (const std::vector<const RowRecordHeader*> &rowPieces : pieces) {
+                for (const RowRecordHeader* record : rowPieces) {
+                    const SparseEntry* entries = reinterpret_cast<const SparseEntry*>(record + 1);
+                    for (size_t i = 0; i < record->count; i++) {
+                        rows.push(entries[i].column, entries[i].value);
+                    }
+                }
+                rows.finishRow();
+            }
+
+            if (normalize) {
+                #pragma omp parallel for
+                for (size_t i = 0; i < rows.totalRows(); i++) {
+                    rows.normalizeRow(i);
+                }
+            }
+
+            rows.shrinkToFit();
+            return std::unique_ptr<BaseData>(
+                new CompressedSparseRowData(std::move(rows), std::move(localRowToGlobalRow), std::move(globalRowToLocalRow))
+            );
+        }
+
+        DenseMatrix matrix;
+        for (const std::vector<const RowRecordHeader*> &rowPieces : pieces) {
+            if (rowPieces.size() != 1) {
+                throw std::invalid_argument("ERROR: a dense row was not received exactly once during a collective load");
+            }
+
+            matrix.push(reinterpret_cast<const float*>(rowPieces[0] + 1), rowPieces[0]->count);
+            matrix.finishRow();
+        }
+
+        if (normalize) {
+            #pragma omp parallel for
+            for (size_t i = 0; i < matrix.totalRows(); i++) {
+                matrix.normalizeRow(i);
+            }
+        }
+
+        matrix.shrinkToFit();
+        return std::unique_ptr<BaseData>(
+            new DenseMatrixData(std::move(matrix), std::move(localRowToGlobalRow), std::move(globalRowToLocalRow))
+        );
+    }
+
+    private:
+    static size_t recordBytes(const size_t count, const bool sparse) {
+        const size_t payload = count * (sparse ? sizeof(SparseEntry) : sizeof(float));
+        return sizeof(RowRecordHeader) + ((payload + 7) / 8) * 8;
+    }
+
+    static void appendRecord(std::vector<char> &buffer, const uint64_t row, const void* payload, const size_t count, const bool sparse) {
+        const size_t start = buffer.size();
+        buffer.resize(start + recordBytes(count, sparse), 0);
+
+        const RowRecordHeader header{row, count};
+        std::memcpy(buffer.data() + start, &header, sizeof(RowRecordHeader));
+        std::memcpy(buffer.data() + start + sizeof(RowRecordHeader), payload, count * (sparse ? sizeof(SparseEntry) : sizeof(float)));
+    }
+
+    static LocalText readShare(const std::string &path, const int rank, const int worldSize) {
+        MPI_File file;
+        if (MPI_File_open(MPI_COMM_WORLD, path.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+            spdlog::error("could not open {}", path);
+            throw std::invalid_argument("ERROR: could not open input file");
+        }
+
+        MPI_Offset bytes;
+        MPI_File_get_size(file, &bytes);
+
+        const MPI_Offset share = bytes / worldSize;
+        const MPI_Offset start = share * rank;
+        const MPI_Offset end = rank == worldSize - 1 ? bytes : share * (rank + 1);
+
+        // The byte before the share tells whether the share starts with a new line.
+        const MPI_Offset readStart = start > 0 ? start - 1 : 0;
+        LocalText text;
+        text.data.resize(end - readStart);
+
+        // Every rank has to take part in every collective read, even once its share is done.
+        const MPI_Offset largestShare = bytes - share * (worldSize - 1) + 1;
+        const MPI_Offset reads = (largestShare + READ_BLOCK_BYTES - 1) / READ_BLOCK_BYTES;
+        for (MPI_Offset i = 0; i < reads; i++) {
+            const MPI_Offset offset = std::min<MPI_Offset>(i * READ_BLOCK_BYTES, text.data.size());
+            const int count = std::min<MPI_Offset>(READ_BLOCK_BYTES, text.data.size() - offset);
+            MPI_File_read_at_all(file, readStart + offset, text.data.data() + offset, count, MPI_CHAR, MPI_STATUS_IGNORE);
+        }
+
+        if (start == 0) {
+            text.firstLine = 0;
+        } else {
+            const void* newline = std::memchr(text.data.data(), '\n', text.data.size());
+            text.firstLine = newline == nullptr ? text.data.size() : static_cast<const char*>(newline) - text.data.data() + 1;
+        }
+
+        // The last line that starts in this share may end in the next one.
+        MPI_Offset tail = end;
+        const bool hasLines = text.firstLine < text.data.size();
+        while (hasLines && tail < bytes && text.data.back() != '\n') {
+            std::vector<char> block(std::min<MPI_Offset>(TAIL_BLOCK_BYTES, bytes - tail));
+            MPI_File_read_at(file, tail, block.data(), block.size(), MPI_CHAR, MPI_STATUS_IGNORE);
+
+            const void* newline = std::memchr(block.data(), '\n', block.size());
+            const size_t used = newline == nullptr ? block.size() : static_cast<const char*>(newline) - block.data() + 1;
+            text.data.insert(text.data.end(), block.begin(), block.begin() + used);
+            tail += used;
+        }
+
+        MPI_File_close(&file);
+        return text;
+    }
+
+    static std::vector<size_t> splitLocalText(const LocalText &text) {
+        const char* data = text.data.data() + text.firstLine;
+        const size_t bytes = text.data.size() - text.firstLine;
+        const size_t ranges = std::max<size_t>(1, std::min<size_t>(omp_get_max_threads(), bytes >> 16));
+        return ParallelTextLoader::splitAtLines(data, bytes, ranges);
+    }
+
+    static void encodeDenseRows(
+        const LocalText &text,
+        const std::vector<unsigned int> &rankMapping,
+        const int rank,
+        std::vector<std::vector<char>> &sendBuffers
+    ) {
+        const char* data = text.data.data() + text.firstLine;
+        const std::vector<size_t> boundaries(splitLocalText(text));
+        const size_t ranges = boundaries.size() - 1;
+        std::vector<std::vector<float>> values(ranges);
+        std::vector<std::vector<size_t>> rowLengths(ranges);
+        std::exception_ptr error(nullptr);
+
+        #pragma omp parallel for schedule(static, 1)
+        for (size_t i = 0; i < ranges; i++) {
+            try {
+                ParallelTextLoader::forEachLine(data, boundaries[i], boundaries[i + 1], [&values, &rowLengths, i](const std::string_view line) {
+                    const size_t start = values[i].size();
+                    DenseDataRowFactory::parseLine(line, [&values, i](const float value) {
+                        values[i].push_back(value);
+                    });
+                    rowLengths[i].push_back(values[i].size() - start);
+                });
+            } catch (...) {
+                #pragma omp critical
+                if (error == nullptr) {
+                    error = std::current_exception();
+                }
+            }
+        }
+
+        throwIfAnyRankFailed(error);
+
+        unsigned long long localRows = 0;
+        for (const std::vector<size_t> &lengths : rowLengths) {
+            localRows += lengths.size();
+        }
+
+        unsigned long long firstRow = 0;
+        unsigned long long totalRows = 0;
+        MPI_Exscan(&localRows, &firstRow, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Allreduce(&localRows, &totalRows, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+        if (rank == 0) {
+            firstRow = 0;
+        }
+        throwIfTooFewRows(totalRows, rankMapping);
+
+        size_t globalRow = firstRow;
+        for (size_t i = 0; i < ranges; i++) {
+            const float* rowValues = values[i].data();
+            for (const size_t length : rowLengths[i]) {
+                if (globalRow < rankMapping.size()) {
+                    appendRecord(sendBuffers[rankMapping[globalRow]], globalRow, rowValues, length, false);
+                }
+                rowValues += length;
+                globalRow++;
+            }
+        }
+    }
+
+    /**
+     * Mirrors SparseDataRowFactory: a line belongs to the row named on it, and fields missing
+     * from a line keep the value they had on the line before, which may be in another share.
+     */
+    static void encodeSparseRows(
+        const LocalText &text,
+        const std::vector<unsigned int> &rankMapping,
+        const int rank,
+        const int worldSize,
+        std::vector<std::vector<char>> &sendBuffers
+    ) {
+        const char* data = text.data.data() + text.firstLine;
+        const std::vector<size_t> boundaries(splitLocalText(text));
+        const size_t ranges = boundaries.size() - 1;
+        std::vector<std::vector<SparseDataRowFactory::Edge>> edges(ranges);
+        std::exception_ptr error(nullptr);
+
+        #pragma omp parallel for schedule(static, 1)
+        for (size_t i = 0; i < ranges; i++) {
+            try {
+                ParallelTextLoader::forEachLine(data, boundaries[i], boundaries[i + 1], [&edges, i](const std::string_view line) {
+                    edges[i].push_back(SparseDataRowFactory::parseEdge(line));
+                });
+            } catch (...) {
+                #pragma omp critical
+                if (error == nullptr) {
+                    error = std::current_exception();
+                }
+            }
+        }
+        throwIfAnyRankFailed(error);
+
+        CarriedState local{0, 0, 1.0, 0};
+        for (const std::vector<SparseDataRowFactory::Edge> &rangeEdges : edges) {
+            for (const SparseDataRowFactory::Edge &edge : rangeEdges) {
+                carry(local, edge);
+            }
+        }
+
+        std::vector<CarriedState> states(worldSize);
+        MPI_Allgather(&local, sizeof(CarriedState), MPI_BYTE, states.data(), sizeof(CarriedState), MPI_BYTE, MPI_COMM_WORLD);
+
+        CarriedState incoming{0, 0, 1.0, 0};
+        for (int previous = 0; previous < rank; previous++) {
+            combine(incoming, states[previous]);
+        }
+
+        CarriedState everything(incoming);
+        for (int next = rank; next < worldSize; next++) {
+            combine(everything, states[next]);
+        }
+        throwIfTooFewRows(everything.fields & ROW_FIELD ? everything.row + 1 : 0, rankMapping);
+
+        CarriedState state(incoming);
+        std::vector<SparseEntry> entries;
+        int64_t entriesRow = -1;
+        auto flush = [&entries, &entriesRow, &rankMapping, &sendBuffers]() {
+            if (entries.size() > 0 && static_cast<size_t>(entriesRow) < rankMapping.size()) {
+                appendRecord(sendBuffers[rankMapping[entriesRow]], entriesRow, entries.data(), entries.size(), true);
+            }
+            entries.clear();
+        };
+
+        try {
+            for (const std::vector<SparseDataRowFactory::Edge> &rangeEdges : edges) {
+                for (const SparseDataRowFactory::Edge &edge : rangeEdges) {
+                    const int64_t previousRow = state.row;
+                    carry(state, edge);
+                    if (state.row < previousRow || state.row < 0) {
+                        spdlog::error("had current row of {0:d} and expected row of {1:d}", state.row, previousRow);
+                        throw std::invalid_argument("ERROR: cannot backtrack");
+                    }
+
+                    if (state.row != entriesRow) {
+                        flush();
+                        entriesRow = state.row;
+                    }
+                    entries.push_back(SparseEntry{static_cast<uint32_t>(state.to), state.value});
+                }
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        throwIfAnyRankFailed(error);
+        flush();
+    }
+
+    static void carry(CarriedState &state, const SparseDataRowFactory::Edge &edge) {
+        if (edge.elements > 0) {
+            state.row = edge.row;
+            state.fields |= ROW_FIELD;
+        }
+        if (edge.elements > 1) {
+            state.to = edge.to;
+            state.fields |= TO_FIELD;
+        }
+        if (edge.elements > 2) {
+            state.value = edge.value;
+            state.fields |= VALUE_FIELD;
+        }
+    }
+
+    /**
+     * Applies the fields left behind by a later share on top of state.
+     */
+    static void combine(CarriedState &state, const CarriedState &later) {
+        if (later.fields & ROW_FIELD) {
+            state.row = later.row;
+        }
+        if (later.fields & TO_FIELD) {
+            state.to = later.to;
+        }
+        if (later.fields & VALUE_FIELD) {
+            state.value = later.value;
+        }
+        state.fields |= later.fields;
+    }
+
+    static void throwIfTooFewRows(const size_t totalRows, const std::vector<unsigned int> &rankMapping) {
+        if (totalRows < rankMapping.size()) {
+            spdlog::error("expected at least {0:d} rows but the input only has {1:d}", rankMapping.size(), totalRows);
+            throw std::invalid_argument("The number of rows you have provided was incorrect.");
+        }
+    }
+
+    /**
+     * Collective. Every rank learns whether any rank failed, so they all throw together instead
+     *  of leaving the others blocked in the next collective. A rank that failed rethrows its own
+     *  error, the others report that a peer failed.
+     */
+    static void throwIfAnyRankFailed(const std::exception_ptr &error) {
+        int failed = error != nullptr;
+        int anyFailed = 0;
+        MPI_Allreduce(&failed, &anyFailed, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+        if (error != nullptr) {
+            try {
+                std::rethrow_exception(error);
+            } catch (const std::exception &e) {
+                spdlog::error("the collective load failed on this rank: {}", e.what());
+                throw;
+            }
+        }
+        if (anyFailed) {
+            spdlog::error("another rank failed during the collective load");
+            throw std::invalid_argument("ERROR: another rank failed during the collective load, see its log");
+        }
+    }
+
+    static std::vector<char> exchange(
+        const std::vector<std::vector<char>> &sendBuffers,
+        const int worldSize,
+        std::vector<int> &receiveDisplacements
+    ) {
+        std::vector<int> sendCounts(worldSize);
+        std::vector<int> sendDisplacements(worldSize);
+        size_t sendTotal = 0;
+        for (int i = 0; i < worldSize; i++) {
+            sendTotal += sendBuffers[i].size();
+        }
+        throwIfAnyRankFailed(sendTotal > INT_MAX
+            ? std::make_exception_ptr(std::invalid_argument("ERROR: a collective load can send at most 2GiB from each rank, use more ranks"))
+            : nullptr);
+
+        sendTotal = 0;
+        for (int i = 0; i < worldSize; i++) {
+            sendCounts[i] = sendBuffers[i].size();
+            sendDisplacements[i] = sendTotal;
+            sendTotal += sendBuffers[i].size();
+        }
+
+        std::vector<char> send;
+        send.reserve(sendTotal);
+        for (const std::vector<char> &buffer : sendBuffers) {
+            send.insert(send.end(), buffer.begin(), buffer.end());
+        }
+
+        std::vector<int> receiveCounts(worldSize);
+        MPI_Alltoall(sendCounts.data(), 1, MPI_INT, receiveCounts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+
+        receiveDisplacements.assign(worldSize, 0);
+        size_t receiveTotal = 0;
+        for (int i = 0; i < worldSize; i++) {
+            receiveDisplacements[i] = receiveTotal;
+            receiveTotal += receiveCounts[i];
+        }
+
+        throwIfAnyRankFailed(receiveTotal > INT_MAX
+            ? std::make_exception_ptr(std::invalid_argument("ERROR: a collective load can receive at most 2GiB on each rank, use more ranks"))
+            : nullptr);
+
+        std::vector<char> received(receiveTotal);
+        MPI_Alltoallv(
+            send.data(),
+            sendCounts.data(),
+            sendDisplacements.data(),
+            MPI_BYTE,
+            received.data(),
+            receiveCounts.data(),
+            receiveDisplacements.data(),
+            MPI_BYTE,
+            MPI_COMM_WORLD
+        );
+
+        return received;
+    }
+};
+
+#endif
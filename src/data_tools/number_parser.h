@@ -0,0 +1,75 @@
+#include <string>
+#include <charconv>
+#include <cctype>
+#include <string_view>
+#include <stdexcept>
+#include <system_error>
+
+#ifndef NUMBER_PARSER_H
+#define NUMBER_PARSER_H
+
+/**
+ * Locale independent number parsing on top of std::from_chars, without the allocation of
+ * std::stod or the stream of std::istringstream. Leading whitespace and a single leading
+ * '+' are accepted like strtod does, and parsing stops at the first character that is not
+ * part of the number.
+ */
+class NumberParser {
+    private:
+    // The precision of a default constructed stream.
+    static constexpr int STREAM_PRECISION = 6;
+
+    public:
+    /**
+     * Parses a number starting at position. On success position is moved past the number,
+     * on failure position is left where it was and false is returned.
+     */
+    template <typename T>
+    static bool tryParse(const char* &position, const char* end, T &result) {
+        const char* start = position;
+        while (start < end && std::isspace(static_cast<unsigned char>(*start))) {
+            start++;
+        }
+
+        if (start < end && *start == '+' && (start + 1 == end || start[1] != '-')) {
+            start++;
+        }
+
+        const std::from_chars_result parsed(std::from_chars(start, end, result));
+        if (parsed.ec != std::errc()) {
+            return false;
+        }
+
+        position = parsed.ptr;
+        return true;
+    }
+
+    /**
+     * Parses a whole token, ignoring anything after the number like std::stod does.
+     */
+    template <typename T>
+    static T parse(const std::string_view token) {
+        const char* position = token.data();
+        T result;
+        if (!tryParse(position, token.data() + token.size(), result)) {
+            throw std::invalid_argument("ERROR: could not parse a number from \"" + std::string(token) + "\"");
+        }
+
+        return result;
+    }
+
+    /**
+     * Returns value as parse<T> reads it back after it has been written to a stream with the
+     * default precision, without the stream.
+     */
+    template <typename T>
+    static T reparse(const float value) {
+        char buffer[32];
+        const std::to_chars_result written(
+            std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::general, STREAM_PRECISION)
+        );
+        return parse<T>(std::string_view(buffer, written.ptr - buffer));
+    }
+};
+
+#endif
@@ -0,0 +1,308 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <optional>
+#include <exception>
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+#include <omp.h>
+
+#include "base_data.h"
+#include "mapped_file.h"
+#include "data_row_factory.h"
+#include "dense_matrix.h"
+#include "compressed_sparse_rows.h"
+
+#ifndef PARALLEL_TEXT_LOADER_H
+#define PARALLEL_TEXT_LOADER_H
+
+/**
+ * Loads the text inputs read by DenseDataRowFactory and SparseDataRowFactory with every
+ * thread at once. The file is mapped and split into one byte range per thread, each range
+ * starting at the beginning of a line, and every thread parses its own range. The parsed
+ * ranges are then stitched together in file order, so the result is identical to loading
+ * the file one line at a time through the factories.
+ */
+class ParallelTextLoader {
+    private:
+    // Ranges smaller than this are not worth the cost of an extra thread.
+    static constexpr size_t MIN_RANGE_BYTES = 1 << 16;
+
+    struct DenseRange {
+        std::vector<float> values;
+        std::vector<size_t> rowLengths;
+        std::vector<size_t> globalRows;
+        size_t lines;
+    };
+
+    public:
+    static std::unique_ptr<BaseData> load(
+        const std::string &path,
+        const size_t adjacencyListColumnCount,
+        const bool normalize
+    ) {
+        std::shared_ptr<MappedFile> file(MappedFile::open(path));
+        if (adjacencyListColumnCount > 0) {
+            return loadSparse(*file, adjacencyListColumnCount, normalize, nullptr, 0);
+        }
+
+        return loadDense(*file, normalize, nullptr, 0);
+    }
+
+    /**
+     * Loads only the rows assigned to this rank. Dense lines belonging to other ranks are
+     * never parsed.
+     */
+    static std::unique_ptr<BaseData> load(
+        const std::string &path,
+        const size_t adjacencyListColumnCount,
+        const bool normalize,
+        const std::vector<unsigned int> &rankMapping,
+        const unsigned int rank
+    ) {
+        std::shared_ptr<MappedFile> file(MappedFile::open(path));
+        if (adjacencyListColumnCount > 0) {
+            return loadSparse(*file, adjacencyListColumnCount, normalize, &rankMapping, rank);
+        }
+
+        return loadDense(*file, normalize, &rankMapping, rank);
+    }
+
+    /**
+     * Splits data into at most ranges byte ranges. Range i is [boundaries[i], boundaries[i + 1]),
+     * and every range other than the first starts right after a newline.
+     */
+    static std::vector<size_t> splitAtLines(const char* data, const size_t bytes, const size_t ranges) {
+        std::vector<size_t> boundaries(ranges + 1, bytes);
+        boundaries[0] = 0;
+
+        for (size_t i = 1; i < ranges; i++) {
+            const size_t target = std::max(boundaries[i - 1], (bytes / ranges) * i);
+            if (target == 0 || target >= bytes) {
+                boundaries[i] = std::max(target, boundaries[i - 1]);
+                continue;
+            }
+
+            const void* newline = std::memchr(data + target - 1, '\n', bytes - target + 1);
+            boundaries[i] = newline == nullptr ? bytes : static_cast<const char*>(newline) - data + 1;
+        }
+
+        return boundaries;
+    }
+
+    /**
+     * Calls visit with every line in [start, end) in order. Like std::getline, a trailing
+     * newline does not start another line.
+     */
+    template <typename Visit>
+    static void forEachLine(const char* data, const size_t start, const size_t end, Visit visit) {
+        size_t position = start;
+        while (position < end) {
+            const void* newline = std::memchr(data + position, '\n', end - position);
+            const size_t lineEnd = newline == nullptr ? end : static_cast<const char*>(newline) - data;
+            visit(std::string_view(data + position, lineEnd - position));
+            position = lineEnd + 1;
+        }
+    }
+
+    private:
+    static size_t totalRanges(const size_t bytes) {
+        return std::max<size_t>(1, std::min<size_t>(omp_get_max_threads(), bytes / MIN_RANGE_BYTES));
+    }
+
+    static bool isAssigned(
+        const std::vector<unsigned int> *rankMapping,
+        const unsigned int rank,
+        const size_t globalRow
+    ) {
+        return rankMapping == nullptr || (globalRow < rankMapping->size() && (*rankMapping)[globalRow] == rank);
+    }
+
+    static std::unique_ptr<BaseData> loadDense(
+        const MappedFile &file,
+        const bool normalize,
+        const std::vector<unsigned int> *rankMapping,
+        const unsigned int rank
+    ) {
+        const std::vector<size_t> boundaries(splitAtLines(file.getData(), file.size(), totalRanges(file.size())));
+        const size_t ranges = boundaries.size() - 1;
+        std::vector<DenseRange> parsed(ranges);
+
+        // Lines have to be counted up front so that each range knows the global row of its
+        //  first line, and can skip rows owned by other ranks without parsing them.
+        std::vector<size_t> firstRow(ranges + 1, 0);
+        if (rankMapping != nullptr) {
+            #pragma omp parallel for schedule(static, 1)
+            for (size_t i = 0; i < ranges; i++) {
+                size_t lines = 0;
+                forEachLine(file.getData(), boundaries[i], boundaries[i + 1], [&lines](const std::string_view _line) {
+                    lines++;
+                });
+                firstRow[i + 1] = lines;
+            }
+
+            for (size_t i = 0; i < ranges; i++) {
+                firstRow[i + 1] += firstRow[i];
+            }
+        }
+
+        // Exceptions cannot leave a parallel region, so the first one is kept and rethrown.
+        std::exception_ptr error(nullptr);
+
+        #pragma omp parallel for schedule(static, 1)
+        for (size_t i = 0; i < ranges; i++) {
+            DenseRange &range(parsed[i]);
+            range.lines = 0;
+            try {
+                forEachLine(file.getData(), boundaries[i], boundaries[i + 1], [&range, &firstRow, i, rankMapping, rank](const std::string_view line) {
+                    const size_t globalRow = firstRow[i] + range.lines++;
+                    if (!isAssigned(rankMapping, rank, globalRow)) {
+                        return;
+                    }
+
+                    const size_t start = range.values.size();
+                    DenseDataRowFactory::parseLine(line, [&range](const float value) {
+                        range.values.push_back(value);
+                    });
+                    range.rowLengths.push_back(range.values.size() - start);
+                    range.globalRows.push_back(globalRow);
+                });
+            } catch (...) {
+                #pragma omp critical
+                if (error == nullptr) {
+                    error = std::current_exception();
+                }
+            }
+        }
+
+        if (error != nullptr) {
+            std::rethrow_exception(error);
+        }
+
+        DenseMatrix matrix;
+        std::vector<size_t> localRowToGlobalRow;
+        size_t totalLines = 0;
+        for (const DenseRange &range : parsed) {
+            const float* values = range.values.data();
+            for (size_t row = 0; row < range.rowLengths.size(); row++) {
+                matrix.push(values, range.rowLengths[row]);
+                matrix.finishRow();
+                values += range.rowLengths[row];
+
+                // Without a mapping rows are only numbered once every earlier range is known.
+                localRowToGlobalRow.push_back(rankMapping == nullptr ? totalLines + range.globalRows[row] : range.globalRows[row]);
+            }
+            totalLines += range.lines;
+        }
+
+        if (rankMapping != nullptr && totalLines < rankMapping->size()) {
+            spdlog::error("expected at least {0:d} rows but the input only has {1:d}", rankMapping->size(), totalLines);
+            throw std::invalid_argument("Retrieved nullptr which is unexpected during a multi-machine load. The number of rows you have provided was incorrect.");
+        }
+
+        if (normalize) {
+            #pragma omp parallel for
+            for (size_t i = 0; i < matrix.totalRows(); i++) {
+                matrix.normalizeRow(i);
+            }
+        }
+
+        matrix.shrinkToFit();
+        std::optional<std::unordered_map<size_t, size_t>> mapping(buildMapping(localRowToGlobalRow, rankMapping));
+        return std::unique_ptr<BaseData>(
+            new DenseMatrixData(std::move(matrix), std::move(localRowToGlobalRow), std::move(mapping))
+        );
+    }
+
+    static std::unique_ptr<BaseData> loadSparse(
+        const MappedFile &file,
+        const size_t adjacencyListColumnCount,
+        const bool normalize,
+        const std::vector<unsigned int> *rankMapping,
+        const unsigned int rank
+    ) {
+        const std::vector<size_t> boundaries(splitAtLines(file.getData(), file.size(), totalRanges(file.size())));
+        const size_t ranges = boundaries.size() - 1;
+        std::vector<std::vector<SparseDataRowFactory::Edge>> parsed(ranges);
+
+        #pragma omp parallel for schedule(static, 1)
+        for (size_t i = 0; i < ranges; i++) {
+            std::vector<SparseDataRowFactory::Edge> &edges(parsed[i]);
+            forEachLine(file.getData(), boundaries[i], boundaries[i + 1], [&edges](const std::string_view line) {
+                edges.push_back(SparseDataRowFactory::parseEdge(line));
+            });
+        }
+
+        // A row can span many lines and lines can leave out fields, so rows are assembled by
+        //  the factory's own state machine. Only parsing runs in parallel, assembling a row
+        //  is a copy of already parsed values.
+        SparseDataRowFactory factory(adjacencyListColumnCount);
+        size_t range = 0;
+        size_t position = 0;
+        auto nextEdge = [&parsed, &range, &position]() -> std::optional<SparseDataRowFactory::Edge> {
+            while (range < parsed.size() && position == parsed[range].size()) {
+                range++;
+                position = 0;
+            }
+
+            if (range == parsed.size()) {
+                return std::nullopt;
+            }
+
+            return parsed[range][position++];
+        };
+
+        CompressedSparseRows rows(adjacencyListColumnCount);
+        std::vector<size_t> localRowToGlobalRow;
+        if (rankMapping == nullptr) {
+            while (factory.appendFromEdges(nextEdge, rows)) {
+                localRowToGlobalRow.push_back(localRowToGlobalRow.size());
+            }
+        } else {
+            for (size_t globalRow = 0; globalRow < rankMapping->size(); globalRow++) {
+                if ((*rankMapping)[globalRow] != rank) {
+                    factory.skipFromEdges(nextEdge);
+                } else {
+                    if (!factory.appendFromEdges(nextEdge, rows)) {
+                        throw std::invalid_argument("Retrieved nullptr which is unexpected during a multi-machine load. The number of rows you have provided was incorrect.");
+                    }
+
+                    localRowToGlobalRow.push_back(globalRow);
+                }
+            }
+        }
+
+        if (normalize) {
+            #pragma omp parallel for
+            for (size_t i = 0; i < rows.totalRows(); i++) {
+                rows.normalizeRow(i);
+            }
+        }
+
+        rows.shrinkToFit();
+        std::optional<std::unordered_map<size_t, size_t>> mapping(buildMapping(localRowToGlobalRow, rankMapping));
+        return std::unique_ptr<BaseData>(
+            new CompressedSparseRowData(std::move(rows), std::move(localRowToGlobalRow), std::move(mapping))
+        );
+    }
+
+    static std::optional<std::unordered_map<size_t, size_t>> buildMapping(
+        const std::vector<size_t> &localRowToGlobalRow,
+        const std::vector<unsigned int> *rankMapping
+    ) {
+        if (rankMapping == nullptr) {
+            return std::nullopt;
+        }
+
+        std::unordered_map<size_t, size_t> globalRowToLocalRow;
+        for (size_t localRow = 0; localRow < localRowToGlobalRow.size(); localRow++) {
+            globalRowToLocalRow.insert({localRowToGlobalRow[localRow], localRow});
+        }
+
+        return globalRowToLocalRow;
+    }
+};
+
+#endif
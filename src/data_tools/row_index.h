@@ -0,0 +1,496 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <exception>
+#include <stdexcept>
+#include <unordered_map>
+#include <cstdio>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <omp.h>
+
+#include "base_data.h"
+#include "mapped_file.h"
+#include "data_row_factory.h"
+#include "parallel_text_loader.h"
+
+#ifndef ROW_INDEX_H
+#define ROW_INDEX_H
+
+/**
+ * Header of a row index sidecar, stored next to the text input as <input>.rowindex.
+ *
+ *  [header][row offsets, rows + 1 uint64][sparse only: carried columns, rows int64][sparse only: carried values, rows float]
+ *
+ * Row i starts at byte offsets[i] of the input and ends at offsets[i + 1]. Sparse rows also
+ * record the column and value left behind by the line before them, since adjacency list lines
+ * may leave those fields out. The size and modification time of the input are recorded so a
+ * stale index is never used.
+ */
+struct RowIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t kind;
+    uint64_t rows;
+    uint64_t inputBytes;
+    int64_t inputModified;
+};
+
+/**
+ * Maps every row of a dense or adjacency list text input to its byte range, so that a rank
+ * can read only the rows it owns instead of scanning the whole file.
+ */
+class RowIndex {
+    public:
+    static constexpr const char* MAGIC = "RASTRIX";
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t DENSE = 0;
+    static constexpr uint32_t SPARSE = 1;
+
+    private:
+    // Reading a gap of rows owned by other ranks is cheaper than another seek below this size.
+    static constexpr uint64_t MAX_GAP_BYTES = 1 << 16;
+    static constexpr uint64_t MAX_READ_BYTES = 1 << 24;
+
+    RowIndexHeader header;
+    std::vector<uint64_t> offsets;
+    std::vector<int64_t> carriedColumns;
+    std::vector<float> carriedValues;
+
+    struct Chunk {
+        size_t firstRow;
+        size_t lastRow;
+    };
+
+    RowIndex() {}
+
+    static uint32_t kindFor(const size_t adjacencyListColumnCount) {
+        return adjacencyListColumnCount > 0 ? SPARSE : DENSE;
+    }
+
+    static std::optional<struct stat> statInput(const std::string &path) {
+        struct stat status;
+        if (stat(path.c_str(), &status) != 0) {
+            return std::nullopt;
+        }
+
+        return status;
+    }
+
+    static int64_t modifiedTime(const struct stat &status) {
+        return static_cast<int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+    }
+
+    public:
+    static std::string sidecarPath(const std::string &path) {
+        return path + ".rowindex";
+    }
+
+    /**
+     * Scans the input once. Lines are found and parsed in parallel, only the assignment of
+     * adjacency list lines to rows is sequential.
+     */
+    static RowIndex build(const std::string &path, const size_t adjacencyListColumnCount) {
+        std::shared_ptr<MappedFile> file(MappedFile::open(path));
+        const std::optional<struct stat> status(statInput(path));
+
+        RowIndex index;
+        std::memset(&index.header, 0, sizeof(RowIndexHeader));
+        std::memcpy(index.header.magic, MAGIC, sizeof(index.header.magic));
+        index.header.version = VERSION;
+        index.header.kind = kindFor(adjacencyListColumnCount);
+        index.header.inputBytes = file->size();
+        index.header.inputModified = modifiedTime(status.value());
+
+        const size_t ranges = std::max<size_t>(1, std::min<size_t>(omp_get_max_threads(), file->size() >> 16));
+        const std::vector<size_t> boundaries(ParallelTextLoader::splitAtLines(file->getData(), file->size(), ranges));
+        std::vector<std::vector<uint64_t>> lineStarts(ranges);
+        std::vector<std::vector<SparseDataRowFactory::Edge>> edges(ranges);
+        const bool sparse = index.header.kind == SPARSE;
+
+        #pragma omp parallel for schedule(static, 1)
+        for (size_t i = 0; i < ranges; i++) {
+            ParallelTextLoader::forEachLine(file->getData(), boundaries[i], boundaries[i + 1], [&, i](const std::string_view line) {
+                lineStarts[i].push_back(line.data() - file->getData());
+                if (sparse) {
+                    edges[i].push_back(SparseDataRowFactory::parseEdge(line));
+                }
+            });
+        }
+
+        if (!sparse) {
+            for (const std::vector<uint64_t> &starts : lineStarts) {
+                index.offsets.insert(index.offsets.end(), starts.begin(), starts.end());
+            }
+        } else {
+            index.assignLinesToRows(lineStarts, edges);
+        }
+
+        index.header.rows = index.offsets.size();
+        index.offsets.push_back(file->size());
+        return index;
+    }
+
+    /**
+     * Returns the sidecar of path when there is one that matches the input as it is now.
+     */
+    static std::optional<RowIndex> maybeLoad(const std::string &path, const size_t adjacencyListColumnCount) {
+        std::ifstream input(sidecarPath(path), std::ios::binary);
+        const std::optional<struct stat> status(statInput(path));
+        if (!input.is_open() || !status.has_value()) {
+            return std::nullopt;
+        }
+
+        RowIndex index;
+        if (!input.read(reinterpret_cast<char*>(&index.header), sizeof(RowIndexHeader))
+            || std::memcmp(index.header.magic, MAGIC, sizeof(index.header.magic)) != 0
+            || index.header.version != VERSION
+            || index.header.kind != kindFor(adjacencyListColumnCount)) {
+            spdlog::warn("ignoring unrecognized row index {}", sidecarPath(path));
+            return std::nullopt;
+        }
+
+        if (index.header.inputBytes != static_cast<uint64_t>(status.value().st_size)
+            || index.header.inputModified != modifiedTime(status.value())) {
+            spdlog::warn("ignoring row index {} since the input changed after it was built", sidecarPath(path));
+            return std::nullopt;
+        }
+
+        // Checked before anything is allocated, so a corrupt row count cannot ask for more 
+        //  memory than the sidecar could ever describe.
+        const uint64_t bytesPerRow = sizeof(uint64_t) + (index.header.kind == SPARSE ? sizeof(int64_t) + sizeof(float) : 0);
+        const std::optional<struct stat> sidecar(statInput(sidecarPath(path)));
+        if (!sidecar.has_value()
+            || index.header.rows > (static_cast<uint64_t>(sidecar.value().st_size) - sizeof(RowIndexHeader)) / bytesPerRow) {
+            spdlog::warn("ignoring truncated row index {}", sidecarPath(path));
+            return std::nullopt;
+        }
+
+        index.offsets.resize(index.header.rows + 1);
+        input.read(reinterpret_cast<char*>(index.offsets.data()), index.offsets.size() * sizeof(uint64_t));
+        if (index.header.kind == SPARSE) {
+            index.carriedColumns.resize(index.header.rows);
+            index.carriedValues.resize(index.header.rows);
+            input.read(reinterpret_cast<char*>(index.carriedColumns.data()), index.carriedColumns.size() * sizeof(int64_t));
+            input.read(reinterpret_cast<char*>(index.carriedValues.data()), index.carriedValues.size() * sizeof(float));
+        }
+
+        if (!input) {
+            spdlog::warn("ignoring truncated row index {}", sidecarPath(path));
+            return std::nullopt;
+        }
+
+        // Rows are read straight from these byte ranges, so they must stay inside the input.
+        //  Skipped sparse rows are empty and repeat the offset of the next row.
+        for (size_t row = 0; row < index.header.rows; row++) {
+            if (index.offsets[row] > index.offsets[row + 1]) {
+                spdlog::warn("ignoring corrupt row index {}", sidecarPath(path));
+                return std::nullopt;
+            }
+        }
+        if (index.offsets[index.header.rows] != index.header.inputBytes) {
+            spdlog::warn("ignoring corrupt row index {}", sidecarPath(path));
+            return std::nullopt;
+        }
+
+        return index;
+    }
+
+    /**
+     * Writes the sidecar of path. The index is written to a temporary file first and renamed
+     * into place, so concurrent readers never see a partial index.
+     */
+    void write(const std::string &path) const {
+        const std::string target(sidecarPath(path));
+        const std::string temporary(target + "." + std::to_string(getpid()));
+        std::ofstream output(temporary, std::ios::binary);
+        output.write(reinterpret_cast<const char*>(&this->header), sizeof(RowIndexHeader));
+        output.write(reinterpret_cast<const char*>(this->offsets.data()), this->offsets.size() * sizeof(uint64_t));
+        output.write(reinterpret_cast<const char*>(this->carriedColumns.data()), this->carriedColumns.size() * sizeof(int64_t));
+        output.write(reinterpret_cast<const char*>(this->carriedValues.data()), this->carriedValues.size() * sizeof(float));
+        output.close();
+
+        if (!output || std::rename(temporary.c_str(), target.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            spdlog::warn("could not write row index {}, rows will be found by scanning the input", target);
+        }
+    }
+
+    size_t totalRows() const {
+        return this->header.rows;
+    }
+
+    uint64_t getOffset(const size_t row) const {
+        return this->offsets[row];
+    }
+
+    /**
+     * Loads only the rows assigned to this rank. Runs of assigned rows that are close together
+     * are read with a single pread, and reads are parsed in parallel.
+     */
+    std::unique_ptr<BaseData> load(
+        const std::string &path,
+        const size_t adjacencyListColumnCount,
+        const bool normalize,
+        const std::vector<unsigned int> &rankMapping,
+        const unsigned int rank
+    ) const {
+        if (rankMapping.size() > this->header.rows) {
+            spdlog::error("expected at least {0:d} rows but the row index only has {1:d}", rankMapping.size(), this->header.rows);
+            throw std::invalid_argument("The number of rows you have provided was incorrect.");
+        }
+
+        const std::vector<Chunk> chunks(this->planReads(rankMapping, rank));
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            spdlog::error("could not open {}", path);
+            throw std::invalid_argument("ERROR: could not open input file");
+        }
+
+        std::vector<DenseMatrix> denseParts(this->header.kind == DENSE ? chunks.size() : 0);
+        std::vector<CompressedSparseRows> sparseParts(
+            this->header.kind == SPARSE ? chunks.size() : 0,
+            CompressedSparseRows(adjacencyListColumnCount)
+        );
+        std::exception_ptr error(nullptr);
+
+        #pragma omp parallel
+        {
+            std::vector<char> buffer;
+
+            #pragma omp for schedule(dynamic)
+            for (size_t i = 0; i < chunks.size(); i++) {
+                try {
+                    const uint64_t start = this->offsets[chunks[i].firstRow];
+                    buffer.resize(this->offsets[chunks[i].lastRow + 1] - start);
+                    readFully(fd, buffer.data(), buffer.size(), start);
+
+                    if (this->header.kind == DENSE) {
+                        this->parseDenseChunk(chunks[i], buffer.data(), start, rankMapping, rank, denseParts[i]);
+                    } else {
+                        this->parseSparseChunk(chunks[i], buffer.data(), start, rankMapping, rank, adjacencyListColumnCount, sparseParts[i]);
+                    }
+                } catch (...) {
+                    #pragma omp critical
+                    if (error == nullptr) {
+                        error = std::current_exception();
+                    }
+                }
+            }
+        }
+        ::close(fd);
+
+        if (error != nullptr) {
+            std::rethrow_exception(error);
+        }
+
+        std::vector<size_t> localRowToGlobalRow;
+        std::unordered_map<size_t, size_t> globalRowToLocalRow;
+        for (size_t globalRow = 0; globalRow < rankMapping.size(); globalRow++) {
+            if (rankMapping[globalRow] == rank) {
+                globalRowToLocalRow.insert({globalRow, localRowToGlobalRow.size()});
+                localRowToGlobalRow.push_back(globalRow);
+            }
+        }
+
+        if (this->header.kind == DENSE) {
+            DenseMatrix matrix;
+            for (const DenseMatrix &part : denseParts) {
+                for (size_t row = 0; row < part.totalRows(); row++) {
+                    matrix.push(part.getRowData(row), part.getTotalColumns());
+                    matrix.finishRow();
+                }
+            }
+
+            if (normalize) {
+                #pragma omp parallel for
+                for (size_t i = 0; i < matrix.totalRows(); i++) {
+                    matrix.normalizeRow(i);
+                }
+            }
+
+            matrix.shrinkToFit();
+            return std::unique_ptr<BaseData>(
+                new DenseMatrixData(std::move(matrix), std::move(localRowToGlobalRow), std::move(globalRowToLocalRow))
+            );
+        }
+
+        CompressedSparseRows rows(adjacencyListColumnCount);
+        for (const CompressedSparseRows &part : sparseParts) {
+            for (size_t row = 0; row < part.totalRows(); row++) {
+                rows.append(part.getRow(row));
+            }
+        }
+
+        if (normalize) {
+            #pragma omp parallel for
+            for (size_t i = 0; i < rows.totalRows(); i++) {
+                rows.normalizeRow(i);
+            }
+        }
+
+        rows.shrinkToFit();
+        return std::unique_ptr<BaseData>(
+            new CompressedSparseRowData(std::move(rows), std::move(localRowToGlobalRow), std::move(globalRowToLocalRow))
+        );
+    }
+
+    private:
+    /**
+     * Mirrors SparseDataRowFactory: a line belongs to the row named on it, lines without a
+     * row belong to the row of the line before them, and skipped row ids are empty rows.
+     */
+    void assignLinesToRows(
+        const std::vector<std::vector<uint64_t>> &lineStarts,
+        const std::vector<std::vector<SparseDataRowFactory::Edge>> &edges
+    ) {
+        long currentRow = 0;
+        long to = 0;
+        float value = 1.0;
+        long lastRow = -1;
+
+        for (size_t range = 0; range < edges.size(); range++) {
+            for (size_t line = 0; line < edges[range].size(); line++) {
+                const SparseDataRowFactory::Edge &edge(edges[range][line]);
+                const long carriedTo = to;
+                const float carriedValue = value;
+
+                if (edge.elements > 0) {
+                    currentRow = edge.row;
+                }
+                if (edge.elements > 1) {
+                    to = edge.to;
+                }
+                if (edge.elements > 2) {
+                    value = edge.value;
+                }
+
+                if (currentRow < lastRow || currentRow < 0) {
+                    spdlog::error("had current row of {0:d} and expected row of {1:d}", currentRow, std::max(lastRow, 0L));
+                    throw std::invalid_argument("ERROR: cannot backtrack");
+                }
+
+                while (lastRow < currentRow) {
+                    lastRow++;
+                    this->offsets.push_back(lineStarts[range][line]);
+                    this->carriedColumns.push_back(carriedTo);
+                    this->carriedValues.push_back(carriedValue);
+                }
+            }
+        }
+    }
+
+    std::vector<Chunk> planReads(const std::vector<unsigned int> &rankMapping, const unsigned int rank) const {
+        std::vector<Chunk> chunks;
+        for (size_t row = 0; row < rankMapping.size(); row++) {
+            if (rankMapping[row] != rank) {
+                continue;
+            }
+
+            if (chunks.size() > 0) {
+                Chunk &last(chunks.back());
+                const uint64_t gap = this->offsets[row] - this->offsets[last.lastRow + 1];
+                const uint64_t bytes = this->offsets[row + 1] - this->offsets[last.firstRow];
+                if (gap <= MAX_GAP_BYTES && bytes <= MAX_READ_BYTES) {
+                    last.lastRow = row;
+                    continue;
+                }
+            }
+
+            chunks.push_back(Chunk{row, row});
+        }
+
+        return chunks;
+    }
+
+    static void readFully(const int fd, char* buffer, const size_t bytes, const uint64_t offset) {
+        size_t done = 0;
+        while (done < bytes) {
+            const ssize_t read = pread(fd, buffer + done, bytes - done, offset + done);
+            if (read <= 0) {
+                throw std::invalid_argument("ERROR: could not read input file, it may have changed since its row index was built");
+            }
+            done += read;
+        }
+    }
+
+    /**
+     * The text of row without its newline. chunk holds the input starting at byte start.
+     */
+    std::string_view rowText(const char* chunk, const uint64_t start, const size_t row) const {
+        return std::string_view(chunk + this->offsets[row] - start, this->offsets[row + 1] - this->offsets[row]);
+    }
+
+    void parseDenseChunk(
+        const Chunk &chunk,
+        const char* data,
+        const uint64_t start,
+        const std::vector<unsigned int> &rankMapping,
+        const unsigned int rank,
+        DenseMatrix &part
+    ) const {
+        for (size_t row = chunk.firstRow; row <= chunk.lastRow; row++) {
+            if (rankMapping[row] != rank) {
+                continue;
+            }
+
+            std::string_view text(this->rowText(data, start, row));
+            if (text.size() > 0 && text.back() == '\n') {
+                text.remove_suffix(1);
+            }
+
+            DenseDataRowFactory::parseLine(text, [&part](const float value) {
+                part.push(value);
+            });
+            part.finishRow();
+        }
+    }
+
+    void parseSparseChunk(
+        const Chunk &chunk,
+        const char* data,
+        const uint64_t start,
+        const std::vector<unsigned int> &rankMapping,
+        const unsigned int rank,
+        const size_t adjacencyListColumnCount,
+        CompressedSparseRows &part
+    ) const {
+        for (size_t row = chunk.firstRow; row <= chunk.lastRow; row++) {
+            if (rankMapping[row] != rank) {
+                continue;
+            }
+
+            SparseDataRowFactory factory(adjacencyListColumnCount);
+            factory.resumeAt(row, this->carriedColumns[row], this->carriedValues[row]);
+
+            const std::string_view text(this->rowText(data, start, row));
+            size_t position = 0;
+            auto nextEdge = [&text, &position]() -> std::optional<SparseDataRowFactory::Edge> {
+                if (position >= text.size()) {
+                    return std::nullopt;
+                }
+
+                size_t end = text.find('\n', position);
+                if (end == std::string_view::npos) {
+                    end = text.size();
+                }
+
+                const std::string_view line(text.substr(position, end - position));
+                position = end + 1;
+                return SparseDataRowFactory::parseEdge(line);
+            };
+
+            // Rows skipped by the input have no lines of their own and are empty.
+            if (!factory.appendFromEdges(nextEdge, part)) {
+                part.finishRow();
+            }
+        }
+    }
+};
+
+#endif
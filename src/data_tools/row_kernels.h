@@ -0,0 +1,155 @@
+#include <algorithm>
+
+#include "data_row.h"
+#include "simd_kernels.h"
+
+#ifndef ROW_KERNELS_H
+#define ROW_KERNELS_H
+
+/**
+ * Raw storage of one row. Neither owns its arrays, the row they came from must outlive them.
+ */
+struct DenseRowRef {
+    const float* values;
+    size_t columns;
+};
+
+struct SparseRowRef {
+    const unsigned int* columns;
+    const float* values;
+    size_t nonZeros;
+};
+
+/**
+ * Dot products between the raw storage of two rows, one overload per pair of representations
+ * so that callers resolve the pair at compile time. Each adds its products in the same order
+ * as the matching dot product visitor, so results are identical to DataRow::dotProduct.
+ */
+class RowKernels {
+    public:
+    static inline float dot(const DenseRowRef &a, const DenseRowRef &b) {
+        return SimdKernels::dot(a.values, b.values, std::min(a.columns, b.columns));
+    }
+
+    static inline float dot(const DenseRowRef &a, const SparseRowRef &b) {
+        return SimdKernels::gatherDot(a.values, b.columns, b.values, b.nonZeros);
+    }
+
+    static inline float dot(const SparseRowRef &a, const DenseRowRef &b) {
+        return SimdKernels::gatherDot(b.values, a.columns, a.values, a.nonZeros);
+    }
+
+    static inline float dot(const SparseRowRef &a, const SparseRowRef &b) {
+        float result = 0;
+        size_t aIndex = 0;
+        size_t bIndex = 0;
+        while (aIndex < a.nonZeros && bIndex < b.nonZeros) {
+            if (a.columns[aIndex] == b.columns[bIndex]) {
+                result += a.values[aIndex] * b.values[bIndex];
+                aIndex++;
+                bIndex++;
+            } else if (a.columns[aIndex] > b.columns[bIndex]) {
+                bIndex++;
+            } else {
+                aIndex++;
+            }
+        }
+
+        return result;
+    }
+};
+
+/**
+ * The representation of one row, resolved with a single visit. Comparing two resolved rows
+ * is a switch over their layouts straight into RowKernels, where DataRow::dotProduct costs
+ * two virtual calls and a visitor for every pair. Rows stored as maps have no raw storage
+ * and still go through the visitors.
+ */
+class RowRef {
+    public:
+    enum class Layout { DENSE, SPARSE, OTHER };
+
+    private:
+    Layout layout;
+    DenseRowRef dense;
+    SparseRowRef sparse;
+    const DataRow* row;
+
+    class Resolver : public DataRowVisitor {
+        public:
+        RowRef &result;
+
+        Resolver(RowRef &result) : result(result) {}
+
+        void visitDenseDataRow(const std::vector<float>& data) {
+            this->visitDenseDataRowView(data.data(), data.size());
+        }
+
+        void visitDenseDataRowView(const float* data, const size_t totalColumns) {
+            this->result.layout = Layout::DENSE;
+            this->result.dense = DenseRowRef{data, totalColumns};
+        }
+
+        void visitSparseDataRow(const std::map<size_t, float>& _data, size_t _totalColumns) {
+            this->result.layout = Layout::OTHER;
+        }
+
+        void visitSparseDataRowView(const unsigned int* columns, const float* values, const size_t nonZeros, const size_t _totalColumns) {
+            this->result.layout = Layout::SPARSE;
+            this->result.sparse = SparseRowRef{columns, values, nonZeros};
+        }
+    };
+
+    RowRef(const DataRow &row) :
+        layout(Layout::OTHER),
+        dense{nullptr, 0},
+        sparse{nullptr, nullptr, 0},
+        row(&row)
+    {}
+
+    public:
+    static RowRef of(const DataRow &row) {
+        RowRef result(row);
+        Resolver resolver(result);
+        row.voidVisit(resolver);
+        return result;
+    }
+
+    Layout getLayout() const {
+        return this->layout;
+    }
+
+    const DataRow &getRow() const {
+        return *this->row;
+    }
+
+    /**
+     * Calls kernel with the raw storage of both rows. Kernel is instantiated once for each pair
+     *  of layouts, and fallback gets both DataRows when either one has no raw storage.
+     */
+    template <typename Kernel, typename Fallback>
+    static auto dispatch(const RowRef &a, const RowRef &b, Kernel kernel, Fallback fallback) {
+        if (a.layout == Layout::DENSE && b.layout == Layout::DENSE) {
+            return kernel(a.dense, b.dense);
+        } else if (a.layout == Layout::DENSE && b.layout == Layout::SPARSE) {
+            return kernel(a.dense, b.sparse);
+        } else if (a.layout == Layout::SPARSE && b.layout == Layout::DENSE) {
+            return kernel(a.sparse, b.dense);
+        } else if (a.layout == Layout::SPARSE && b.layout == Layout::SPARSE) {
+            return kernel(a.sparse, b.sparse);
+        }
+
+        return fallback(*a.row, *b.row);
+    }
+
+    static float dot(const RowRef &a, const RowRef &b) {
+        return dispatch(
+            a,
+            b,
+            [](const auto &x, const auto &y) { return RowKernels::dot(x, y); },
+            [](const DataRow &x, const DataRow &y) { return x.dotProduct(y); }
+        );
+    }
+};
+
+#endif
@@ -0,0 +1,246 @@
+#include <cstddef>
+#include <string>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_KERNELS_X86
+#endif
+
+enum class SimdLevel {
+    SCALAR,
+    AVX2,
+    AVX512
+};
+
+/**
+ * Dot product kernels with AVX2 and AVX-512 paths and a scalar fallback. Each path is compiled
+ * for its own instruction set through target attributes, so no extra compiler flags are
+ * needed, and the widest level this CPU supports is picked once, the first time the kernels
+ * are used. Vector paths sum in a different order than the scalar loop, so results can differ
+ * from it in the last bits.
+ *
+ * gatherDot reads dense[columns[i]] for every i and requires columns below 2^31.
+ */
+class SimdKernels {
+    public:
+    typedef float (*Dot)(const float* a, const float* b, size_t size);
+    typedef float (*GatherDot)(const float* dense, const unsigned int* columns, const float* values, size_t nonZeros);
+
+    struct Table {
+        SimdLevel level;
+        Dot dot;
+        GatherDot gatherDot;
+    };
+
+    static const Table& active() {
+        static const Table table(forLevel(best()));
+        return table;
+    }
+
+    static float dot(const float* a, const float* b, const size_t size) {
+        return active().dot(a, b, size);
+    }
+
+    static float gatherDot(const float* dense, const unsigned int* columns, const float* values, const size_t nonZeros) {
+        return active().gatherDot(dense, columns, values, nonZeros);
+    }
+
+    static bool supports(const SimdLevel level) {
+        switch (level) {
+            case SimdLevel::SCALAR:
+                return true;
+#ifdef SIMD_KERNELS_X86
+            case SimdLevel::AVX2:
+                return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+            case SimdLevel::AVX512:
+                return __builtin_cpu_supports("avx512f");
+#endif
+            default:
+                return false;
+        }
+    }
+
+    static SimdLevel best() {
+        if (supports(SimdLevel::AVX512)) {
+            return SimdLevel::AVX512;
+        }
+        if (supports(SimdLevel::AVX2)) {
+            return SimdLevel::AVX2;
+        }
+
+        return SimdLevel::SCALAR;
+    }
+
+    static Table forLevel(const SimdLevel level) {
+        if (!supports(level)) {
+            throw std::invalid_argument("ERROR: this CPU does not support SIMD level " + toString(level));
+        }
+
+        switch (level) {
+#ifdef SIMD_KERNELS_X86
+            case SimdLevel::AVX2:
+                return Table{level, dotAvx2, gatherDotAvx2};
+            case SimdLevel::AVX512:
+                return Table{level, dotAvx512, gatherDotAvx512};
+#endif
+            default:
+                return Table{SimdLevel::SCALAR, dotScalar, gatherDotScalar};
+        }
+    }
+
+    static std::string toString(const SimdLevel level) {
+        switch (level) {
+            case SimdLevel::SCALAR:
+                return "scalar";
+            case SimdLevel::AVX2:
+                return "avx2";
+            case SimdLevel::AVX512:
+                return "avx512";
+        }
+
+        return "unknown";
+    }
+
+    static float dotScalar(const float* a, const float* b, const size_t size) {
+        float result = 0;
+        for (size_t i = 0; i < size; i++) {
+            result += a[i] * b[i];
+        }
+
+        return result;
+    }
+
+    static float gatherDotScalar(const float* dense, const unsigned int* columns, const float* values, const size_t nonZeros) {
+        float result = 0;
+        for (size_t i = 0; i < nonZeros; i++) {
+            result += dense[columns[i]] * values[i];
+        }
+
+        return result;
+    }
+
+#ifdef SIMD_KERNELS_X86
+    private:
+    __attribute__((target("avx2,fma")))
+    static float sumAvx2(const __m256 sums) {
+        __m128 low = _mm_add_ps(_mm256_castps256_ps128(sums), _mm256_extractf128_ps(sums, 1));
+        __m128 shuffled = _mm_movehdup_ps(low);
+        low = _mm_add_ps(low, shuffled);
+        shuffled = _mm_movehl_ps(shuffled, low);
+        return _mm_cvtss_f32(_mm_add_ss(low, shuffled));
+    }
+
+    // Lanes below remaining are set.
+    __attribute__((target("avx2,fma")))
+    static __m256i tailMaskAvx2(const size_t remaining) {
+        return _mm256_cmpgt_epi32(_mm256_set1_epi32(remaining), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    }
+
+    __attribute__((target("avx2,fma")))
+    static float dotAvx2(const float* a, const float* b, const size_t size) {
+        __m256 sums0 = _mm256_setzero_ps();
+        __m256 sums1 = _mm256_setzero_ps();
+        __m256 sums2 = _mm256_setzero_ps();
+        __m256 sums3 = _mm256_setzero_ps();
+
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            sums0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sums0);
+            sums1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), sums1);
+            sums2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), sums2);
+            sums3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), sums3);
+        }
+        for (; i + 8 <= size; i += 8) {
+            sums0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sums0);
+        }
+        if (i < size) {
+            const __m256i mask(tailMaskAvx2(size - i));
+            sums1 = _mm256_fmadd_ps(_mm256_maskload_ps(a + i, mask), _mm256_maskload_ps(b + i, mask), sums1);
+        }
+
+        return sumAvx2(_mm256_add_ps(_mm256_add_ps(sums0, sums1), _mm256_add_ps(sums2, sums3)));
+    }
+
+    __attribute__((target("avx2,fma")))
+    static float gatherDotAvx2(const float* dense, const unsigned int* columns, const float* values, const size_t nonZeros) {
+        __m256 sums0 = _mm256_setzero_ps();
+        __m256 sums1 = _mm256_setzero_ps();
+
+        size_t i = 0;
+        for (; i + 16 <= nonZeros; i += 16) {
+            const __m256i indexes0(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(columns + i)));
+            const __m256i indexes1(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(columns + i + 8)));
+            sums0 = _mm256_fmadd_ps(_mm256_i32gather_ps(dense, indexes0, 4), _mm256_loadu_ps(values + i), sums0);
+            sums1 = _mm256_fmadd_ps(_mm256_i32gather_ps(dense, indexes1, 4), _mm256_loadu_ps(values + i + 8), sums1);
+        }
+        for (; i + 8 <= nonZeros; i += 8) {
+            const __m256i indexes(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(columns + i)));
+            sums0 = _mm256_fmadd_ps(_mm256_i32gather_ps(dense, indexes, 4), _mm256_loadu_ps(values + i), sums0);
+        }
+        if (i < nonZeros) {
+            const __m256i mask(tailMaskAvx2(nonZeros - i));
+            const __m256i indexes(_mm256_maskload_epi32(reinterpret_cast<const int*>(columns + i), mask));
+            const __m256 gathered(_mm256_mask_i32gather_ps(_mm256_setzero_ps(), dense, indexes, _mm256_castsi256_ps(mask), 4));
+            sums1 = _mm256_fmadd_ps(gathered, _mm256_maskload_ps(values + i, mask), sums1);
+        }
+
+        return sumAvx2(_mm256_add_ps(sums0, sums1));
+    }
+
+    __attribute__((target("avx512f")))
+    static float dotAvx512(const float* a, const float* b, const size_t size) {
+        __m512 sums0 = _mm512_setzero_ps();
+        __m512 sums1 = _mm512_setzero_ps();
+
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            sums0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), sums0);
+            sums1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), sums1);
+        }
+        for (; i + 16 <= size; i += 16) {
+            sums0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), sums0);
+        }
+        if (i < size) {
+            const __mmask16 mask((1u << (size - i)) - 1);
+            sums1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), sums1);
+        }
+
+        return _mm512_reduce_add_ps(_mm512_add_ps(sums0, sums1));
+    }
+
+    __attribute__((target("avx512f")))
+    static float gatherDotAvx512(const float* dense, const unsigned int* columns, const float* values, const size_t nonZeros) {
+        __m512 sums0 = _mm512_setzero_ps();
+        __m512 sums1 = _mm512_setzero_ps();
+
+        size_t i = 0;
+        for (; i + 32 <= nonZeros; i += 32) {
+            const __m512i indexes0(_mm512_loadu_si512(columns + i));
+            const __m512i indexes1(_mm512_loadu_si512(columns + i + 16));
+            sums0 = _mm512_fmadd_ps(_mm512_i32gather_ps(indexes0, dense, 4), _mm512_loadu_ps(values + i), sums0);
+            sums1 = _mm512_fmadd_ps(_mm512_i32gather_ps(indexes1, dense, 4), _mm512_loadu_ps(values + i + 16), sums1);
+        }
+        for (; i + 16 <= nonZeros; i += 16) {
+            const __m512i indexes(_mm512_loadu_si512(columns + i));
+            sums0 = _mm512_fmadd_ps(_mm512_i32gather_ps(indexes, dense, 4), _mm512_loadu_ps(values + i), sums0);
+        }
+        if (i < nonZeros) {
+            const __mmask16 mask((1u << (nonZeros - i)) - 1);
+            const __m512i indexes(_mm512_maskz_loadu_epi32(mask, columns + i));
+            const __m512 gathered(_mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, indexes, dense, 4));
+            sums1 = _mm512_fmadd_ps(gathered, _mm512_maskz_loadu_ps(mask, values + i), sums1);
+        }
+
+        return _mm512_reduce_add_ps(_mm512_add_ps(sums0, sums1));
+    }
+#endif
+};
+
+#endif
@@ -1,5 +1,9 @@
 #include <utility>
+#include <random>
+#include <iomanip>
 #include <functional>
+#include <fstream>
+#include <filesystem>
 #include <doctest/doctest.h>
 
 class DataRowVerifier : public DataRowVisitor {
@@ -238,4 +242,937 @@ TEST_CASE("Testing dot products") {
             CHECK(sparseToSparse > 0);
         }
     }
-}
\ No newline at end of file
+}
+TEST_CASE("Testing CSR sparse data") {
+    std::string dataAsString = matrixToString(SPARSE_DATA);
+    std::istringstream inputStream(dataAsString);
+    FromFileLineFactory getter(inputStream);
+    SparseDataRowFactory factory(SPARSE_DATA_TOTAL_COLUMNS);
+    std::unique_ptr<BaseData> data(CompressedSparseRowData::load(factory, getter, SPARSE_DATA_TOTAL_COLUMNS));
+
+    CHECK(data->totalRows() == SPARSE_DATA_AS_MAP.size());
+    CHECK(data->totalColumns() == SPARSE_DATA_TOTAL_COLUMNS);
+    verifyData(*data.get());
+    for (size_t i = 0; i < data->totalRows(); i++) {
+        CHECK(data->getRemoteIndexForRow(i) == i);
+        CHECK(data->getLocalIndexFromGlobalIndex(i) == i);
+    }
+
+    Diagnostics diagnostics = data->DEBUG_getDiagnostics();
+    CHECK(diagnostics.numberOfNonEmptyCells == SPARSE_DATA.size());
+    CHECK(diagnostics.storageBytes > 0);
+}
+
+TEST_CASE("Testing segmented CSR sparse data") {
+    std::string dataAsString = matrixToString(SPARSE_DATA);
+    std::istringstream inputStream(dataAsString);
+    FromFileLineFactory getter(inputStream);
+    SparseDataRowFactory factory(SPARSE_DATA_TOTAL_COLUMNS);
+    
+    std::vector<unsigned int> rankMapping({0, 1, 2, 3, 2, 1});
+    const int rank = 2;
+
+    std::unique_ptr<BaseData> data(CompressedSparseRowData::load(factory, getter, SPARSE_DATA_TOTAL_COLUMNS, rankMapping, rank));
+    CHECK(data->totalRows() == 2);
+    verifyData(*data.get(), rankMapping, rank);
+    CHECK(data->getLocalIndexFromGlobalIndex(4) == 1);
+}
+
+TEST_CASE("Testing CSR rows match map rows") {
+    std::string dataAsString = matrixToString(SPARSE_DATA);
+    std::istringstream csrStream(dataAsString);
+    std::istringstream mapStream(dataAsString);
+    FromFileLineFactory csrGetter(csrStream);
+    FromFileLineFactory mapGetter(mapStream);
+    NormalizedDataRowFactory csrFactory(std::unique_ptr<DataRowFactory>(new SparseDataRowFactory(SPARSE_DATA_TOTAL_COLUMNS)));
+    NormalizedDataRowFactory mapFactory(std::unique_ptr<DataRowFactory>(new SparseDataRowFactory(SPARSE_DATA_TOTAL_COLUMNS)));
+
+    std::unique_ptr<BaseData> csrData(CompressedSparseRowData::load(csrFactory, csrGetter, SPARSE_DATA_TOTAL_COLUMNS));
+    std::unique_ptr<FullyLoadedData> mapData(FullyLoadedData::load(mapFactory, mapGetter));
+    std::unique_ptr<FullyLoadedData> denseData(FullyLoadedData::load(DENSE_DATA));
+    REQUIRE(csrData->totalRows() == mapData->totalRows());
+
+    for (size_t i = 0; i < csrData->totalRows(); i++) {
+        ToBinaryVisitor csrBinary, mapBinary;
+        CHECK(csrData->getRow(i).visit(csrBinary) == mapData->getRow(i).visit(mapBinary));
+
+        for (size_t j = 0; j < csrData->totalRows(); j++) {
+            const float expected = mapData->getRow(i).dotProduct(mapData->getRow(j));
+            CHECK(csrData->getRow(i).dotProduct(csrData->getRow(j)) == expected);
+            CHECK(csrData->getRow(i).dotProduct(mapData->getRow(j)) == expected);
+            CHECK(mapData->getRow(i).dotProduct(csrData->getRow(j)) == expected);
+        }
+
+        // Map rows cannot be gathered with SIMD kernels, so sums against dense rows may be 
+        //  added in a different order.
+        for (size_t d = 0; d < denseData->totalRows(); d++) {
+            const float expected = mapData->getRow(i).dotProduct(denseData->getRow(d));
+            CHECK(std::abs(csrData->getRow(i).dotProduct(denseData->getRow(d)) - expected) < 1e-5);
+            CHECK(std::abs(denseData->getRow(d).dotProduct(csrData->getRow(i)) - denseData->getRow(d).dotProduct(mapData->getRow(i))) < 1e-5);
+        }
+    }
+}
+
+TEST_CASE("Testing dense matrix data") {
+    std::string dataAsString = matrixToString(DENSE_DATA);
+    std::istringstream inputStream(dataAsString);
+    FromFileLineFactory getter(inputStream);
+    DenseDataRowFactory factory;
+    std::unique_ptr<BaseData> data(DenseMatrixData::load(factory, getter));
+
+    CHECK(data->totalRows() == DENSE_DATA.size());
+    CHECK(data->totalColumns() == DENSE_DATA[0].size());
+    verifyData(*data.get());
+
+    const DenseMatrix &matrix(dynamic_cast<const DenseMatrixData&>(*data).getMatrix());
+    CHECK(matrix.getStride() % DenseMatrix::FLOATS_PER_ALIGNMENT == 0);
+    for (size_t i = 0; i < matrix.totalRows(); i++) {
+        CHECK(reinterpret_cast<uintptr_t>(matrix.getRowData(i)) % DenseMatrix::ALIGNMENT_BYTES == 0);
+        for (size_t c = matrix.getTotalColumns(); c < matrix.getStride(); c++) {
+            CHECK(matrix.getRowData(i)[c] == 0);
+        }
+    }
+
+    Diagnostics diagnostics = data->DEBUG_getDiagnostics();
+    CHECK(diagnostics.numberOfNonEmptyCells == DENSE_DATA.size() * DENSE_DATA[0].size());
+}
+
+TEST_CASE("Testing segmented dense matrix data") {
+    std::string dataAsString = matrixToString(DENSE_DATA);
+    std::istringstream inputStream(dataAsString);
+    FromFileLineFactory getter(inputStream);
+    DenseDataRowFactory factory;
+
+    std::vector<unsigned int> rankMapping({0, 1, 2, 3, 2, 1});
+    const int rank = 1;
+
+    std::unique_ptr<BaseData> data(DenseMatrixData::load(factory, getter, rankMapping, rank));
+    CHECK(data->totalRows() == 2);
+    verifyData(*data.get(), rankMapping, rank);
+    CHECK(data->getLocalIndexFromGlobalIndex(5) == 1);
+}
+
+TEST_CASE("Testing dense matrix rows match dense rows") {
+    std::string dataAsString = matrixToString(DENSE_DATA);
+    std::istringstream matrixStream(dataAsString);
+    std::istringstream rowStream(dataAsString);
+    std::istringstream sparseStream(matrixToString(SPARSE_DATA));
+    FromFileLineFactory matrixGetter(matrixStream);
+    FromFileLineFactory rowGetter(rowStream);
+    FromFileLineFactory sparseGetter(sparseStream);
+    NormalizedDataRowFactory matrixFactory(std::unique_ptr<DataRowFactory>(new DenseDataRowFactory()));
+    NormalizedDataRowFactory rowFactory(std::unique_ptr<DataRowFactory>(new DenseDataRowFactory()));
+    SparseDataRowFactory sparseFactory(SPARSE_DATA_TOTAL_COLUMNS);
+
+    std::unique_ptr<BaseData> matrixData(DenseMatrixData::load(matrixFactory, matrixGetter));
+    std::unique_ptr<FullyLoadedData> rowData(FullyLoadedData::load(rowFactory, rowGetter));
+    std::unique_ptr<BaseData> sparseData(CompressedSparseRowData::load(sparseFactory, sparseGetter, SPARSE_DATA_TOTAL_COLUMNS));
+    REQUIRE(matrixData->totalRows() == rowData->totalRows());
+
+    for (size_t i = 0; i < matrixData->totalRows(); i++) {
+        ToBinaryVisitor matrixBinary, rowBinary;
+        CHECK(matrixData->getRow(i).visit(matrixBinary) == rowData->getRow(i).visit(rowBinary));
+
+        for (size_t j = 0; j < matrixData->totalRows(); j++) {
+            const float expected = rowData->getRow(i).dotProduct(rowData->getRow(j));
+            CHECK(matrixData->getRow(i).dotProduct(matrixData->getRow(j)) == expected);
+            CHECK(matrixData->getRow(i).dotProduct(rowData->getRow(j)) == expected);
+            CHECK(rowData->getRow(i).dotProduct(matrixData->getRow(j)) == expected);
+        }
+
+        for (size_t s = 0; s < sparseData->totalRows(); s++) {
+            const float expected = rowData->getRow(i).dotProduct(sparseData->getRow(s));
+            CHECK(matrixData->getRow(i).dotProduct(sparseData->getRow(s)) == expected);
+            CHECK(sparseData->getRow(s).dotProduct(matrixData->getRow(i)) == sparseData->getRow(s).dotProduct(rowData->getRow(i)));
+        }
+    }
+}
+
+static std::string binaryDatasetPath(const std::string &name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+template <typename Storage>
+static std::string writeBinaryDataset(const std::string &name, const Storage &storage, const bool normalized) {
+    const std::string path(binaryDatasetPath(name));
+    std::ofstream output(path, std::ios::binary);
+    BinaryDataset::write(output, storage, normalized);
+    output.close();
+    return path;
+}
+
+static DenseMatrix denseDataAsMatrix() {
+    DenseMatrix matrix;
+    for (const auto & row : DENSE_DATA) {
+        matrix.append(DenseDataRowView(row.data(), row.size()));
+    }
+
+    return matrix;
+}
+
+static CompressedSparseRows sparseDataAsRows() {
+    CompressedSparseRows rows(SPARSE_DATA_TOTAL_COLUMNS);
+    for (const auto & row : SPARSE_DATA_AS_MAP) {
+        rows.append(SparseDataRow(row, SPARSE_DATA_TOTAL_COLUMNS));
+    }
+
+    return rows;
+}
+
+TEST_CASE("Testing dense binary dataset") {
+    const std::string path(writeBinaryDataset("rastre_dense_test.bin", denseDataAsMatrix(), false));
+
+    std::unique_ptr<BaseData> data(BinaryDataset::load(path, false));
+    CHECK(data->totalRows() == DENSE_DATA.size());
+    CHECK(data->totalColumns() == DENSE_DATA[0].size());
+    verifyData(*data.get());
+
+    std::vector<unsigned int> rankMapping({0, 1, 2, 3, 2, 1});
+    const int rank = 2;
+    std::unique_ptr<BaseData> segmented(BinaryDataset::load(path, false, rankMapping, rank));
+    CHECK(segmented->totalRows() == 2);
+    verifyData(*segmented.get(), rankMapping, rank);
+    CHECK(segmented->getLocalIndexFromGlobalIndex(4) == 1);
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Testing sparse binary dataset") {
+    const std::string path(writeBinaryDataset("rastre_sparse_test.bin", sparseDataAsRows(), false));
+
+    std::unique_ptr<BaseData> data(BinaryDataset::load(path, false));
+    CHECK(data->totalRows() == SPARSE_DATA_AS_MAP.size());
+    CHECK(data->totalColumns() == SPARSE_DATA_TOTAL_COLUMNS);
+    verifyData(*data.get());
+
+    std::vector<unsigned int> rankMapping({0, 1, 2, 3, 2, 1});
+    const int rank = 1;
+    std::unique_ptr<BaseData> segmented(BinaryDataset::load(path, false, rankMapping, rank));
+    CHECK(segmented->totalRows() == 2);
+    verifyData(*segmented.get(), rankMapping, rank);
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Testing binary datasets normalize like text datasets") {
+    const std::string densePath(writeBinaryDataset("rastre_dense_normalize_test.bin", denseDataAsMatrix(), false));
+    const std::string sparsePath(writeBinaryDataset("rastre_sparse_normalize_test.bin", sparseDataAsRows(), false));
+
+    std::istringstream denseStream(matrixToString(DENSE_DATA));
+    std::istringstream sparseStream(matrixToString(SPARSE_DATA));
+    FromFileLineFactory denseGetter(denseStream);
+    FromFileLineFactory sparseGetter(sparseStream);
+    NormalizedDataRowFactory denseFactory(std::unique_ptr<DataRowFactory>(new DenseDataRowFactory()));
+    NormalizedDataRowFactory sparseFactory(std::unique_ptr<DataRowFactory>(new SparseDataRowFactory(SPARSE_DATA_TOTAL_COLUMNS)));
+
+    std::vector<std::pair<std::unique_ptr<BaseData>, std::unique_ptr<BaseData>>> pairs;
+    pairs.push_back({BinaryDataset::load(densePath, true), FullyLoadedData::load(denseFactory, denseGetter)});
+    pairs.push_back({BinaryDataset::load(sparsePath, true), FullyLoadedData::load(sparseFactory, sparseGetter)});
+
+    for (const auto & p : pairs) {
+        REQUIRE(p.first->totalRows() == p.second->totalRows());
+        for (size_t i = 0; i < p.first->totalRows(); i++) {
+            ToBinaryVisitor binaryRow, textRow;
+            CHECK(p.first->getRow(i).visit(binaryRow) == p.second->getRow(i).visit(textRow));
+        }
+    }
+
+    std::filesystem::remove(densePath);
+    std::filesystem::remove(sparsePath);
+}
+
+TEST_CASE("Testing binary dataset rejects text and truncated input") {
+    const std::string textPath(binaryDatasetPath("rastre_text_test.txt"));
+    std::ofstream text(textPath);
+    text << matrixToString(DENSE_DATA);
+    text.close();
+    CHECK_THROWS_AS(BinaryDataset::load(textPath, false), std::invalid_argument);
+
+    const std::string path(writeBinaryDataset("rastre_truncated_test.bin", denseDataAsMatrix(), false));
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - sizeof(float));
+    CHECK_THROWS_AS(BinaryDataset::load(path, false), std::invalid_argument);
+
+    std::vector<unsigned int> tooManyRows(DENSE_DATA.size() + 1, 0);
+    std::filesystem::remove(path);
+    writeBinaryDataset("rastre_truncated_test.bin", denseDataAsMatrix(), false);
+    CHECK_THROWS_AS(BinaryDataset::load(path, false, tooManyRows, 0), std::invalid_argument);
+
+    std::filesystem::remove(textPath);
+    std::filesystem::remove(path);
+}
+
+/**
+ * Rewrites the header of the binary dataset at path in place, leaving the rest of the file as is.
+ */
+template <typename Corrupt>
+static void corruptBinaryHeader(const std::string &path, Corrupt corrupt) {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    BinaryDatasetHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(BinaryDatasetHeader));
+    corrupt(header);
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(BinaryDatasetHeader));
+}
+
+TEST_CASE("Testing binary dataset rejects sections outside the file") {
+    const std::vector<std::function<void(BinaryDatasetHeader&)>> denseCorruptions({
+        [](BinaryDatasetHeader &header) { header.stride = header.columns - 1; },
+        [](BinaryDatasetHeader &header) { header.stride = UINT64_MAX / 2; },
+        [](BinaryDatasetHeader &header) { header.rows += 1; },
+        [](BinaryDatasetHeader &header) { header.valuesStart = header.fileBytes; },
+        [](BinaryDatasetHeader &header) { header.offsetsStart = UINT64_MAX - 7; },
+        [](BinaryDatasetHeader &header) { header.valuesStart += 2; }
+    });
+    const std::vector<std::function<void(BinaryDatasetHeader&)>> sparseCorruptions({
+        [](BinaryDatasetHeader &header) { header.nonZeros += header.fileBytes; },
+        [](BinaryDatasetHeader &header) { header.nonZeros -= 1; },
+        [](BinaryDatasetHeader &header) { header.columnsStart = header.fileBytes - sizeof(uint32_t); },
+        [](BinaryDatasetHeader &header) { header.rows = UINT64_MAX; },
+        [](BinaryDatasetHeader &header) { header.offsetsStart = header.valuesStart; }
+    });
+
+    const std::string path(binaryDatasetPath("rastre_corrupt_test.bin"));
+
+    // Columns of the first row out of order, then past the last column.
+    const CompressedSparseRows rows(sparseDataAsRows());
+    REQUIRE(rows.getOffsets()[1] >= 2);
+    for (const uint32_t column : {rows.getColumns()[1], (uint32_t)SPARSE_DATA_TOTAL_COLUMNS + 1}) {
+        writeBinaryDataset("rastre_corrupt_test.bin", rows, false);
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        BinaryDatasetHeader header;
+        file.read(reinterpret_cast<char*>(&header), sizeof(BinaryDatasetHeader));
+        file.seekp(header.columnsStart);
+        file.write(reinterpret_cast<const char*>(&column), sizeof(uint32_t));
+        file.close();
+        CHECK_THROWS_AS(BinaryDataset::load(path, false), std::invalid_argument);
+    }
+
+    for (const auto &corrupt : denseCorruptions) {
+        writeBinaryDataset("rastre_corrupt_test.bin", denseDataAsMatrix(), false);
+        corruptBinaryHeader(path, corrupt);
+        CHECK_THROWS_AS(BinaryDataset::load(path, false), std::invalid_argument);
+    }
+    for (const auto &corrupt : sparseCorruptions) {
+        writeBinaryDataset("rastre_corrupt_test.bin", sparseDataAsRows(), false);
+        corruptBinaryHeader(path, corrupt);
+        CHECK_THROWS_AS(BinaryDataset::load(path, false), std::invalid_argument);
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Testing parallel conversion matches text loading") {
+    // A gap in the row ids and a line without a value exercise the sparse factory state.
+    const std::string sparseText(matrixToString(SPARSE_DATA) + "7 1\n7 3 2.5\n");
+    const size_t sparseColumns = SPARSE_DATA_TOTAL_COLUMNS;
+
+    for (const bool normalize : {false, true}) {
+        // A chunk of two lines makes rows span several chunks.
+        for (const size_t chunkLines : {(size_t)2, DatasetConverter::DEFAULT_CHUNK_LINES}) {
+            std::istringstream denseStream(matrixToString(DENSE_DATA));
+            std::istringstream sparseStream(sparseText);
+            std::istringstream denseTextStream(matrixToString(DENSE_DATA));
+            std::istringstream sparseTextStream(sparseText);
+            FromFileLineFactory denseGetter(denseTextStream);
+            FromFileLineFactory sparseGetter(sparseTextStream);
+            std::unique_ptr<DataRowFactory> denseFactory(Orchestrator::getDataRowFactory(0, normalize));
+            std::unique_ptr<DataRowFactory> sparseFactory(Orchestrator::getDataRowFactory(sparseColumns, normalize));
+
+            std::unique_ptr<BaseData> dense(new DenseMatrixData(
+                DatasetConverter::loadDense(denseStream, normalize, chunkLines), 
+                std::vector<size_t>(DENSE_DATA.size()), 
+                std::nullopt
+            ));
+            std::unique_ptr<BaseData> sparse(new CompressedSparseRowData(
+                DatasetConverter::loadSparse(sparseStream, sparseColumns, normalize, chunkLines), 
+                std::vector<size_t>(),
+                std::nullopt
+            ));
+            std::unique_ptr<FullyLoadedData> denseText(FullyLoadedData::load(*denseFactory, denseGetter));
+            std::unique_ptr<FullyLoadedData> sparseText(FullyLoadedData::load(*sparseFactory, sparseGetter));
+
+            REQUIRE(dense->totalRows() == denseText->totalRows());
+            REQUIRE(sparse->totalRows() == sparseText->totalRows());
+            for (size_t i = 0; i < dense->totalRows(); i++) {
+                ToBinaryVisitor converted, text;
+                CHECK(dense->getRow(i).visit(converted) == denseText->getRow(i).visit(text));
+            }
+            for (size_t i = 0; i < sparse->totalRows(); i++) {
+                ToBinaryVisitor converted, text;
+                CHECK(sparse->getRow(i).visit(converted) == sparseText->getRow(i).visit(text));
+            }
+        }
+    }
+}
+
+TEST_CASE("Testing converted dataset records normalization") {
+    std::istringstream input(matrixToString(DENSE_DATA));
+    const std::string path(binaryDatasetPath("rastre_converted_test.bin"));
+    std::ofstream output(path, std::ios::binary);
+    DatasetConverter::convert(input, output, 0, true, DatasetConverter::DEFAULT_CHUNK_LINES);
+    output.close();
+
+    std::shared_ptr<MappedFile> file(MappedFile::open(path));
+    CHECK(BinaryDataset::readHeader(*file).normalized == 1);
+
+    std::unique_ptr<BaseData> data(BinaryDataset::load(path, true));
+    for (size_t i = 0; i < data->totalRows(); i++) {
+        CHECK(std::abs(data->getRow(i).dotProduct(data->getRow(i)) - 1.0) < 0.0001);
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Testing from_chars parsing matches stod and istringstream") {
+    std::default_random_engine eng(11);
+    std::uniform_real_distribution<double> distribution(-1000.0, 1000.0);
+    std::vector<std::string> tokens({" 1.5", "+3.25", "-2e-3", "0.1\r", "7", "1e-45", "3.4028235e38", "0.30000001192092896"});
+    for (size_t i = 0; i < 1000; i++) {
+        std::ostringstream token;
+        token << std::setprecision(i % 17 + 1) << distribution(eng);
+        tokens.push_back(token.str());
+    }
+
+    std::string line;
+    std::vector<float> expected;
+    for (const std::string &token : tokens) {
+        line += token + ",";
+        expected.push_back(std::stod(token));
+    }
+
+    std::vector<float> parsed;
+    DenseDataRowFactory::parseLine(line, [&parsed](const float value) {
+        parsed.push_back(value);
+    });
+    CHECK(parsed == expected);
+    CHECK_THROWS_AS(DenseDataRowFactory::parseLine("1,x,2", [](const float _value) {}), std::invalid_argument);
+
+    for (const std::string edgeLine : {"3 4 0.7", "3,4,0.7", "12 5", "  8\t9   1e-3", "2.9 4.2 5 6", "1 2 x", "1 , 2", ""}) {
+        SparseDataRowFactory::Edge edge(SparseDataRowFactory::parseEdge(edgeLine));
+        std::istringstream stream(edgeLine);
+        std::vector<float> numbers;
+        float number;
+        while (numbers.size() < 3 && stream >> number) {
+            numbers.push_back(number);
+            if (stream.peek() == ',')
+                stream.ignore();
+        }
+
+        REQUIRE(edge.elements == numbers.size());
+        if (numbers.size() > 0) CHECK(edge.row == std::floor(numbers[0]));
+        if (numbers.size() > 1) CHECK(edge.to == std::floor(numbers[1]));
+        if (numbers.size() > 2) CHECK(edge.value == numbers[2]);
+    }
+}
+
+TEST_CASE("Testing line splitting for parallel loads") {
+    const std::string text("a,b\nccc\n\ndd\ne");
+    std::vector<std::string> expected({"a,b", "ccc", "", "dd", "e"});
+
+    for (size_t ranges = 1; ranges <= text.size() + 2; ranges++) {
+        const std::vector<size_t> boundaries(ParallelTextLoader::splitAtLines(text.data(), text.size(), ranges));
+        REQUIRE(boundaries.size() == ranges + 1);
+        CHECK(boundaries.back() == text.size());
+
+        std::vector<std::string> lines;
+        for (size_t i = 0; i < ranges; i++) {
+            CHECK(boundaries[i] <= boundaries[i + 1]);
+            CHECK((boundaries[i] == 0 || boundaries[i] == text.size() || text[boundaries[i] - 1] == '\n'));
+            ParallelTextLoader::forEachLine(text.data(), boundaries[i], boundaries[i + 1], [&lines](const std::string_view line) {
+                lines.push_back(std::string(line));
+            });
+        }
+        CHECK(lines == expected);
+    }
+}
+
+TEST_CASE("Testing parallel text loading matches text loading") {
+    // Large enough that every thread gets a range of its own.
+    const size_t rows = 3000;
+    const size_t columns = 40;
+    std::default_random_engine eng(7);
+    std::normal_distribution<float> distribution;
+    std::ostringstream dense, sparse;
+    dense << std::setprecision(9);
+    for (size_t row = 0; row < rows; row++) {
+        for (size_t column = 0; column < columns; column++) {
+            dense << distribution(eng) << (column + 1 < columns ? "," : "\n");
+        }
+
+        // Skip every seventh row id and leave out some values to exercise the factory state.
+        if (row % 7 != 3) {
+            for (size_t column = row % 5; column < columns; column += 3) {
+                sparse << row << " " << column;
+                if (column % 4 != 0) {
+                    sparse << " " << distribution(eng);
+                }
+                sparse << "\n";
+            }
+        }
+    }
+
+    const std::string densePath(binaryDatasetPath("rastre_parallel_dense.csv"));
+    const std::string sparsePath(binaryDatasetPath("rastre_parallel_sparse.txt"));
+    std::ofstream(densePath) << dense.str();
+    std::ofstream(sparsePath) << sparse.str();
+
+    std::vector<unsigned int> rankMapping(rows - 10);
+    for (size_t i = 0; i < rankMapping.size(); i++) {
+        rankMapping[i] = (i * 7) % 3;
+    }
+
+    const int threads = omp_get_max_threads();
+    omp_set_num_threads(4);
+    for (const bool normalize : {false, true}) {
+        for (const size_t sparseColumns : {(size_t)0, columns}) {
+            const std::string &path(sparseColumns > 0 ? sparsePath : densePath);
+
+            std::unique_ptr<DataRowFactory> factory(Orchestrator::getDataRowFactory(sparseColumns, normalize));
+            std::ifstream input(path);
+            FromFileLineFactory getter(input);
+            std::unique_ptr<FullyLoadedData> text(FullyLoadedData::load(*factory, getter));
+            std::unique_ptr<BaseData> parallel(ParallelTextLoader::load(path, sparseColumns, normalize));
+
+            REQUIRE(parallel->totalRows() == text->totalRows());
+            for (size_t i = 0; i < text->totalRows(); i++) {
+                ToBinaryVisitor loaded, expected;
+                CHECK(parallel->getRow(i).visit(loaded) == text->getRow(i).visit(expected));
+            }
+
+            for (unsigned int rank = 0; rank < 3; rank++) {
+                std::unique_ptr<BaseData> segmented(ParallelTextLoader::load(path, sparseColumns, normalize, rankMapping, rank));
+                size_t seen = 0;
+                for (size_t i = 0; i < rankMapping.size(); i++) {
+                    if (rankMapping[i] == rank) {
+                        ToBinaryVisitor loaded, expected;
+                        CHECK(segmented->getRemoteIndexForRow(seen) == i);
+                        CHECK(segmented->getRow(seen).visit(loaded) == text->getRow(i).visit(expected));
+                        seen++;
+                    }
+                }
+                CHECK(segmented->totalRows() == seen);
+            }
+        }
+    }
+
+    std::vector<unsigned int> tooManyRows(rows + 1, 0);
+    CHECK_THROWS_AS(ParallelTextLoader::load(densePath, 0, false, tooManyRows, 0), std::invalid_argument);
+    CHECK_THROWS_AS(ParallelTextLoader::load(sparsePath, columns, false, tooManyRows, 0), std::invalid_argument);
+    omp_set_num_threads(threads);
+
+    std::filesystem::remove(densePath);
+    std::filesystem::remove(sparsePath);
+}
+
+TEST_CASE("Testing mapped file lines match stream lines") {
+    const std::string path(binaryDatasetPath("rastre_mapped_lines.txt"));
+    for (const std::string text : {"", "\n", "a,b\nccc", "a,b\n\nccc\n", "1 2 3\n4 5\n\n\n6\n"}) {
+        std::ofstream(path) << text;
+
+        // Skip every third line to check that skipping stays in step with reading.
+        for (const bool view : {false, true}) {
+            std::istringstream stream(text);
+            FromFileLineFactory expected(stream);
+            std::unique_ptr<MappedFileLineFactory> mapped(MappedFileLineFactory::open(path));
+
+            for (size_t line = 0; line < 8; line++) {
+                if (line % 3 == 2) {
+                    expected.skipNext();
+                    mapped->skipNext();
+                    continue;
+                }
+
+                std::optional<std::string> expectedLine(expected.maybeGet());
+                std::optional<std::string> mappedLine;
+                if (view) {
+                    std::optional<std::string_view> mappedView(mapped->maybeGetView());
+                    if (mappedView.has_value()) {
+                        mappedLine = std::string(mappedView.value());
+                    }
+                } else {
+                    mappedLine = mapped->maybeGet();
+                }
+                CHECK(mappedLine == expectedLine);
+            }
+        }
+    }
+
+    std::ofstream(path) << matrixToString(DENSE_DATA);
+    std::unique_ptr<LineFactory> getter(MappedFileLineFactory::open(path));
+    DenseDataRowFactory factory;
+    std::unique_ptr<FullyLoadedData> data(FullyLoadedData::load(factory, *getter));
+    CHECK(data->totalRows() == DENSE_DATA.size());
+    verifyData(*data);
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Testing line views match lines") {
+    std::unique_ptr<GeneratedLineFactory> generated(GeneratedDenseLineFactory::create(5, 4, NormalRandomNumberGenerator::create(3)));
+    std::unique_ptr<GeneratedLineFactory> copy(generated->copy());
+    for (size_t i = 0; i < 6; i++) {
+        std::optional<std::string> line(generated->maybeGet());
+        std::optional<std::string_view> view(copy->maybeGetView());
+        REQUIRE(line.has_value() == view.has_value());
+        if (line.has_value()) {
+            CHECK(line.value() == view.value());
+        }
+    }
+
+    std::istringstream stream(matrixToString(DENSE_DATA));
+    FromFileLineFactory getter(stream);
+    std::istringstream expectedStream(matrixToString(DENSE_DATA));
+    for (size_t i = 0; i <= DENSE_DATA.size(); i++) {
+        std::optional<std::string_view> view(getter.maybeGetView());
+        std::string expected;
+        REQUIRE(view.has_value() == (bool)std::getline(expectedStream, expected));
+        if (view.has_value()) {
+            CHECK(view.value() == expected);
+        }
+    }
+}
+
+TEST_CASE("Testing reparse matches printing and parsing") {
+    std::default_random_engine eng(13);
+    std::normal_distribution<float> normal;
+    std::uniform_real_distribution<float> exponent(-30, 30);
+    for (size_t i = 0; i < 20000; i++) {
+        const float value = normal(eng) * std::pow(10.0f, exponent(eng));
+        std::stringstream printed;
+        printed << value;
+
+        float expectedFloat;
+        std::istringstream(printed.str()) >> expectedFloat;
+        CHECK(NumberParser::reparse<double>(value) == std::stod(printed.str()));
+        CHECK(NumberParser::reparse<float>(value) == expectedFloat);
+    }
+}
+
+TEST_CASE("Testing generated rows match generated lines") {
+    const size_t rows = 300;
+    const size_t columns = 30;
+    std::vector<unsigned int> rankMapping(rows - 5);
+    for (size_t i = 0; i < rankMapping.size(); i++) {
+        rankMapping[i] = (i * 7) % 3;
+    }
+
+    auto checkSame = [](const BaseData &loaded, const BaseData &expected) {
+        REQUIRE(loaded.totalRows() == expected.totalRows());
+        for (size_t i = 0; i < expected.totalRows(); i++) {
+            ToBinaryVisitor loadedRow, expectedRow;
+            CHECK(loaded.getRemoteIndexForRow(i) == expected.getRemoteIndexForRow(i));
+            CHECK(loaded.getRow(i).visit(loadedRow) == expected.getRow(i).visit(expectedRow));
+        }
+    };
+
+    std::unique_ptr<GeneratedLineFactory> dense(GeneratedDenseLineFactory::create(rows, columns, NormalRandomNumberGenerator::create(11)));
+    DenseDataRowFactory denseText;
+    GeneratedDenseDataRowFactory denseGenerated;
+    std::unique_ptr<GeneratedLineFactory> denseCopy(dense->copy());
+    std::unique_ptr<GeneratedLineFactory> denseMatrixCopy(dense->copy());
+    std::unique_ptr<FullyLoadedData> denseExpected(FullyLoadedData::load(denseText, *dense->copy()));
+    checkSame(*FullyLoadedData::load(denseGenerated, *denseCopy), *denseExpected);
+    checkSame(*DenseMatrixData::load(denseGenerated, *denseMatrixCopy), *denseExpected);
+
+    for (unsigned int rank = 0; rank < 3; rank++) {
+        checkSame(
+            *LoadedSegmentedData::loadInParallel(denseGenerated, *dense, rankMapping, rank), 
+            *LoadedSegmentedData::loadInParallel(denseText, *dense, rankMapping, rank)
+        );
+    }
+
+    // High sparsities leave whole rows without edges.
+    for (const float sparsity : {0.5f, 0.9f, 0.99f}) {
+        std::unique_ptr<GeneratedLineFactory> sparse(GeneratedSparseLineFactory::create(
+            rows, columns, sparsity, NormalRandomNumberGenerator::create(11), UniformRandomNumberGenerator::create(12)
+        ));
+        SparseDataRowFactory sparseText(columns);
+        GeneratedSparseDataRowFactory sparseGenerated(columns);
+        std::unique_ptr<GeneratedLineFactory> sparseCopy(sparse->copy());
+        std::unique_ptr<FullyLoadedData> sparseExpected(FullyLoadedData::load(sparseText, *sparse->copy()));
+        checkSame(*FullyLoadedData::load(sparseGenerated, *sparseCopy), *sparseExpected);
+
+        GeneratedSparseDataRowFactory sparseRowsGenerated(columns);
+        std::unique_ptr<GeneratedLineFactory> sparseRowsCopy(sparse->copy());
+        checkSame(*CompressedSparseRowData::load(sparseRowsGenerated, *sparseRowsCopy, columns), *sparseExpected);
+
+        // Rows after the last edge are never generated.
+        const std::vector<unsigned int> sparseMapping(rankMapping.begin(), rankMapping.begin() + std::min(rankMapping.size(), sparseExpected->totalRows() - 1));
+        for (unsigned int rank = 0; rank < 3; rank++) {
+            SparseDataRowFactory segmentedText(columns);
+            GeneratedSparseDataRowFactory segmentedGenerated(columns);
+            std::unique_ptr<GeneratedLineFactory> textCopy(sparse->copy());
+            std::unique_ptr<GeneratedLineFactory> generatedCopy(sparse->copy());
+            checkSame(
+                *LoadedSegmentedData::load(segmentedGenerated, *generatedCopy, sparseMapping, rank), 
+                *LoadedSegmentedData::load(segmentedText, *textCopy, sparseMapping, rank)
+            );
+        }
+    }
+
+    GeneratedDenseDataRowFactory mismatched;
+    std::istringstream stream(matrixToString(DENSE_DATA));
+    FromFileLineFactory getter(stream);
+    CHECK_THROWS_AS(mismatched.maybeGet(getter), std::invalid_argument);
+}
+
+TEST_CASE("Testing Philox matches its known answers") {
+    const Philox::Block zeros(Philox::generate({0, 0, 0, 0}, {0, 0}));
+    CHECK(zeros == Philox::Block{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8});
+
+    const Philox::Block ones(Philox::generate({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff}));
+    CHECK(ones == Philox::Block{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd});
+
+    const Philox::Block pi(Philox::generate({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0}));
+    CHECK(pi == Philox::Block{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1});
+}
+
+TEST_CASE("Testing Philox generators skip in place") {
+    for (const bool normal : {false, true}) {
+        auto create = [normal](const long unsigned int seed) {
+            return normal ? PhiloxNormalRandomNumberGenerator::create(seed) : PhiloxUniformRandomNumberGenerator::create(seed);
+        };
+
+        std::unique_ptr<RandomNumberGenerator> stepped(create(9));
+        std::vector<float> values;
+        double sum = 0;
+        double squares = 0;
+        for (size_t i = 0; i < 100000; i++) {
+            values.push_back(stepped->getNumber());
+            sum += values.back();
+            squares += values.back() * values.back();
+        }
+
+        const double mean = sum / values.size();
+        const double variance = squares / values.size() - mean * mean;
+        CHECK(std::abs(mean - (normal ? 0.0 : 0.5)) < 0.01);
+        CHECK(std::abs(variance - (normal ? 1.0 : 1.0 / 12)) < 0.02);
+
+        for (const size_t skip : {0, 1, 2, 3, 5, 1000, 77777}) {
+            std::unique_ptr<RandomNumberGenerator> skipped(create(9));
+            skipped->skipNextElements(skip);
+            CHECK(skipped->getNumber() == values[skip]);
+
+            std::unique_ptr<RandomNumberGenerator> copy(skipped->copy());
+            CHECK(skipped->getNumber() == values[skip + 1]);
+            CHECK(copy->getNumber() == values[skip + 1]);
+        }
+
+        std::unique_ptr<RandomNumberGenerator> other(create(10));
+        CHECK(other->getNumber() != values[0]);
+    }
+}
+
+TEST_CASE("Testing geometric sparse generation jumps to any row") {
+    const size_t rows = 2000;
+    const size_t columns = 200;
+    const float sparsity = 0.9;
+    auto create = [=]() {
+        return GeometricSparseLineFactory::create(
+            rows, columns, sparsity, PhiloxNormalRandomNumberGenerator::create(3), PhiloxUniformRandomNumberGenerator::create(4)
+        );
+    };
+
+    std::unique_ptr<GeometricSparseLineFactory> generator(create());
+    std::vector<std::vector<std::pair<size_t, float>>> edges(rows);
+    size_t row, column;
+    float value;
+    while (generator->maybeGenerateEdge(row, column, value)) {
+        REQUIRE(row < rows);
+        REQUIRE(column < columns);
+        if (edges[row].size() > 0) {
+            CHECK(edges[row].back().first < column);
+        }
+        edges[row].push_back({column, value});
+    }
+
+    size_t total = 0;
+    for (const auto &rowEdges : edges) {
+        total += rowEdges.size();
+    }
+    CHECK(std::abs(total - rows * columns * (1 - sparsity)) < 0.05 * rows * columns * (1 - sparsity));
+
+    for (const size_t target : {(size_t)1, (size_t)17, rows / 2, rows - 1}) {
+        std::unique_ptr<GeometricSparseLineFactory> jumped(create());
+        jumped->jumpToLine(target);
+        std::unique_ptr<GeneratedLineFactory> copy(jumped->copy());
+        GeneratedEdgeLineFactory &copied(dynamic_cast<GeneratedEdgeLineFactory&>(*copy));
+        for (size_t i = 0; i < edges[target].size(); i++) {
+            REQUIRE(jumped->maybeGenerateEdge(row, column, value));
+            CHECK(row == target);
+            CHECK(column == edges[target][i].first);
+            CHECK(value == edges[target][i].second);
+            REQUIRE(copied.maybeGenerateEdge(row, column, value));
+            CHECK(value == edges[target][i].second);
+        }
+    }
+
+    std::vector<unsigned int> rankMapping(rows - 1);
+    for (size_t i = 0; i < rankMapping.size(); i++) {
+        rankMapping[i] = (i * 7) % 3;
+    }
+
+    std::unique_ptr<GeometricSparseLineFactory> text(create());
+    SparseDataRowFactory textFactory(columns);
+    GeneratedSparseDataRowFactory generatedFactory(columns);
+    std::unique_ptr<FullyLoadedData> expected(FullyLoadedData::load(textFactory, *text));
+    for (unsigned int rank = 0; rank < 3; rank++) {
+        std::unique_ptr<GeometricSparseLineFactory> parallel(create());
+        std::unique_ptr<BaseData> segmented(LoadedSegmentedData::loadInParallel(generatedFactory, *parallel, rankMapping, rank));
+        size_t seen = 0;
+        for (size_t i = 0; i < rankMapping.size(); i++) {
+            if (rankMapping[i] == rank) {
+                ToBinaryVisitor loaded, expectedRow;
+                CHECK(segmented->getRemoteIndexForRow(seen) == i);
+                CHECK(segmented->getRow(seen++).visit(loaded) == expected->getRow(i).visit(expectedRow));
+            }
+        }
+        CHECK(seen == segmented->totalRows());
+    }
+}
+
+TEST_CASE("Testing SIMD kernels match scalar kernels") {
+    std::default_random_engine eng(21);
+    std::normal_distribution<float> distribution;
+    const size_t denseColumns = 5000;
+    std::vector<float> dense(denseColumns);
+    for (float &value : dense) {
+        value = distribution(eng);
+    }
+
+    for (const SimdLevel level : {SimdLevel::SCALAR, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        if (!SimdKernels::supports(level)) {
+            CHECK_THROWS_AS(SimdKernels::forLevel(level), std::invalid_argument);
+            continue;
+        }
+
+        const SimdKernels::Table kernels(SimdKernels::forLevel(level));
+        CHECK(kernels.level == level);
+        for (const size_t size : {0, 1, 3, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 100, 1000, 4999}) {
+            std::vector<float> a(dense.begin(), dense.begin() + size);
+            std::vector<float> b(size);
+            std::vector<unsigned int> columns(size);
+            std::uniform_int_distribution<unsigned int> column(0, denseColumns - 1);
+            double magnitude = 0;
+            double gatherMagnitude = 0;
+            for (size_t i = 0; i < size; i++) {
+                b[i] = distribution(eng);
+                columns[i] = column(eng);
+                magnitude += std::abs(a[i] * b[i]);
+                gatherMagnitude += std::abs(dense[columns[i]] * b[i]);
+            }
+
+            // Kernels must not read past the end of their inputs, so copy them to exactly sized 
+            //  buffers.
+            std::unique_ptr<float[]> exactA(new float[size]);
+            std::unique_ptr<float[]> exactB(new float[size]);
+            std::unique_ptr<unsigned int[]> exactColumns(new unsigned int[size]);
+            std::copy(a.begin(), a.end(), exactA.get());
+            std::copy(b.begin(), b.end(), exactB.get());
+            std::copy(columns.begin(), columns.end(), exactColumns.get());
+
+            const float expected = SimdKernels::dotScalar(a.data(), b.data(), size);
+            const float expectedGather = SimdKernels::gatherDotScalar(dense.data(), columns.data(), b.data(), size);
+            CHECK(std::abs(kernels.dot(exactA.get(), exactB.get(), size) - expected) <= 1e-5 * magnitude + 1e-6);
+            CHECK(std::abs(kernels.gatherDot(dense.data(), exactColumns.get(), exactB.get(), size) - expectedGather) <= 1e-5 * gatherMagnitude + 1e-6);
+        }
+    }
+
+    CHECK(SimdKernels::supports(SimdKernels::active().level));
+    CHECK(SimdKernels::active().level == SimdKernels::best());
+}
+
+TEST_CASE("Testing row index loads match scanning loads") {
+    const size_t rows = 3000;
+    const size_t columns = 40;
+    std::default_random_engine eng(5);
+    std::normal_distribution<float> distribution;
+    std::ostringstream dense, sparse;
+    dense << std::setprecision(9);
+    for (size_t row = 0; row < rows; row++) {
+        for (size_t column = 0; column < columns; column++) {
+            dense << distribution(eng) << (column + 1 < columns ? "," : "\n");
+        }
+
+        // Rows that start without a value inherit the value of the row before them, and
+        //  blank lines repeat the edge before them.
+        if (row % 11 != 4) {
+            for (size_t column = row % 3; column < columns; column += 4) {
+                sparse << row << " " << column;
+                if (column % 3 != 0) {
+                    sparse << " " << distribution(eng);
+                }
+                sparse << (column % 13 == 5 ? "\n\n" : "\n");
+            }
+        }
+    }
+
+    const std::string densePath(binaryDatasetPath("rastre_indexed_dense.csv"));
+    const std::string sparsePath(binaryDatasetPath("rastre_indexed_sparse.txt"));
+    std::ofstream(densePath) << dense.str();
+    std::ofstream(sparsePath) << sparse.str();
+
+    // Random rows are coalesced into large reads, blocks of rows are read separately.
+    std::vector<unsigned int> randomMapping(rows - 3);
+    std::vector<unsigned int> blockMapping(rows);
+    for (size_t i = 0; i < rows; i++) {
+        if (i < randomMapping.size()) {
+            randomMapping[i] = eng() % 3;
+        }
+        blockMapping[i] = (i / 500) % 3;
+    }
+
+    for (const size_t sparseColumns : {(size_t)0, columns}) {
+        const std::string &path(sparseColumns > 0 ? sparsePath : densePath);
+        std::filesystem::remove(RowIndex::sidecarPath(path));
+        CHECK(!RowIndex::maybeLoad(path, sparseColumns).has_value());
+
+        RowIndex::build(path, sparseColumns).write(path);
+        CHECK(!RowIndex::maybeLoad(path, sparseColumns > 0 ? 0 : columns).has_value());
+        std::optional<RowIndex> index(RowIndex::maybeLoad(path, sparseColumns));
+        REQUIRE(index.has_value());
+        CHECK(index.value().totalRows() == rows);
+
+        for (const bool normalize : {false, true}) {
+            for (const std::vector<unsigned int> &rankMapping : {randomMapping, blockMapping}) {
+                for (unsigned int rank = 0; rank < 3; rank++) {
+                    std::unique_ptr<BaseData> scanned(ParallelTextLoader::load(path, sparseColumns, normalize, rankMapping, rank));
+                    std::unique_ptr<BaseData> indexed(index.value().load(path, sparseColumns, normalize, rankMapping, rank));
+
+                    REQUIRE(indexed->totalRows() == scanned->totalRows());
+                    for (size_t i = 0; i < scanned->totalRows(); i++) {
+                        ToBinaryVisitor loaded, expected;
+                        CHECK(indexed->getRemoteIndexForRow(i) == scanned->getRemoteIndexForRow(i));
+                        CHECK(indexed->getRow(i).visit(loaded) == scanned->getRow(i).visit(expected));
+                    }
+                }
+            }
+        }
+
+        std::vector<unsigned int> tooManyRows(rows + 1, 0);
+        CHECK_THROWS_AS(index.value().load(path, sparseColumns, false, tooManyRows, 0), std::invalid_argument);
+
+        // A huge row count, an offset past the next one and a last offset short of the input.
+        const uint64_t inputBytes = std::filesystem::file_size(path);
+        const std::vector<std::pair<size_t, uint64_t>> corruptions{
+            {offsetof(RowIndexHeader, rows), (uint64_t)1 << 60},
+            {sizeof(RowIndexHeader) + sizeof(uint64_t), inputBytes + 1},
+            {sizeof(RowIndexHeader) + rows * sizeof(uint64_t), inputBytes - 1}
+        };
+        for (const auto &[position, value] : corruptions) {
+            RowIndex::build(path, sparseColumns).write(path);
+            std::fstream sidecar(RowIndex::sidecarPath(path), std::ios::in | std::ios::out | std::ios::binary);
+            sidecar.seekp(position);
+            sidecar.write(reinterpret_cast<const char*>(&value), sizeof(value));
+            sidecar.close();
+            CHECK(!RowIndex::maybeLoad(path, sparseColumns).has_value());
+        }
+
+        std::ofstream(path, std::ios::app) << "\n";
+        CHECK(!RowIndex::maybeLoad(path, sparseColumns).has_value());
+        std::filesystem::remove(RowIndex::sidecarPath(path));
+    }
+
+    std::filesystem::remove(densePath);
+    std::filesystem::remove(sparsePath);
+}
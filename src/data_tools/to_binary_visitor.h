@@ -22,6 +22,18 @@ class ToBinaryVisitor : public ReturningDataRowVisitor<std::vector<float>> {
         }
     }
 
+    void visitSparseDataRowView(const unsigned int* columns, const float* values, const size_t nonZeros, const size_t _totalColumns) {
+        binary.reserve(nonZeros * 2);
+        for (size_t i = 0; i < nonZeros; i++) {
+            binary.push_back(static_cast<float>(columns[i]));
+            binary.push_back(values[i]);
+        }
+    }
+
+    void visitDenseDataRowView(const float* data, const size_t totalColumns) {
+        binary.assign(data, data + totalColumns);
+    }
+
     std::vector<float> get() {
         return std::move(binary);
     }
@@ -32,20 +32,16 @@ int main(int argc, char** argv) {
     std::vector<double> ilad_per_user(total_solutions, 0.0);
     std::vector<double> ilmd_per_user(total_solutions, 0.0);
 
-    std::unique_ptr<LineFactory> getter;
-    std::ifstream inputFile;
-    if (appData.loadInput.inputFile != NO_FILE_DEFAULT) {
-        inputFile.open(appData.loadInput.inputFile);
-        getter = std::unique_ptr<FromFileLineFactory>(new FromFileLineFactory(inputFile));
+    std::unique_ptr<BaseData> data;
+    if (appData.binaryInput) {
+        data = Orchestrator::loadBinaryData(appData);
+    } else if (appData.loadInput.inputFile != NO_FILE_DEFAULT) {
+        data = Orchestrator::loadTextData(appData);
     } else if (appData.generateInput.seed != DEFAULT_VALUE) {
-        getter = Orchestrator::getLineGenerator(appData);
+        std::unique_ptr<GeneratedLineFactory> getter(Orchestrator::getLineGenerator(appData));
+        data = Orchestrator::loadData(appData, *getter.get());
     }
 
-    std::unique_ptr<BaseData> data(Orchestrator::loadData(appData, *getter.get()));
-    if (appData.loadInput.inputFile != NO_FILE_DEFAULT) {
-        inputFile.close();
-    } 
-
     spdlog::info("Finished loading dataset of size {0:d} ...", data->totalRows());
 
     std::map<unsigned long long, std::unique_ptr<UserData>> userMap;
@@ -74,13 +70,19 @@ int main(int argc, char** argv) {
         std::vector<std::vector<double>> scores(ru.size(), std::vector<double>(ru.size()));
         double ilmd = std::numeric_limits<double>::max();
         double aggregate_scores = 0.0;
+        std::vector<size_t> targets(ru.size());
+        for (size_t i = 0; i < ru.size(); i++) {
+            targets[i] = i;
+        }
+        std::vector<float> similarities(ru.size());
         for (size_t j = 0; j < ru.size(); j++) {
+            calc->getRow(j, targets.data(), targets.size(), similarities.data());
             for (size_t i = 0; i < ru.size(); i++) {
                 if (j == i) {
                     continue;
                 }
 
-                const float v = 1.0 - calc->get(i, j); 
+                const float v = 1.0 - similarities[i]; 
                 SPDLOG_TRACE("i of {0:d} and j of {1:d} got score of {2:f}", i, j, v);
                 scores[j][i] = v;
                 ilmd = std::min(ilmd, (double)v);
@@ -19,7 +19,11 @@
 #include "data_tools/user_mode_data.h"
 #include "user_mode/user_subset.h"
 
-std::unique_ptr<Subset> randGreedi(
+/**
+ * One solution, or one per size of the k sweep. Local and global steps both run once to the
+ *  largest size.
+ */
+std::vector<std::unique_ptr<Subset>> randGreedi(
     const AppData &appData, 
     const BaseData &data, 
     const RelevanceCalculatorFactory& calcFactory,
@@ -31,19 +35,24 @@ std::unique_ptr<Subset> randGreedi(
     timers.totalCalculationTime.startTimer();
     if (appData.worldRank != 0) {
         spdlog::info("attempting to calculate global solution on rank {0:d}", appData.worldRank);
-        std::unique_ptr<SubsetCalculator> calculator(MpiOrchestrator::getCalculator(appData));
+        std::unique_ptr<SubsetCalculator> calculator(MpiOrchestrator::getCalculator(appData, timers));
         
         std::unique_ptr<RelevanceCalculator> calc(calcFactory.build(data));
         timers.localCalculationTime.startTimer();
         std::unique_ptr<Subset> localSolution(calculator->getApproximationSet(
-            NaiveMutableSubset::makeNew(), *calc, data, appData.outputSetSize)
+            Orchestrator::getConsumer(appData), *calc, data, appData.outputSetSize)
         );
         timers.localCalculationTime.stopTimer();
         spdlog::info("finished finding solution for rank {0:d} of score {1:f}", appData.worldRank, localSolution->getScore());
         
+        std::vector<float> prefixScores;
+        if (!appData.kSweep.empty()) {
+            prefixScores = KSweepSubset::from(*localSolution).getPrefixScores();
+        }
+
         // TODO: batch this into blocks using a custom MPI type to send higher volumes of data.
         timers.bufferEncodingTime.startTimer();
-        sendDataSize = BufferBuilder::buildSendBuffer(data, *localSolution.get(), sendBuffer);
+        sendDataSize = BufferBuilder::buildSendBuffer(data, *localSolution.get(), prefixScores, sendBuffer);
         timers.bufferEncodingTime.stopTimer();
     } 
     
@@ -85,23 +94,30 @@ std::unique_ptr<Subset> randGreedi(
     
     if (appData.worldRank == 0) {
         spdlog::debug("rank 0 starting to process seeds");
-        std::unique_ptr<SubsetCalculator> globalCalculator(MpiOrchestrator::getCalculator(appData));
+        std::unique_ptr<SubsetCalculator> globalCalculator(MpiOrchestrator::getCalculator(appData, timers));
         std::unique_ptr<DataRowFactory> factory(Orchestrator::getDataRowFactory(appData));
 
         spdlog::debug("building buffer on rank 0");
-        GlobalBufferLoader bufferLoader(receiveBuffer, data.totalColumns(), displacements, timers, calcFactory);
+        GlobalBufferLoader bufferLoader(receiveBuffer, data.totalColumns(), displacements, timers, calcFactory, appData.kSweep.size());
 
         spdlog::debug("getting global solution");
-        std::unique_ptr<Subset> globalSolution(bufferLoader.getSolution(std::move(globalCalculator), appData.outputSetSize, *factory.get()));
+        std::vector<std::unique_ptr<Subset>> globalSolutions;
+        if (appData.kSweep.empty()) {
+            globalSolutions.push_back(bufferLoader.getSolution(std::move(globalCalculator), appData.outputSetSize, *factory.get()));
+        } else {
+            globalSolutions = bufferLoader.getSolutions(std::move(globalCalculator), appData.kSweep, *factory.get());
+        }
 
         timers.totalCalculationTime.stopTimer();
 
         spdlog::debug("rank 0 returning solution");
-        return std::move(globalSolution);
+        return globalSolutions;
     } else {
         // used to load global timers on rank 0
         timers.totalCalculationTime.stopTimer();
-        return Subset::empty();
+        std::vector<std::unique_ptr<Subset>> emptySolutions;
+        emptySolutions.push_back(Subset::empty());
+        return emptySolutions;
     }
 }
 
@@ -152,7 +168,7 @@ std::unique_ptr<Subset> streaming(
         std::unique_ptr<MutableSubset> subset(
             new StreamingSubset(data, NaiveMutableSubset::makeNew(), timers, std::floor(appData.outputSetSize * appData.alpha))
         );
-        std::unique_ptr<SubsetCalculator> calculator(MpiOrchestrator::getCalculator(appData));
+        std::unique_ptr<SubsetCalculator> calculator(MpiOrchestrator::getCalculator(appData, timers));
         spdlog::info("rank {0:d} is ready to start streaming local seeds", appData.worldRank);
 
         timers.localCalculationTime.startTimer();
@@ -180,7 +196,7 @@ std::vector<std::unique_ptr<Subset>> getSolutions(
 ) {
     std::vector<std::unique_ptr<Subset>> solutions;
     if (appData.distributedAlgorithm == 0) {
-        solutions.push_back(randGreedi(appData, data, calc, timers));
+        solutions = randGreedi(appData, data, calc, timers);
     } else if (appData.distributedAlgorithm == 1 || appData.distributedAlgorithm == 2) {
         solutions.push_back(streaming(appData, data, calc, timers));
     } else if (appData.distributedAlgorithm == 3) {
@@ -235,6 +251,15 @@ int main(int argc, char** argv) {
         throw std::invalid_argument("Please set the number of rows (the numberOfDataRows arg)");
     }
 
+    if (!appData.kSweep.empty() && appData.distributedAlgorithm != 0) {
+        throw std::invalid_argument("kSweep is only supported with randGreedi (distributedAlgorithm 0).");
+    }
+    Orchestrator::resolveKSweep(appData);
+
+    if (appData.checkpointFile != NO_FILE_DEFAULT || appData.resumeFile != NO_FILE_DEFAULT) {
+        throw std::invalid_argument("Ranks are given different rows every run, so checkpoints are only supported by the single machine tool.");
+    }
+
     MPI_Init(NULL, NULL);
     MPI_Comm_rank(MPI_COMM_WORLD, &appData.worldRank);
     MPI_Comm_size(MPI_COMM_WORLD, &appData.worldSize);
@@ -266,14 +291,22 @@ int main(int argc, char** argv) {
 
     size_t baseline = getPeakRSS();
 
+    if (appData.buildRowIndex && !appData.binaryInput && appData.loadInput.inputFile != NO_FILE_DEFAULT) {
+        if (appData.worldRank == 0 && !RowIndex::maybeLoad(appData.loadInput.inputFile, appData.adjacencyListColumnCount).has_value()) {
+            spdlog::info("building row index for {}", appData.loadInput.inputFile);
+            RowIndex::build(appData.loadInput.inputFile, appData.adjacencyListColumnCount).write(appData.loadInput.inputFile);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
     spdlog::info("Starting load for rank {0:d}", appData.worldRank);
     std::unique_ptr<BaseData> data;
-    if (appData.loadInput.inputFile != NO_FILE_DEFAULT) {
-        std::ifstream inputFile;
-        inputFile.open(appData.loadInput.inputFile);
-        std::unique_ptr<LineFactory> getter(std::unique_ptr<FromFileLineFactory>(new FromFileLineFactory(inputFile)));
-        data = Orchestrator::buildMpiData(appData, *getter.get(), rowToRank);
-        inputFile.close();
+    if (appData.binaryInput) {
+        data = Orchestrator::buildMpiBinaryData(appData, rowToRank);
+    } else if (appData.loadInput.inputFile != NO_FILE_DEFAULT && appData.collectiveLoad) {
+        data = MpiOrchestrator::buildCollectiveTextData(appData, rowToRank);
+    } else if (appData.loadInput.inputFile != NO_FILE_DEFAULT) {
+        data = Orchestrator::buildMpiTextData(appData, rowToRank);
     } else if (appData.generateInput.seed != DEFAULT_VALUE) {
         std::unique_ptr<GeneratedLineFactory> getter(Orchestrator::getLineGenerator(appData));
         data = Orchestrator::buildMpiData(appData, *getter.get(), rowToRank);
@@ -28,6 +28,19 @@ class BufferBuilder : public Buffer {
         const BaseData &data, 
         const Subset &localSolution, 
         std::vector<float> &buffer
+    ) {
+        return buildSendBuffer(data, localSolution, std::vector<float>(), buffer);
+    }
+
+    /**
+     * Sends the score of every prefix of a k sweep right after the score of the whole local 
+     *  solution, so the receiver can pick the best local solution for every size.
+     */
+    static unsigned int buildSendBuffer(
+        const BaseData &data, 
+        const Subset &localSolution, 
+        const std::vector<float> &prefixScores,
+        std::vector<float> &buffer
     ) {
         // Need to include an additional column that marks the index of the sent row
         std::vector<std::vector<float>> buffers(localSolution.size());
@@ -45,7 +58,7 @@ class BufferBuilder : public Buffer {
             buffers[localRowIndex].push_back(CommunicationConstants::endOfSendTag());
         }
 
-        size_t totalSend = 1;
+        size_t totalSend = FLOATS_FOR_LOCAL_MARGINAL_PER_BUFFER + prefixScores.size();
         for (const auto & b : buffers) {
             totalSend += b.size();
         }
@@ -53,7 +66,11 @@ class BufferBuilder : public Buffer {
         buffer.resize(totalSend, 0);
         buffer[0] = localSolution.getScore();
 
-        size_t i = 1;
+        size_t i = FLOATS_FOR_LOCAL_MARGINAL_PER_BUFFER;
+        for (const float prefixScore : prefixScores) {
+            buffer[i++] = prefixScore;
+        }
+
         for (const auto & b : buffers) {
             for (const auto d : b) {
                 buffer[i++] = d;
@@ -105,40 +122,50 @@ class GlobalBufferLoader : public BufferLoader {
     const size_t worldSize;
     const RelevanceCalculatorFactory &calcFactory;
 
+    // The number of prefix scores every rank sent after the score of its local solution.
+    const size_t prefixScoresPerRank;
+
     public:
     std::unique_ptr<Subset> getSolution(
         std::unique_ptr<SubsetCalculator> calculator, 
         const size_t k,
         const DataRowFactory &factory
     ) {
-        this->timers.bufferDecodingTime.startTimer();
-        spdlog::debug("getting best rows");
-        std::unique_ptr<ReceivedData> bestRows(
-            ReceivedData::create(
-                std::move(this->rebuildData(factory))
-            )
+        std::vector<std::unique_ptr<Subset>> globalResult(
+            this->getGlobalSolutions(std::move(calculator), NaiveMutableSubset::makeNew(), k, factory)
         );
-        this->timers.bufferDecodingTime.stopTimer();
 
-        timers.globalCalculationTime.startTimer();
-
-        spdlog::debug("calculating global solution on received rows of size {0:d}", bestRows->totalRows());
-        std::unique_ptr<RelevanceCalculator> calc(calcFactory.build(*bestRows));
-        std::unique_ptr<Subset> untranslatedSolution(calculator->getApproximationSet(
-            NaiveMutableSubset::makeNew(), *calc, *bestRows, k)
-        );
-        std::unique_ptr<Subset> globalResult(bestRows->translateSolution(std::move(untranslatedSolution)));
+        return best(std::move(globalResult.front()), this->getBestLocalSolution(0, k));
+    }
 
-        timers.globalCalculationTime.stopTimer();
+    /**
+     * The best solution for every size of a k sweep from a single global run to the largest
+     *  size. Each size compares the prefix of the global solution against the best prefix any
+     *  rank found. Sizes must be sorted, and every rank must have sent the score of each of
+     *  its prefixes in the same order.
+     */
+    std::vector<std::unique_ptr<Subset>> getSolutions(
+        std::unique_ptr<SubsetCalculator> calculator, 
+        const std::vector<size_t> &sizes,
+        const DataRowFactory &factory
+    ) {
+        if (sizes.size() != this->prefixScoresPerRank) {
+            throw std::invalid_argument("Every rank must send one prefix score per size of the k sweep.");
+        }
 
-        std::unique_ptr<Subset> bestLocal = this->getBestLocalSolution();
+        std::vector<std::unique_ptr<Subset>> globalResults(
+            this->getGlobalSolutions(std::move(calculator), KSweepSubset::create(NaiveMutableSubset::makeNew(), sizes), sizes.back(), factory)
+        );
 
-        spdlog::info("best local solution had score of {0:f} while the global solution had a score of {1:f}", bestLocal->getScore(), globalResult->getScore());
-        if (globalResult->getScore() > bestLocal->getScore()) {
-            return std::move(globalResult); 
-        } else {
-            return std::move(bestLocal);
+        std::vector<std::unique_ptr<Subset>> solutions;
+        for (size_t i = 0; i < sizes.size(); i++) {
+            solutions.push_back(best(
+                std::move(globalResults[i]), 
+                this->getBestLocalSolution(FLOATS_FOR_LOCAL_MARGINAL_PER_BUFFER + i, sizes[i])
+            ));
         }
+
+        return solutions;
     }
 
     GlobalBufferLoader(
@@ -147,13 +174,23 @@ class GlobalBufferLoader : public BufferLoader {
         const std::vector<int> &displacements,
         Timers &timers,
         const RelevanceCalculatorFactory &calcFactory
+    ) : GlobalBufferLoader(binaryInput, columnsPerRowInBuffer, displacements, timers, calcFactory, 0) {}
+
+    GlobalBufferLoader(
+        const std::vector<float> &binaryInput, 
+        const size_t columnsPerRowInBuffer,
+        const std::vector<int> &displacements,
+        Timers &timers,
+        const RelevanceCalculatorFactory &calcFactory,
+        const size_t prefixScoresPerRank
     ) : 
         timers(timers),
         binaryInput(binaryInput), 
         columnsPerRowInBuffer(columnsPerRowInBuffer + FLOATS_FOR_ROW_INDEX_PER_COLUMN), 
         displacements(displacements),
         worldSize(displacements.size()),
-        calcFactory(calcFactory)
+        calcFactory(calcFactory),
+        prefixScoresPerRank(prefixScoresPerRank)
     {}
 
     private:
@@ -168,7 +205,7 @@ class GlobalBufferLoader : public BufferLoader {
         #pragma omp parallel for 
         for (size_t rank = 0; rank < worldSize; rank++) {
             std::vector<std::pair<size_t, std::unique_ptr<DataRow>>> rankData;
-            const size_t rankStart = displacements[rank] + 1;
+            const size_t rankStart = displacements[rank] + FLOATS_FOR_LOCAL_MARGINAL_PER_BUFFER + prefixScoresPerRank;
             const auto rankStop = (rank + 1) == worldSize ? binaryInput.end() : binaryInput.begin() + displacements[rank + 1];
 
             auto index = binaryInput.begin() + rankStart;
@@ -203,14 +240,18 @@ class GlobalBufferLoader : public BufferLoader {
         return std::unique_ptr<std::vector<std::pair<size_t, std::unique_ptr<DataRow>>>>(newData);
     }
 
-    std::unique_ptr<Subset> getBestLocalSolution() {
+    /**
+     * The local solution with the best score at position scoreOffset of the headers, cut down
+     *  to its first k rows.
+     */
+    std::unique_ptr<Subset> getBestLocalSolution(const size_t scoreOffset, const size_t k) {
         std::vector<size_t> rows;
         float coverage;
         float bestRankScore = -1;
         size_t maxRank = -1;
 
         for (size_t rank = 0; rank < worldSize; rank++) {
-            const size_t scoreIndex = displacements[rank];
+            const size_t scoreIndex = displacements[rank] + scoreOffset;
             const float localRankScore = binaryInput[scoreIndex];
             spdlog::info("rank {0:d} had local solution of score {1:f}", rank, localRankScore);
 
@@ -221,9 +262,9 @@ class GlobalBufferLoader : public BufferLoader {
         }
          
         // extract best local solution
-        const size_t rankStart = displacements[maxRank];
+        const size_t rankStart = displacements[maxRank] + FLOATS_FOR_LOCAL_MARGINAL_PER_BUFFER + prefixScoresPerRank;
         const size_t rankEnd = maxRank == worldSize - 1 ? binaryInput.size() : displacements[maxRank + 1];
-        for (size_t i = rankStart; i < rankEnd; i++) {
+        for (size_t i = rankStart; i < rankEnd && rows.size() < k; i++) {
             if (binaryInput[i] == CommunicationConstants::endOfSendTag()) {
                 rows.push_back(binaryInput[i - 1]);
             }
@@ -231,6 +272,59 @@ class GlobalBufferLoader : public BufferLoader {
 
         return Subset::of(rows, bestRankScore);
     }
+
+    /**
+     * Runs calculator once over every received row and translates what it found back to
+     *  global rows. A k sweep consumer gives one solution per size, anything else just one.
+     */
+    std::vector<std::unique_ptr<Subset>> getGlobalSolutions(
+        std::unique_ptr<SubsetCalculator> calculator, 
+        std::unique_ptr<MutableSubset> consumer,
+        const size_t k,
+        const DataRowFactory &factory
+    ) {
+        this->timers.bufferDecodingTime.startTimer();
+        spdlog::debug("getting best rows");
+        std::unique_ptr<ReceivedData> bestRows(
+            ReceivedData::create(
+                std::move(this->rebuildData(factory))
+            )
+        );
+        this->timers.bufferDecodingTime.stopTimer();
+
+        timers.globalCalculationTime.startTimer();
+
+        spdlog::debug("calculating global solution on received rows of size {0:d}", bestRows->totalRows());
+        std::unique_ptr<RelevanceCalculator> calc(calcFactory.build(*bestRows));
+        std::unique_ptr<Subset> untranslatedSolution(calculator->getApproximationSet(
+            std::move(consumer), *calc, *bestRows, k)
+        );
+
+        std::vector<std::unique_ptr<Subset>> untranslatedSolutions;
+        if (dynamic_cast<const KSweepSubset*>(untranslatedSolution.get()) != nullptr) {
+            untranslatedSolutions = KSweepSubset::from(*untranslatedSolution).getPrefixes();
+        } else {
+            untranslatedSolutions.push_back(std::move(untranslatedSolution));
+        }
+
+        std::vector<std::unique_ptr<Subset>> globalResults;
+        for (auto & solution : untranslatedSolutions) {
+            globalResults.push_back(bestRows->translateSolution(std::move(solution)));
+        }
+
+        timers.globalCalculationTime.stopTimer();
+
+        return globalResults;
+    }
+
+    static std::unique_ptr<Subset> best(std::unique_ptr<Subset> globalResult, std::unique_ptr<Subset> bestLocal) {
+        spdlog::info("best local solution had score of {0:f} while the global solution had a score of {1:f}", bestLocal->getScore(), globalResult->getScore());
+        if (globalResult->getScore() > bestLocal->getScore()) {
+            return std::move(globalResult); 
+        } else {
+            return std::move(bestLocal);
+        }
+    }
 };
 
 #endif
\ No newline at end of file
@@ -133,4 +133,38 @@ TEST_CASE("Getting solution from a buffer") {
         const size_t expectedRow = mockSolutionRows[i];
         CHECK(receivedSolutionRowsSet.find(expectedRow) != receivedSolutionRowsSet.end());
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Getting a solution for every size of a k sweep from a buffer") {
+    std::unique_ptr<BaseData> denseData(getDenseData());
+    const std::vector<size_t> sizes{1, 2};
+
+    std::vector<float> sendBuffer;
+    BufferBuilder::buildSendBuffer(*denseData, *MOCK_SOLUTION.get(), std::vector<float>{10, 15}, sendBuffer);
+    CHECK(sendBuffer[0] == 15);
+    CHECK(sendBuffer[1] == 10);
+    CHECK(sendBuffer[2] == 15);
+    
+    std::vector<int> displacements;
+    displacements.push_back(0);
+
+    Timers timers;
+    NaiveRelevanceCalculatorFactory calc;
+    GlobalBufferLoader bufferLoader(sendBuffer, denseData->totalColumns(), displacements, timers, calc, sizes.size());
+    std::vector<std::unique_ptr<Subset>> receivedSolutions(
+        bufferLoader.getSolutions(
+            std::unique_ptr<SubsetCalculator>(new FastSubsetCalculator(0.0001)), 
+            sizes,
+            DenseDataRowFactory()
+        )
+    );
+
+    REQUIRE(receivedSolutions.size() == sizes.size());
+    std::vector<size_t> mockSolutionRows = getRows(*MOCK_SOLUTION.get());
+    for (size_t i = 0; i < sizes.size(); i++) {
+        CHECK(receivedSolutions[i]->size() == sizes[i]);
+        for (const size_t row : *receivedSolutions[i]) {
+            CHECK(std::find(mockSolutionRows.begin(), mockSolutionRows.end(), row) != mockSolutionRows.end());
+        }
+    }
+}
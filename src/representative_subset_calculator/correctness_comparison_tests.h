@@ -1,3 +1,5 @@
+#include <filesystem>
+
 
 static std::unique_ptr<Subset> testCalculator(
     SubsetCalculator *calculator, 
@@ -52,3 +54,301 @@ TEST_CASE("All supported calculators have the same result") {
 
     checkSolutionsAreEquivalent(*fastRes.get(), *lazyFastRes.get());
 }
+
+TEST_CASE("Dense matrix data has the same result as row data") {
+    std::unique_ptr<FullyLoadedData> rowData(FullyLoadedData::load(DENSE_DATA));
+    std::unique_ptr<DenseMatrixData> matrixData(DenseMatrixData::load(DENSE_DATA));
+    const size_t k = DENSE_DATA.size() - 1;
+    const float epsilon = 0.01;
+    auto rowRes = testCalculator(new FastSubsetCalculator(epsilon), *rowData, k, epsilon);
+    auto matrixRes = testCalculator(new FastSubsetCalculator(epsilon), *matrixData, k, epsilon);
+    auto lazyMatrixRes = testCalculator(new LazyFastSubsetCalculator(epsilon), *matrixData, k, epsilon);
+
+    checkSolutionsAreEquivalent(*rowRes.get(), *matrixRes.get());
+    checkSolutionsAreEquivalent(*rowRes.get(), *lazyMatrixRes.get());
+}
+
+TEST_CASE("Matrix free fast greedy has the same result as fast greedy") {
+    std::unique_ptr<FullyLoadedData> rowData(FullyLoadedData::load(DENSE_DATA));
+    std::unique_ptr<DenseMatrixData> matrixData(DenseMatrixData::load(DENSE_DATA));
+    const size_t k = DENSE_DATA.size() - 1;
+    const float epsilon = 0.01;
+    auto fastRes = testCalculator(new FastSubsetCalculator(epsilon), *matrixData, k, epsilon);
+    auto matrixFreeRes = testCalculator(new MatrixFreeFastSubsetCalculator(epsilon), *matrixData, k, epsilon);
+    auto rowMatrixFreeRes = testCalculator(new MatrixFreeFastSubsetCalculator(epsilon), *rowData, k, epsilon);
+
+    checkSolutionsAreEquivalent(*fastRes.get(), *matrixFreeRes.get());
+    checkSolutionsAreEquivalent(*fastRes.get(), *rowMatrixFreeRes.get());
+}
+
+TEST_CASE("Parallel lazy fast greedy selects the same rows as lazy fast greedy") {
+    const size_t rows = 300;
+    const size_t columns = 60;
+    std::vector<std::vector<float>> raw(randomNormalRows(rows, columns, 29));
+
+    // Duplicate rows tie on every bound until one of them is selected.
+    for (size_t i = 0; i < rows; i += 10) {
+        raw[i + 1] = raw[i];
+    }
+
+    std::unique_ptr<DenseMatrixData> data(DenseMatrixData::load(raw));
+    const size_t k = 40;
+    const float epsilon = 0.01;
+    NaiveRelevanceCalculator calc(*data);
+    LazyFastSubsetCalculator sequential(epsilon);
+    LazyFastSubsetCalculator parallel(epsilon, true);
+    std::unique_ptr<Subset> sequentialRes(sequential.getApproximationSet(NaiveMutableSubset::makeNew(), calc, *data, k));
+
+    // Batches are never larger than the number of threads, so ask for several on any machine.
+    const int threads = omp_get_max_threads();
+    omp_set_num_threads(4);
+    std::unique_ptr<Subset> parallelRes(parallel.getApproximationSet(NaiveMutableSubset::makeNew(), calc, *data, k));
+    omp_set_num_threads(threads);
+
+    REQUIRE(sequentialRes->size() == k);
+    CHECK(std::vector<size_t>(sequentialRes->begin(), sequentialRes->end()) == std::vector<size_t>(parallelRes->begin(), parallelRes->end()));
+    CHECK(sequentialRes->getScore() == parallelRes->getScore());
+}
+
+TEST_CASE("Fast, lazy fast and matrix free greedy select the same rows of a dense matrix") {
+    const size_t rows = 300;
+    const size_t columns = 203;
+    std::vector<std::vector<float>> raw(randomNormalRows(rows, columns, 37));
+
+    // Every other row is the one before it reversed. Each pair ties on every similarity until
+    //  rounding breaks the tie, which only goes the same way if the sums are added the same way.
+    for (size_t i = 0; i < rows; i += 2) {
+        raw[i + 1].assign(raw[i].rbegin(), raw[i].rend());
+    }
+
+    std::unique_ptr<DenseMatrixData> data(DenseMatrixData::load(raw));
+    const size_t k = 40;
+    const float epsilon = 0.01;
+    NaiveRelevanceCalculator calc(*data);
+    FastSubsetCalculator fast(epsilon);
+    LazyFastSubsetCalculator lazy(epsilon);
+    MatrixFreeFastSubsetCalculator matrixFree(epsilon);
+    std::unique_ptr<Subset> fastRes(fast.getApproximationSet(NaiveMutableSubset::makeNew(), calc, *data, k));
+    std::unique_ptr<Subset> lazyRes(lazy.getApproximationSet(NaiveMutableSubset::makeNew(), calc, *data, k));
+    std::unique_ptr<Subset> matrixFreeRes(matrixFree.getApproximationSet(NaiveMutableSubset::makeNew(), calc, *data, k));
+
+    REQUIRE(fastRes->size() == k);
+    CHECK(std::vector<size_t>(fastRes->begin(), fastRes->end()) == std::vector<size_t>(lazyRes->begin(), lazyRes->end()));
+    CHECK(std::vector<size_t>(fastRes->begin(), fastRes->end()) == std::vector<size_t>(matrixFreeRes->begin(), matrixFreeRes->end()));
+}
+
+TEST_CASE("Stochastic greedy samples and selects reproducibly") {
+    CHECK(StochasticSubsetCalculator::getSampleSize(1000, 10, 0.01) == 461);
+    CHECK(StochasticSubsetCalculator::getSampleSize(1000, 10, 1e-300) == 1000);
+    CHECK(StochasticSubsetCalculator::getSampleSize(1000, 0, 0.01) == 0);
+    CHECK(StochasticSubsetCalculator::getExpectedSpeedup(1000, 10, 0.01) == 1000.0 / 461.0);
+    CHECK_THROWS(StochasticSubsetCalculator(0.01, 1, 0));
+
+    std::unique_ptr<FullyLoadedData> data(FullyLoadedData::load(DENSE_DATA));
+    const size_t k = DENSE_DATA.size() - 1;
+    const float epsilon = 0.01;
+    auto first = testCalculator(new StochasticSubsetCalculator(epsilon, 0.5, 7), *data, k, epsilon);
+    auto second = testCalculator(new StochasticSubsetCalculator(epsilon, 0.5, 7), *data, k, epsilon);
+    CHECK(std::vector<size_t>(first->begin(), first->end()) == std::vector<size_t>(second->begin(), second->end()));
+    CHECK(first->getScore() == second->getScore());
+}
+
+TEST_CASE("Stochastic greedy that samples every row selects the same rows as lazy fast greedy") {
+    const size_t rows = 200;
+    const size_t columns = 60;
+    std::vector<std::vector<float>> raw(randomNormalRows(rows, columns, 31));
+
+    std::unique_ptr<DenseMatrixData> data(DenseMatrixData::load(raw));
+    const size_t k = 30;
+    const float epsilon = 0.01;
+    NaiveRelevanceCalculator calc(*data);
+    LazyFastSubsetCalculator lazy(epsilon);
+    StochasticSubsetCalculator stochastic(epsilon, 1e-300, 3);
+    REQUIRE(StochasticSubsetCalculator::getSampleSize(rows, k, 1e-300) == rows);
+
+    std::unique_ptr<Subset> lazyRes(lazy.getApproximationSet(NaiveMutableSubset::makeNew(), calc, *data, k));
+    std::unique_ptr<Subset> stochasticRes(stochastic.getApproximationSet(NaiveMutableSubset::makeNew(), calc, *data, k));
+
+    REQUIRE(lazyRes->size() == k);
+    CHECK(std::vector<size_t>(lazyRes->begin(), lazyRes->end()) == std::vector<size_t>(stochasticRes->begin(), stochasticRes->end()));
+    CHECK(lazyRes->getScore() == stochasticRes->getScore());
+}
+
+TEST_CASE("Stochastic greedy keeps going when a sample falls below epsilon") {
+    // Ten copies of one row and a row orthogonal to them. Once a copy is selected every other 
+    //  copy has no gain left, so a sample of one copy must not end the run.
+    std::vector<std::vector<float>> raw(10, std::vector<float>({1, 0}));
+    raw.push_back(std::vector<float>({0, 1}));
+    std::unique_ptr<DenseMatrixData> data(DenseMatrixData::load(raw));
+    NaiveRelevanceCalculator calc(*data);
+    REQUIRE(StochasticSubsetCalculator::getSampleSize(raw.size(), 2, 0.9) == 1);
+
+    for (unsigned long seed = 0; seed < 20; seed++) {
+        StochasticSubsetCalculator stochastic(0.01, 0.9, seed);
+        std::unique_ptr<Subset> solution(stochastic.getApproximationSet(NaiveMutableSubset::makeNew(), calc, *data, 2));
+        REQUIRE(solution->size() == 2);
+        CHECK(std::find(solution->begin(), solution->end(), raw.size() - 1) != solution->end());
+        CHECK(solution->getScore() == 2);
+    }
+
+    // Every row left is below epsilon, so the run stops short of k.
+    StochasticSubsetCalculator stochastic(0.01, 0.9, 0);
+    CHECK(stochastic.getApproximationSet(NaiveMutableSubset::makeNew(), calc, *data, 5)->size() == 2);
+}
+
+TEST_CASE("A k sweep gives the same solution for every size as a run to that size") {
+    const size_t rows = 200;
+    const size_t columns = 60;
+    std::vector<std::vector<float>> raw(randomNormalRows(rows, columns, 17));
+
+    std::unique_ptr<DenseMatrixData> data(DenseMatrixData::load(raw));
+    const std::vector<size_t> sizes{25, 5, 10, 25, 40};
+    const float epsilon = 0.01;
+    NaiveRelevanceCalculator calc(*data);
+    LazyFastSubsetCalculator lazy(epsilon);
+
+    CHECK_THROWS(KSweepSubset::create(NaiveMutableSubset::makeNew(), std::vector<size_t>{0, 5}));
+    CHECK_THROWS(KSweepSubset::from(*Subset::empty()));
+
+    std::unique_ptr<Subset> sweep(lazy.getApproximationSet(KSweepSubset::create(NaiveMutableSubset::makeNew(), sizes), calc, *data, 40));
+    REQUIRE(KSweepSubset::from(*sweep).getSizes() == std::vector<size_t>{5, 10, 25, 40});
+    std::vector<std::unique_ptr<Subset>> prefixes(KSweepSubset::from(*sweep).getPrefixes());
+    REQUIRE(prefixes.size() == 4);
+    for (size_t i = 0; i < prefixes.size(); i++) {
+        const size_t k = KSweepSubset::from(*sweep).getSizes()[i];
+        std::unique_ptr<Subset> single(lazy.getApproximationSet(NaiveMutableSubset::makeNew(), calc, *data, k));
+        CHECK(std::vector<size_t>(prefixes[i]->begin(), prefixes[i]->end()) == std::vector<size_t>(single->begin(), single->end()));
+        CHECK(prefixes[i]->getScore() == single->getScore());
+    }
+
+    // Stopping short of a size leaves the whole solution as the solution for that size.
+    std::unique_ptr<Subset> shortSweep(lazy.getApproximationSet(KSweepSubset::create(NaiveMutableSubset::makeNew(), std::vector<size_t>{5, 40}), calc, *data, 20));
+    std::vector<std::unique_ptr<Subset>> shortPrefixes(KSweepSubset::from(*shortSweep).getPrefixes());
+    CHECK(shortPrefixes[0]->size() == 5);
+    CHECK(shortPrefixes[1]->size() == 20);
+    CHECK(shortPrefixes[1]->getScore() == shortSweep->getScore());
+}
+
+/**
+ * Stands in for a run that is stopped part of the way through, after its checkpoint interval 
+ *  has saved it at least once.
+ */
+class InterruptedSubset : public NaiveMutableSubset {
+    private:
+    const size_t stopAt;
+
+    public:
+    InterruptedSubset(const size_t stopAt) : stopAt(stopAt) {}
+
+    void addRow(const size_t row, const float marginalGain) {
+        if (this->size() == this->stopAt) {
+            throw std::runtime_error("interrupted");
+        }
+
+        NaiveMutableSubset::addRow(row, marginalGain);
+    }
+};
+
+template <typename GetCalculator>
+static void checkResumesFromCheckpoints(GetCalculator getCalculator, const std::string &name) {
+    const size_t rows = 200;
+    const size_t columns = 60;
+    std::vector<std::vector<float>> raw(randomNormalRows(rows, columns, 23));
+
+    std::unique_ptr<DenseMatrixData> data(DenseMatrixData::load(raw));
+    NaiveRelevanceCalculator calc(*data);
+    const std::string path((std::filesystem::temp_directory_path() / name).string());
+    const auto rowsOf = [](const Subset &solution) {
+        return std::vector<size_t>(solution.begin(), solution.end());
+    };
+
+    GreedyCheckpointer none("", 0, nullptr);
+    std::unique_ptr<Subset> full(getCalculator(none)->getApproximationSet(NaiveMutableSubset::makeNew(), calc, *data, 40));
+    REQUIRE(full->size() == 40);
+
+    // Finish a run to 15, then extend it to 40.
+    GreedyCheckpointer save(path, 0, nullptr);
+    getCalculator(save)->getApproximationSet(NaiveMutableSubset::makeNew(), calc, *data, 15);
+    std::unique_ptr<GreedyCheckpointer> extend(GreedyCheckpointer::create("", 0, path));
+    const uint32_t kind = GreedyCheckpoint::load(path)->header.kind;
+    CHECK(extend->getResume(kind, rows, columns)->seeds.size() == 15);
+    CHECK_THROWS(extend->getResume(kind, rows + 1, columns));
+    CHECK_THROWS(GreedyCheckpointer::create("", 0, path, 1)->getResume(kind, rows, columns));
+    std::unique_ptr<Subset> extended(getCalculator(*extend)->getApproximationSet(NaiveMutableSubset::makeNew(), calc, *data, 40));
+    CHECK(rowsOf(*extended) == rowsOf(*full));
+    CHECK(extended->getScore() == full->getScore());
+
+    // A smaller k is the start of the checkpoint.
+    std::unique_ptr<Subset> shorter(getCalculator(*extend)->getApproximationSet(NaiveMutableSubset::makeNew(), calc, *data, 5));
+    CHECK(rowsOf(*shorter) == std::vector<size_t>(full->begin(), full->begin() + 5));
+
+    // Stop a run to 40 after 23 seeds, with a checkpoint every 10, and resume it.
+    GreedyCheckpointer periodic(path, 10, nullptr);
+    CHECK_THROWS(getCalculator(periodic)->getApproximationSet(std::unique_ptr<MutableSubset>(new InterruptedSubset(23)), calc, *data, 40));
+    std::unique_ptr<GreedyCheckpoint> saved(GreedyCheckpoint::load(path));
+    CHECK(saved->seeds.size() == 20);
+    std::unique_ptr<GreedyCheckpointer> recover(GreedyCheckpointer::create("", 0, path));
+    std::unique_ptr<Subset> recovered(getCalculator(*recover)->getApproximationSet(NaiveMutableSubset::makeNew(), calc, *data, 40));
+    CHECK(rowsOf(*recovered) == rowsOf(*full));
+    CHECK(recovered->getScore() == full->getScore());
+
+    // Checkpoints that no run could have written are rejected instead of resumed from.
+    std::ifstream savedFile(path, std::ios::binary);
+    const std::string bytes((std::istreambuf_iterator<char>(savedFile)), std::istreambuf_iterator<char>());
+    savedFile.close();
+    const size_t seedsAt = sizeof(GreedyCheckpointHeader);
+    const size_t caughtUpAt = seedsAt + saved->seeds.size() * (sizeof(uint64_t) + sizeof(float)) + rows * sizeof(float);
+    const auto setWord = [](std::string &file, const size_t at, const uint64_t value) {
+        std::memcpy(&file[at], &value, sizeof(uint64_t));
+    };
+    const auto rejects = [&path, &bytes](const std::function<void(GreedyCheckpointHeader&, std::string&)> &corrupt) {
+        std::string file(bytes);
+        GreedyCheckpointHeader header;
+        std::memcpy(&header, file.data(), sizeof(GreedyCheckpointHeader));
+        corrupt(header, file);
+        std::memcpy(&file[0], &header, sizeof(GreedyCheckpointHeader));
+        std::ofstream(path, std::ios::binary) << file;
+        CHECK_THROWS_AS(GreedyCheckpoint::load(path), std::invalid_argument);
+    };
+    rejects([](GreedyCheckpointHeader &header, std::string &) { header.kind = 7; });
+    rejects([](GreedyCheckpointHeader &header, std::string &) { header.seeds = header.rows + 1; });
+    rejects([](GreedyCheckpointHeader &header, std::string &) { header.factorValues = UINT64_MAX; });
+    rejects([&](GreedyCheckpointHeader &, std::string &file) { setWord(file, seedsAt, rows); });
+    rejects([&](GreedyCheckpointHeader &, std::string &file) { setWord(file, seedsAt + sizeof(uint64_t), saved->seeds[0]); });
+    if (saved->header.kind == GreedyCheckpoint::LAZY) {
+        rejects([&](GreedyCheckpointHeader &, std::string &file) { setWord(file, caughtUpAt, saved->seeds.size() + 1); });
+    } else {
+        rejects([&](GreedyCheckpointHeader &header, std::string &) { header.factorColumns = header.seeds + 1; });
+    }
+    std::ofstream(path, std::ios::binary) << bytes << "trailing";
+    CHECK_THROWS_AS(GreedyCheckpoint::load(path), std::invalid_argument);
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Fast greedy resumed from a checkpoint selects the same rows as an uninterrupted run") {
+    Timers timers;
+    checkResumesFromCheckpoints([&timers](const GreedyCheckpointer &checkpointer) {
+        return std::unique_ptr<SubsetCalculator>(new FastSubsetCalculator(0.0001, timers, checkpointer));
+    }, "fast_greedy.checkpoint");
+    checkResumesFromCheckpoints([&timers](const GreedyCheckpointer &checkpointer) {
+        return std::unique_ptr<SubsetCalculator>(new MatrixFreeFastSubsetCalculator(0.0001, timers, checkpointer));
+    }, "matrix_free_fast_greedy.checkpoint");
+}
+
+TEST_CASE("Lazy fast greedy resumed from a checkpoint selects the same rows as an uninterrupted run") {
+    checkResumesFromCheckpoints([](const GreedyCheckpointer &checkpointer) {
+        return std::unique_ptr<SubsetCalculator>(new LazyFastSubsetCalculator(0.0001, false, checkpointer));
+    }, "lazy_fast_greedy.checkpoint");
+
+    // A lazy checkpoint cannot resume fast greedy.
+    Timers timers;
+    const std::string path((std::filesystem::temp_directory_path() / "lazy_fast_greedy_kind.checkpoint").string());
+    std::unique_ptr<FullyLoadedData> data(FullyLoadedData::load(DENSE_DATA));
+    NaiveRelevanceCalculator calc(*data);
+    GreedyCheckpointer save(path, 0, nullptr);
+    LazyFastSubsetCalculator(0.0001, false, save).getApproximationSet(NaiveMutableSubset::makeNew(), calc, *data, 3);
+    std::unique_ptr<GreedyCheckpointer> resume(GreedyCheckpointer::create("", 0, path));
+    CHECK_THROWS(FastSubsetCalculator(0.0001, timers, *resume).getApproximationSet(NaiveMutableSubset::makeNew(), calc, *data, 5));
+    std::remove(path.c_str());
+}
@@ -1,12 +1,15 @@
 #include <vector>
 #include <math.h>
-#include <unordered_set>
+#include <limits>
+#include <omp.h>
 
 #include "../data_tools/base_data.h"
 #include "representative_subset_calculator.h"
 #include "kernel_matrix/relevance_calculator.h"
 #include "kernel_matrix/kernel_matrix.h"
 #include "representative_subset.h"
+#include "greedy_checkpoint.h"
+#include "timers/timers.h"
 
 #ifndef FAST_REPRESENTATIVE_SUBSET_CALCULATOR_H
 #define FAST_REPRESENTATIVE_SUBSET_CALCULATOR_H
@@ -15,83 +18,256 @@ class FastSubsetCalculator : public SubsetCalculator {
     private:
     const float epsilon;
 
-    static std::pair<size_t, float> getNextHighestScore(
-        const std::vector<float> &diagonals, 
-        const std::unordered_set<size_t> &seen 
-    ) {
-        size_t bestRow = -1;
-        float highestScore = -1;
-
-        for (size_t i = 0; i < diagonals.size(); i++) {
-            const float score = diagonals[i];
-            if (seen.find(i) == seen.end() && score > highestScore) {
-                highestScore = score;
-                bestRow = i;
+    // Optional, records the size of every kernel matrix this calculator builds.
+    Timers *timers;
+
+    // Optional, resumes runs from a checkpoint and saves their progress.
+    const GreedyCheckpointer *checkpointer;
+
+    // Diagonal of rows that are already selected. Never above the -1 floor of the argmax.
+    static constexpr float SELECTED = -std::numeric_limits<float>::infinity();
+
+    // Rows per block of the factor update, small enough for the dot products of a block to stay in L1.
+    static const size_t UPDATE_BLOCK = 1024;
+
+    /**
+     * The unselected row with the highest diagonal above -1, lowest row first on ties. Every 
+     * thread scans its own range and the ranges are combined in order, so the result is the 
+     * same as a serial scan.
+     */
+    static std::pair<size_t, float> getNextHighestScore(const std::vector<float> &diagonals) {
+        std::vector<std::pair<size_t, float>> best;
+
+        #pragma omp parallel
+        {
+            #pragma omp single
+            best.assign(omp_get_num_threads(), std::make_pair((size_t)-1, -1.0f));
+
+            std::pair<size_t, float> &local(best[omp_get_thread_num()]);
+
+            #pragma omp for schedule(static)
+            for (size_t i = 0; i < diagonals.size(); i++) {
+                if (diagonals[i] > local.second) {
+                    local = std::make_pair(i, diagonals[i]);
+                }
+            }
+        }
+
+        std::pair<size_t, float> result(-1, -1);
+        for (const auto & candidate : best) {
+            if (candidate.second > result.second) {
+                result = candidate;
             }
         }
 
-        if (highestScore < 0) {
+        if (result.second < 0) {
             spdlog::error("failed to find next highest score");
         }
         
-        return std::make_pair(bestRow, highestScore);
+        return result;
+    }
+
+    /**
+     * Only the filled columns are saved. Columns are rows long whatever k is, so they are a 
+     *  prefix of the factor of a run to any k.
+     */
+    void save(
+        const BaseData &data,
+        const std::vector<size_t> &seeds,
+        const std::vector<float> &gains,
+        const std::vector<float> &diagonals,
+        const std::vector<float> &factor,
+        const size_t filledColumns
+    ) const {
+        const size_t n = data.totalRows();
+        this->checkpointer->save(
+            GreedyCheckpoint::buildHeader(GreedyCheckpoint::FAST, n, data.totalColumns(), seeds.size(), filledColumns, n * filledColumns),
+            seeds, 
+            gains, 
+            diagonals, 
+            std::vector<uint64_t>(),
+            [&factor, n, filledColumns](std::ostream &output) {
+                output.write(reinterpret_cast<const char*>(factor.data()), n * filledColumns * sizeof(float));
+            }
+        );
+    }
+
+    protected:
+    /**
+     * Only row j of the kernel matrix is read after j is selected, plus the diagonal.
+     */
+    virtual std::unique_ptr<KernelMatrix> buildKernelMatrix(const BaseData &data, RelevanceCalculator& calc) const {
+        return NaiveKernelMatrix::from(data, calc);
     }
 
   public:
-    FastSubsetCalculator(const float epsilon) : epsilon(epsilon) {
+    FastSubsetCalculator(const float epsilon) : epsilon(epsilon), timers(nullptr), checkpointer(nullptr) {
         if (this->epsilon < 0) {
             throw std::invalid_argument("Epsilon is less than 0.");
         }
     }
 
+    FastSubsetCalculator(const float epsilon, Timers &timers) : FastSubsetCalculator(epsilon) {
+        this->timers = &timers;
+    }
+
+    FastSubsetCalculator(const float epsilon, Timers &timers, const GreedyCheckpointer &checkpointer) : FastSubsetCalculator(epsilon, timers) {
+        this->checkpointer = &checkpointer;
+    }
+
+    /**
+     * c_i, the incremental Cholesky factor of row i, is kept in one preallocated n x k buffer 
+     * in column-major order. Column t holds the entries added for every row when the t-th seed 
+     * was selected, so c_j * c_i for all rows i is a matrix-vector product that streams down 
+     * contiguous columns.
+     *
+     * A run resumed from a checkpoint starts from its seeds, diagonals and filled columns, and 
+     * a checkpoint that already has k seeds answers with its first k seeds right away.
+     */
     std::unique_ptr<Subset> getApproximationSet(
         std::unique_ptr<MutableSubset> consumer, 
         RelevanceCalculator& calc,
         const BaseData &data, 
         size_t k
     ) {
-        std::unordered_set<size_t> seen;
+        const size_t n = data.totalRows();
+        const GreedyCheckpoint *resume = this->checkpointer == nullptr ? nullptr : 
+            this->checkpointer->getResume(GreedyCheckpoint::FAST, n, data.totalColumns());
+        if (resume != nullptr && resume->seeds.size() >= k) {
+            for (size_t t = 0; t < k; t++) {
+                consumer->addRow(resume->seeds[t], resume->gains[t]);
+            }
+
+            return MutableSubset::upcast(std::move(consumer));
+        }
 
-        std::unique_ptr<NaiveKernelMatrix> kernelMatrix(NaiveKernelMatrix::from(data, calc));
-        spdlog::debug("created fast kernel matrix");
+        std::unique_ptr<KernelMatrix> kernelMatrix(this->buildKernelMatrix(data, calc));
+        spdlog::debug("created fast kernel matrix of {0:d} bytes", kernelMatrix->getStorageBytes());
+        if (this->timers != nullptr) {
+            this->timers->recordKernelMatrixBytes(kernelMatrix->getStorageBytes());
+        }
 
         std::vector<float> diagonals = kernelMatrix->getDiagonals(); 
-        std::vector<std::vector<float>> c(data.totalRows(), std::vector<float>());
-
-        auto bestScore = getNextHighestScore(diagonals, seen);
-        SPDLOG_TRACE("first seed is {0:d} of score {1:f}", bestScore.first, bestScore.second);
-        size_t j = bestScore.first;
-        seen.insert(j);
-        consumer->addRow(j, bestScore.second);
-
-        while (consumer->size() < k) {
-            #pragma omp parallel for 
-            for (size_t i = 0; i < data.totalRows(); i++) {
-                if (seen.find(i) != seen.end()) {
-                    continue;
+        std::vector<float> kernelRow(n);
+
+        // Every selection after the first adds one column.
+        const size_t columns = std::min(k, n) == 0 ? 0 : std::min(k, n) - 1;
+        std::vector<float> factor(n * columns, 0);
+        size_t filledColumns = 0;
+
+        // The seeds so far and the gains they were selected with, for checkpoints.
+        std::vector<size_t> seeds;
+        std::vector<float> gains;
+
+        std::pair<size_t, float> bestScore;
+        size_t j;
+        if (resume != nullptr && resume->seeds.size() > 0) {
+            seeds = resume->seeds;
+            gains = resume->gains;
+            diagonals = resume->diagonals;
+            filledColumns = resume->header.factorColumns;
+            if (filledColumns > columns) {
+                throw std::invalid_argument("The checkpoint has more factor columns than a run to k can hold.");
+            }
+            std::copy(resume->factor.begin(), resume->factor.end(), factor.begin());
+            for (size_t t = 0; t < seeds.size(); t++) {
+                consumer->addRow(seeds[t], gains[t]);
+            }
+
+            spdlog::info("resumed fast greedy from a checkpoint of {0:d} seeds", seeds.size());
+            j = seeds.back();
+            bestScore = std::make_pair(j, gains.back());
+        } else {
+            bestScore = getNextHighestScore(diagonals);
+            SPDLOG_TRACE("first seed is {0:d} of score {1:f}", bestScore.first, bestScore.second);
+            if (bestScore.first >= n) {
+                return MutableSubset::upcast(std::move(consumer));
+            }
+
+            j = bestScore.first;
+            diagonals[j] = SELECTED;
+            consumer->addRow(j, bestScore.second);
+            seeds.push_back(j);
+            gains.push_back(bestScore.second);
+        }
+
+        while (consumer->size() < k && filledColumns < columns) {
+            // Every seed but the latest has its column. A run that stopped on epsilon also 
+            //  filled the column of the latest seed before it stopped.
+            if (filledColumns < seeds.size()) {
+                kernelMatrix->copyRow(j, kernelRow.data());
+                const float *filled = factor.data();
+                float *column = factor.data() + filledColumns * n;
+                const float norm = std::sqrt(bestScore.second);
+
+                #pragma omp parallel for schedule(static)
+                for (size_t block = 0; block < n; block += UPDATE_BLOCK) {
+                    const size_t end = std::min(n, block + UPDATE_BLOCK);
+                    float dotProducts[UPDATE_BLOCK] = {};
+                    for (size_t t = 0; t < filledColumns; t++) {
+                        const float c_jt = filled[t * n + j];
+                        const float *c_t = filled + t * n;
+
+                        #pragma omp simd
+                        for (size_t i = block; i < end; i++) {
+                            dotProducts[i - block] += c_jt * c_t[i];
+                        }
+                    }
+
+                    for (size_t i = block; i < end; i++) {
+                        if (diagonals[i] == SELECTED) {
+                            continue;
+                        }
+
+                        const float e = (kernelRow[i] - dotProducts[i - block]) / norm;
+                        column[i] = e;
+                        diagonals[i] -= std::pow(e, 2);
+                    }
                 }
-                
-                const float dot_product = KernelMatrix::getDotProduct(c[j], c[i]);
-                const float e = (kernelMatrix->get(j, i) - dot_product) / std::sqrt(diagonals[j]);
-                c[i].push_back(e);
-                diagonals[i] -= std::pow(e, 2);
+                filledColumns++;
             }
 
-            bestScore = getNextHighestScore(diagonals, seen);
+            bestScore = getNextHighestScore(diagonals);
             SPDLOG_TRACE("next best score of {0:f} with seed {1:d}", bestScore.second, bestScore.first);
 
             if (bestScore.second <= this->epsilon) {
                 spdlog::warn("score of {0:f} was less than {1:f}", bestScore.second, this->epsilon);
-                return MutableSubset::upcast(std::move(consumer));
+                break;
             }
 
             j = bestScore.first;
-            seen.insert(j);
+            diagonals[j] = SELECTED;
             consumer->addRow(j, bestScore.second);
+            seeds.push_back(j);
+            gains.push_back(bestScore.second);
+
+            if (this->checkpointer != nullptr && this->checkpointer->isDue(seeds.size())) {
+                this->save(data, seeds, gains, diagonals, factor, filledColumns);
+            }
+        }
+
+        if (this->checkpointer != nullptr && this->checkpointer->isSaving()) {
+            this->save(data, seeds, gains, diagonals, factor, filledColumns);
         }
     
         return MutableSubset::upcast(std::move(consumer));
     }
 };
 
+/**
+ * Fast greedy without the n x n kernel matrix. The kernel row of every selected seed is 
+ * computed from the dataset when it is needed, so memory is O(n * k) for the factor 
+ * instead of O(n^2), at the cost of one pass over the dataset per seed. Selects the same 
+ * seeds as FastSubsetCalculator.
+ */
+class MatrixFreeFastSubsetCalculator : public FastSubsetCalculator {
+    protected:
+    std::unique_ptr<KernelMatrix> buildKernelMatrix(const BaseData &data, RelevanceCalculator& calc) const {
+        return MatrixFreeKernelMatrix::from(data, calc);
+    }
+
+    public:
+    using FastSubsetCalculator::FastSubsetCalculator;
+};
+
 #endif
\ No newline at end of file
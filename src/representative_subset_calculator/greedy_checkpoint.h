@@ -0,0 +1,296 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "spdlog/spdlog.h"
+
+#ifndef GREEDY_CHECKPOINT_H
+#define GREEDY_CHECKPOINT_H
+
+/**
+ * Header of a greedy checkpoint. Every integer is stored in native (little endian) byte order.
+ *
+ *  [header][seeds, uint64][gains, float][diagonals, rows float][lazy only: caught up, rows uint64][factor, float]
+ *
+ * Seeds are in the order they were selected, and gains[t] is the marginal gain seeds[t] was
+ * selected with. For fast greedy the factor is the first factorColumns columns of the column
+ * major factor, rows floats each. For lazy fast greedy row i has caught up with the first
+ * caughtUp[i] seeds, and the factor holds the first caughtUp[i] entries of c_i for every row
+ * in order, so rows that were never refreshed take no space. The fingerprint identifies the
+ * dataset and settings the run used, see GreedyCheckpoint::fingerprint.
+ */
+struct GreedyCheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t kind;
+    uint64_t rows;
+    uint64_t columns;
+    uint64_t seeds;
+    uint64_t factorColumns;
+    uint64_t factorValues;
+    uint64_t fingerprint;
+};
+
+/**
+ * The state of a fast or lazy fast greedy run after some number of seeds. A run resumed from
+ * it selects the same seeds as a run that was never stopped, so a larger k only pays for the
+ * seeds it adds.
+ */
+class GreedyCheckpoint {
+    public:
+    static constexpr const char* MAGIC = "RASTCKP";
+    static constexpr uint32_t VERSION = 2;
+    static constexpr uint32_t FAST = 0;
+    static constexpr uint32_t LAZY = 1;
+
+    GreedyCheckpointHeader header;
+    std::vector<size_t> seeds;
+    std::vector<float> gains;
+    std::vector<float> diagonals;
+    std::vector<uint64_t> caughtUp;
+    std::vector<float> factor;
+
+    static GreedyCheckpointHeader buildHeader(
+        const uint32_t kind,
+        const size_t rows,
+        const size_t columns,
+        const size_t seeds,
+        const size_t factorColumns,
+        const size_t factorValues
+    ) {
+        GreedyCheckpointHeader header;
+        std::memset(&header, 0, sizeof(GreedyCheckpointHeader));
+        std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+        header.version = VERSION;
+        header.kind = kind;
+        header.rows = rows;
+        header.columns = columns;
+        header.seeds = seeds;
+        header.factorColumns = factorColumns;
+        header.factorValues = factorValues;
+        return header;
+    }
+
+    /**
+     * 64 bit FNV-1a hash of a description of everything the kernel of a run depends on.
+     */
+    static uint64_t fingerprint(const std::string &description) {
+        uint64_t hash = 14695981039346656037ULL;
+        for (const char c : description) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ULL;
+        }
+
+        return hash;
+    }
+
+    /**
+     * Throws when the file is not a checkpoint or does not describe a state a run could have 
+     *  reached, so a corrupt checkpoint is never resumed from. Gains are read for every seed, 
+     *  so the two always have the same length.
+     */
+    static std::unique_ptr<GreedyCheckpoint> load(const std::string &path) {
+        std::ifstream input(path, std::ios::binary);
+        if (!input) {
+            throw std::invalid_argument("ERROR: could not open checkpoint " + path);
+        }
+
+        std::unique_ptr<GreedyCheckpoint> checkpoint(new GreedyCheckpoint());
+        GreedyCheckpointHeader &header(checkpoint->header);
+        if (!input.read(reinterpret_cast<char*>(&header), sizeof(GreedyCheckpointHeader))
+            || std::memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0) {
+            throw std::invalid_argument("ERROR: " + path + " is not a greedy checkpoint");
+        }
+
+        if (header.version != VERSION) {
+            throw std::invalid_argument("ERROR: checkpoint " + path + " was written by an unsupported version");
+        }
+
+        if (header.kind != FAST && header.kind != LAZY) {
+            throw std::invalid_argument("ERROR: checkpoint " + path + " was written by an unknown greedy calculator");
+        }
+
+        // Sizes are checked against the file before anything is allocated for them.
+        input.seekg(0, std::ios::end);
+        const uint64_t fileBytes = input.tellg();
+        input.seekg(sizeof(GreedyCheckpointHeader));
+        if (header.rows > fileBytes || header.seeds > header.rows || header.factorValues > fileBytes
+            || (header.kind == FAST && header.factorColumns > header.seeds)) {
+            spdlog::error("checkpoint has {0:d} seeds and {1:d} factor values for {2:d} rows", header.seeds, header.factorValues, header.rows);
+            throw std::invalid_argument("ERROR: the header of checkpoint " + path + " is corrupt");
+        }
+
+        std::vector<uint64_t> seeds(header.seeds);
+        checkpoint->gains.resize(header.seeds);
+        checkpoint->diagonals.resize(header.rows);
+        checkpoint->caughtUp.resize(header.kind == LAZY ? header.rows : 0);
+        checkpoint->factor.resize(header.factorValues);
+        input.read(reinterpret_cast<char*>(seeds.data()), seeds.size() * sizeof(uint64_t));
+        input.read(reinterpret_cast<char*>(checkpoint->gains.data()), checkpoint->gains.size() * sizeof(float));
+        input.read(reinterpret_cast<char*>(checkpoint->diagonals.data()), checkpoint->diagonals.size() * sizeof(float));
+        input.read(reinterpret_cast<char*>(checkpoint->caughtUp.data()), checkpoint->caughtUp.size() * sizeof(uint64_t));
+        input.read(reinterpret_cast<char*>(checkpoint->factor.data()), checkpoint->factor.size() * sizeof(float));
+        if (!input) {
+            throw std::invalid_argument("ERROR: checkpoint " + path + " is truncated");
+        }
+
+        std::vector<bool> selected(header.rows, false);
+        for (const uint64_t seed : seeds) {
+            if (seed >= header.rows || selected[seed]) {
+                spdlog::error("checkpoint selects row {0:d} of {1:d} more than once or out of range", seed, header.rows);
+                throw std::invalid_argument("ERROR: the seeds of checkpoint " + path + " are corrupt");
+            }
+            selected[seed] = true;
+        }
+
+        uint64_t expectedFactorValues = header.rows * header.factorColumns;
+        if (header.kind == LAZY) {
+            expectedFactorValues = 0;
+            for (const uint64_t caughtUp : checkpoint->caughtUp) {
+                if (caughtUp > header.seeds) {
+                    throw std::invalid_argument("ERROR: checkpoint " + path + " has a row caught up past its seeds");
+                }
+                expectedFactorValues += caughtUp;
+            }
+        }
+        if (header.factorValues != expectedFactorValues || input.peek() != std::ifstream::traits_type::eof()) {
+            throw std::invalid_argument("ERROR: the factor of checkpoint " + path + " does not match its header");
+        }
+
+        checkpoint->seeds.assign(seeds.begin(), seeds.end());
+        return checkpoint;
+    }
+
+    /**
+     * Writes everything but the factor, which writeFactor streams straight from the state of the
+     *  run. The checkpoint is written to a temporary file first and renamed into place, so an
+     *  interrupted write never replaces the last good checkpoint.
+     */
+    template <typename WriteFactor>
+    static void write(
+        const std::string &path,
+        const GreedyCheckpointHeader &header,
+        const std::vector<size_t> &seeds,
+        const std::vector<float> &gains,
+        const std::vector<float> &diagonals,
+        const std::vector<uint64_t> &caughtUp,
+        WriteFactor writeFactor
+    ) {
+        const std::vector<uint64_t> storedSeeds(seeds.begin(), seeds.end());
+        const std::string temporary(path + "." + std::to_string(getpid()));
+        std::ofstream output(temporary, std::ios::binary);
+        output.write(reinterpret_cast<const char*>(&header), sizeof(GreedyCheckpointHeader));
+        output.write(reinterpret_cast<const char*>(storedSeeds.data()), storedSeeds.size() * sizeof(uint64_t));
+        output.write(reinterpret_cast<const char*>(gains.data()), gains.size() * sizeof(float));
+        output.write(reinterpret_cast<const char*>(diagonals.data()), diagonals.size() * sizeof(float));
+        output.write(reinterpret_cast<const char*>(caughtUp.data()), caughtUp.size() * sizeof(uint64_t));
+        writeFactor(output);
+        output.close();
+
+        if (!output || std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            throw std::invalid_argument("ERROR: could not write checkpoint " + path);
+        }
+    }
+
+    private:
+    GreedyCheckpoint() {}
+};
+
+/**
+ * Where a greedy run resumes from and where it saves its progress. A run saves after every
+ * interval seeds when interval is above 0, and always once it is done.
+ */
+class GreedyCheckpointer {
+    private:
+    const std::string output;
+    const size_t interval;
+    std::unique_ptr<GreedyCheckpoint> resume;
+
+    // Stamped on every checkpoint this saves, and required of the checkpoint it resumes from.
+    const uint64_t fingerprint;
+
+    // Disable pass by value. The checkpoint to resume from holds a whole factor.
+    GreedyCheckpointer(const GreedyCheckpointer &);
+
+    public:
+    GreedyCheckpointer(
+        const std::string &output, 
+        const size_t interval, 
+        std::unique_ptr<GreedyCheckpoint> resume, 
+        const uint64_t fingerprint = 0
+    ) : output(output), interval(interval), resume(std::move(resume)), fingerprint(fingerprint) {}
+
+    /**
+     * Empty paths turn off saving or resuming.
+     */
+    static std::unique_ptr<GreedyCheckpointer> create(
+        const std::string &output, 
+        const size_t interval, 
+        const std::string &resume, 
+        const uint64_t fingerprint = 0
+    ) {
+        return std::make_unique<GreedyCheckpointer>(
+            output,
+            interval,
+            resume.empty() ? nullptr : GreedyCheckpoint::load(resume),
+            fingerprint
+        );
+    }
+
+    /**
+     * The checkpoint to resume from, or null to start from scratch. Throws when the checkpoint
+     *  was written by another calculator, for a dataset of another shape, or with another 
+     *  fingerprint.
+     */
+    const GreedyCheckpoint* getResume(const uint32_t kind, const size_t rows, const size_t columns) const {
+        if (this->resume == nullptr) {
+            return nullptr;
+        }
+
+        const GreedyCheckpointHeader &header(this->resume->header);
+        if (header.kind != kind) {
+            throw std::invalid_argument("The checkpoint was written by a different greedy calculator.");
+        }
+        if (header.rows != rows || header.columns != columns) {
+            spdlog::error("checkpoint has {0:d} rows and {1:d} columns but the dataset has {2:d} rows and {3:d} columns", header.rows, header.columns, rows, columns);
+            throw std::invalid_argument("The checkpoint was written for a different dataset.");
+        }
+        if (header.fingerprint != this->fingerprint) {
+            throw std::invalid_argument("The checkpoint was written for a different dataset or with different settings.");
+        }
+
+        return this->resume.get();
+    }
+
+    bool isSaving() const {
+        return !this->output.empty();
+    }
+
+    bool isDue(const size_t seeds) const {
+        return this->isSaving() && this->interval > 0 && seeds % this->interval == 0;
+    }
+
+    template <typename WriteFactor>
+    void save(
+        const GreedyCheckpointHeader &header,
+        const std::vector<size_t> &seeds,
+        const std::vector<float> &gains,
+        const std::vector<float> &diagonals,
+        const std::vector<uint64_t> &caughtUp,
+        WriteFactor writeFactor
+    ) const {
+        spdlog::debug("saving checkpoint of {0:d} seeds to {1}", seeds.size(), this->output);
+        GreedyCheckpointHeader stamped(header);
+        stamped.fingerprint = this->fingerprint;
+        GreedyCheckpoint::write(this->output, stamped, seeds, gains, diagonals, caughtUp, writeFactor);
+    }
+};
+
+#endif
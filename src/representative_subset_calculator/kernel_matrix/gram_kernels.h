@@ -0,0 +1,340 @@
+#include <vector>
+#include <algorithm>
+
+#include "packed_symmetric_matrix.h"
+#include "../../data_tools/base_data.h"
+#include "../../data_tools/row_kernels.h"
+#include "../../data_tools/inverted_column_index.h"
+
+#ifndef GRAM_KERNELS_H
+#define GRAM_KERNELS_H
+
+/**
+ * Kernels for the plain similarities S = X * X^T straight from the raw storage of a dataset.
+ * Every entry adds its products in column order, so whole matrices, single rows and single 
+ * entries built here agree with each other bit for bit. NaiveRelevanceCalculator uses the same 
+ * kernels, so every algorithm scores a pair of rows the same way.
+ */
+class GramKernels {
+    public:
+    // Rows per tile and columns per chunk used when multiplying a dense matrix with itself.
+    //  One transposed panel plus the accumulators of a tile pair fit in L1/L2.
+    static const size_t ROW_TILE = 64;
+    static const size_t COLUMN_CHUNK = 128;
+
+    // Entries of a tile pair updated together, small enough for the sums to stay in registers.
+    static const size_t MICRO_ROWS = 8;
+    static const size_t MICRO_COLUMNS = 8;
+
+    using SparseRow = SparseRowRef;
+
+    /**
+     * Collects raw pointers to the rows of a dataset so that the Gram kernels can skip the 
+     * visitor for every pair. Rows stored as maps have no raw storage and mark the dataset as 
+     * unsupported, as do datasets mixing dense and sparse rows or dense rows of different lengths.
+     */
+    class RowGatherer : public DataRowVisitor {
+        public:
+        std::vector<const float*> dense;
+        std::vector<SparseRow> sparse;
+        size_t columns;
+        bool supported;
+
+        RowGatherer() : columns(0), supported(true) {}
+
+        static RowGatherer gather(const BaseData &data) {
+            RowGatherer gatherer;
+            for (size_t i = 0; i < data.totalRows() && gatherer.supported; i++) {
+                data.getRow(i).voidVisit(gatherer);
+            }
+
+            if (!gatherer.dense.empty() && !gatherer.sparse.empty()) {
+                gatherer.supported = false;
+            }
+
+            return gatherer;
+        }
+
+        void visitDenseDataRow(const std::vector<float>& data) {
+            this->visitDenseDataRowView(data.data(), data.size());
+        }
+
+        void visitDenseDataRowView(const float* data, const size_t totalColumns) {
+            if (!this->dense.empty() && totalColumns != this->columns) {
+                this->supported = false;
+            }
+
+            this->columns = totalColumns;
+            this->dense.push_back(data);
+        }
+
+        void visitSparseDataRow(const std::map<size_t, float>& _data, size_t _totalColumns) {
+            this->supported = false;
+        }
+
+        void visitSparseDataRowView(const unsigned int* columns, const float* values, const size_t nonZeros, const size_t totalColumns) {
+            // Adjacency list ids may run up to and including the column count, and anything 
+            //  scattered by column must still have room for the last one.
+            this->columns = std::max(this->columns, totalColumns);
+            if (nonZeros > 0) {
+                this->columns = std::max<size_t>(this->columns, columns[nonZeros - 1] + 1);
+            }
+            this->sparse.push_back(SparseRow{columns, values, nonZeros});
+        }
+    };
+
+    /**
+     * Builds S = X * X^T for dense rows of equal length by walking the upper triangle one pair 
+     * of row tiles at a time. A chunk of the second tile is transposed into a panel and the tile 
+     * pair is computed MICRO_ROWS x MICRO_COLUMNS entries at a time with the sums held in 
+     * registers. Each entry still adds its products in column order, so every entry is 
+     * bit-identical to denseEntry. Tile pairs are handed out dynamically, with 
+     * the pairs that touch the partial last tile moved to the end since they are cheaper.
+     */
+    static PackedSymmetricMatrix blockedGram(const std::vector<const float*> &rows, const size_t columns) {
+        const size_t n = rows.size();
+        const size_t tiles = (n + ROW_TILE - 1) / ROW_TILE;
+
+        std::vector<std::pair<size_t, size_t>> tilePairs;
+        for (size_t iTile = 0; iTile < tiles; iTile++) {
+            for (size_t jTile = iTile; jTile < tiles; jTile++) {
+                tilePairs.push_back({iTile, jTile});
+            }
+        }
+
+        // Diagonal tiles only need half of their entries, but the full tile is computed.
+        //  Only the partial last tile is cheaper than the rest.
+        std::stable_sort(tilePairs.begin(), tilePairs.end(), [tiles](const auto &a, const auto &b) {
+            return (a.second == tiles - 1) < (b.second == tiles - 1);
+        });
+
+        PackedSymmetricMatrix result(n);
+        const std::vector<float> zeros(COLUMN_CHUNK, 0);
+
+        #pragma omp parallel
+        {
+            std::vector<float> panel(COLUMN_CHUNK * ROW_TILE);
+            std::vector<float> accumulators(ROW_TILE * ROW_TILE);
+
+            #pragma omp for schedule(dynamic)
+            for (size_t pair = 0; pair < tilePairs.size(); pair++) {
+                const size_t iStart = tilePairs[pair].first * ROW_TILE;
+                const size_t jStart = tilePairs[pair].second * ROW_TILE;
+                const size_t iRows = std::min(n, iStart + ROW_TILE) - iStart;
+                const size_t jRows = std::min(n, jStart + ROW_TILE) - jStart;
+                const size_t jLanes = (jRows + MICRO_COLUMNS - 1) / MICRO_COLUMNS * MICRO_COLUMNS;
+                std::fill(accumulators.begin(), accumulators.end(), 0);
+
+                for (size_t chunk = 0; chunk < columns; chunk += COLUMN_CHUNK) {
+                    const size_t chunkColumns = std::min(columns, chunk + COLUMN_CHUNK) - chunk;
+
+                    std::fill(panel.begin(), panel.end(), 0);
+                    for (size_t jj = 0; jj < jRows; jj++) {
+                        const float *b = rows[jStart + jj] + chunk;
+                        for (size_t c = 0; c < chunkColumns; c++) {
+                            panel[c * ROW_TILE + jj] = b[c];
+                        }
+                    }
+
+                    for (size_t ii = 0; ii < iRows; ii += MICRO_ROWS) {
+                        // Rows past the end of the tile read zeros and their sums are never stored.
+                        const float *a[MICRO_ROWS];
+                        for (size_t r = 0; r < MICRO_ROWS; r++) {
+                            a[r] = ii + r < iRows ? rows[iStart + ii + r] + chunk : zeros.data();
+                        }
+
+                        for (size_t jj = 0; jj < jLanes; jj += MICRO_COLUMNS) {
+                            microKernel(a, panel.data() + jj, chunkColumns, accumulators.data() + ii * ROW_TILE + jj);
+                        }
+                    }
+                }
+
+                // Each tile pair owns its entries, so storing here does not race with other tiles.
+                for (size_t ii = 0; ii < iRows; ii++) {
+                    const size_t i = iStart + ii;
+                    for (size_t jj = 0; jj < jRows; jj++) {
+                        const size_t j = jStart + jj;
+                        if (j >= i) {
+                            result.set(j, i, accumulators[ii * ROW_TILE + jj]);
+                        }
+                    }
+                }
+            }
+        }
+
+        return result;
+    }
+
+    /**
+     * Builds S = X * X^T for sparse rows as a sparse times sparse transpose product. Row i 
+     * walks its own non zeros in column order and scatters into every later row that shares 
+     * the column, so only pairs of rows with a common column cost anything. Products are added 
+     * in column order, so every entry is bit-identical to the merge in 
+     * SparseViewDotProductDataRowVisitor.
+     */
+    static PackedSymmetricMatrix sparseGram(const std::vector<SparseRow> &rows, const size_t columns) {
+        const size_t n = rows.size();
+        const std::unique_ptr<InvertedColumnIndex> index(InvertedColumnIndex::fromRows(rows, columns));
+        PackedSymmetricMatrix result(n);
+
+        #pragma omp parallel
+        {
+            std::vector<float> sums(n, 0);
+            std::vector<unsigned int> touched;
+
+            // The last row i that touched each row, so a row is only listed once per i even 
+            //  when its sum passes back through zero.
+            std::vector<size_t> touchedBy(n, (size_t)-1);
+
+            // Rows differ wildly in cost, so they are handed out in small batches.
+            #pragma omp for schedule(dynamic, 16)
+            for (size_t i = 0; i < n; i++) {
+                const SparseRow &row(rows[i]);
+                for (size_t k = 0; k < row.nonZeros; k++) {
+                    const unsigned int column = row.columns[k];
+                    const unsigned int* columnRows = index->getPostings(column);
+                    const unsigned int* columnEnd = columnRows + index->getPostingCount(column);
+                    const float* columnValues = index->getValues(column);
+                    const unsigned int* start = std::lower_bound(columnRows, columnEnd, i);
+                    for (const unsigned int* j = start; j != columnEnd; j++) {
+                        if (touchedBy[*j] != i) {
+                            touchedBy[*j] = i;
+                            touched.push_back(*j);
+                        }
+                        sums[*j] += columnValues[j - columnRows] * row.values[k];
+                    }
+                }
+
+                for (const unsigned int j : touched) {
+                    result.set(j, i, sums[j]);
+                    sums[j] = 0;
+                }
+                touched.clear();
+            }
+        }
+
+        return result;
+    }
+
+    /**
+     * Writes row j of X * X^T for dense rows into output, the same values blockedGram builds. 
+     * Rows are transposed one tile and chunk at a time so the innermost loop runs across 
+     * ROW_TILE rows, while each entry still adds its products in column order.
+     */
+    static void denseRow(const std::vector<const float*> &rows, const size_t columns, const size_t j, float* output) {
+        const size_t n = rows.size();
+        const size_t tiles = (n + ROW_TILE - 1) / ROW_TILE;
+        const float *x = rows[j];
+
+        #pragma omp parallel
+        {
+            std::vector<float> panel(COLUMN_CHUNK * ROW_TILE);
+            float sums[ROW_TILE];
+
+            #pragma omp for schedule(static)
+            for (size_t tile = 0; tile < tiles; tile++) {
+                const size_t start = tile * ROW_TILE;
+                const size_t tileRows = std::min(n, start + ROW_TILE) - start;
+                std::fill(sums, sums + ROW_TILE, 0);
+
+                for (size_t chunk = 0; chunk < columns; chunk += COLUMN_CHUNK) {
+                    const size_t chunkColumns = std::min(columns, chunk + COLUMN_CHUNK) - chunk;
+
+                    std::fill(panel.begin(), panel.end(), 0);
+                    for (size_t ii = 0; ii < tileRows; ii++) {
+                        const float *b = rows[start + ii] + chunk;
+                        for (size_t c = 0; c < chunkColumns; c++) {
+                            panel[c * ROW_TILE + ii] = b[c];
+                        }
+                    }
+
+                    for (size_t c = 0; c < chunkColumns; c++) {
+                        const float value = x[chunk + c];
+                        const float *column = panel.data() + c * ROW_TILE;
+
+                        #pragma omp simd
+                        for (size_t ii = 0; ii < ROW_TILE; ii++) {
+                            sums[ii] += value * column[ii];
+                        }
+                    }
+                }
+
+                std::copy(sums, sums + tileRows, output + start);
+            }
+        }
+    }
+
+    /**
+     * Writes the similarities of row with every row of index into output, which must hold
+     * index.totalRows() floats. For a row of the dataset these are the values sparseGram builds.
+     * Costs one pass over the posting lists of the columns row has values in. Threads split the
+     * output rows, and each finds its own part of every posting list with a binary search.
+     */
+    static void sparseRow(const SparseRow &row, const InvertedColumnIndex &index, float* output) {
+        const size_t n = index.totalRows();
+        std::fill(output, output + n, 0);
+
+        #pragma omp parallel
+        {
+            const size_t threads = omp_get_num_threads();
+            const size_t thread = omp_get_thread_num();
+            index.accumulate(row, output, n * thread / threads, n * (thread + 1) / threads);
+        }
+    }
+
+    /**
+     * Single entries, equal to the matching entries of the kernels above.
+     */
+    static float denseEntry(const float* a, const float* b, const size_t columns) {
+        float result = 0;
+        for (size_t c = 0; c < columns; c++) {
+            result += a[c] * b[c];
+        }
+
+        return result;
+    }
+
+    static float sparseEntry(const SparseRow &a, const SparseRow &b) {
+        return RowKernels::dot(a, b);
+    }
+
+    private:
+    /**
+     * Adds the products of MICRO_ROWS rows of a with MICRO_COLUMNS lanes of the transposed 
+     * panel into accumulators, one column at a time. The sums live in a local array for the 
+     * whole chunk so the compiler can keep them in registers.
+     */
+    static void microKernel(
+        const float* const* a,
+        const float* panel,
+        const size_t chunkColumns,
+        float* accumulators
+    ) {
+        float sums[MICRO_ROWS][MICRO_COLUMNS];
+        for (size_t r = 0; r < MICRO_ROWS; r++) {
+            for (size_t x = 0; x < MICRO_COLUMNS; x++) {
+                sums[r][x] = accumulators[r * ROW_TILE + x];
+            }
+        }
+
+        for (size_t c = 0; c < chunkColumns; c++) {
+            const float *column = panel + c * ROW_TILE;
+            for (size_t r = 0; r < MICRO_ROWS; r++) {
+                const float value = a[r][c];
+
+                #pragma omp simd
+                for (size_t x = 0; x < MICRO_COLUMNS; x++) {
+                    sums[r][x] += value * column[x];
+                }
+            }
+        }
+
+        for (size_t r = 0; r < MICRO_ROWS; r++) {
+            for (size_t x = 0; x < MICRO_COLUMNS; x++) {
+                accumulators[r * ROW_TILE + x] = sums[r][x];
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,225 @@
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <optional>
+#include <algorithm>
+#include <omp.h>
+
+#ifndef KERNEL_CACHE_H
+#define KERNEL_CACHE_H
+
+/**
+ * A fixed size cache of kernel matrix entries that many threads can share. Entries live in
+ * flat buckets of WAYS slots, and a key can only ever sit in the bucket its hash picks, so a
+ * lookup reads a single bucket of two cache lines. Reads take no lock; every bucket carries a version
+ * that writers make odd while they change it, and a read that saw the version change retries.
+ * Writers take one of a fixed set of striped locks. When a bucket is full, a CLOCK hand over
+ * its slots evicts the first entry that has not been read since the hand last passed it.
+ */
+class KernelCache {
+    public:
+    static const size_t WAYS = 8;
+
+    struct Counters {
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+    };
+
+    private:
+    // Readers give up on a bucket that keeps changing and treat the lookup as a miss.
+    static const size_t READ_ATTEMPTS = 8;
+    static const size_t LOCK_STRIPES = 1024;
+
+    // Packed keys are stored plus one so that zero can mark an empty slot.
+    static const uint64_t EMPTY = 0;
+
+    struct alignas(64) Bucket {
+        std::atomic<uint32_t> version;
+        std::atomic<uint8_t> hand;
+        std::atomic<uint8_t> referenced[WAYS];
+        std::atomic<uint64_t> keys[WAYS];
+        std::atomic<float> values[WAYS];
+    };
+
+    // One per thread of the widest team and padded to a cache line so that counting does not
+    //  share a line. Larger or nested teams share slots, so the counts are still atomic.
+    struct alignas(64) ThreadCounters {
+        std::atomic<size_t> hits{0};
+        std::atomic<size_t> misses{0};
+        std::atomic<size_t> evictions{0};
+    };
+
+    const size_t totalBuckets;
+    std::unique_ptr<Bucket[]> buckets;
+    std::vector<std::mutex> stripes;
+    std::vector<ThreadCounters> counters;
+
+    // Disable pass by value. This object is too large for pass by value to make sense implicitly.
+    KernelCache(const KernelCache &);
+
+    static uint64_t pack(const size_t row, const size_t column) {
+        return ((static_cast<uint64_t>(row) << 32) | static_cast<uint64_t>(column)) + 1;
+    }
+
+    // The splitmix64 finalizer, so that neighbouring rows and columns spread over all buckets.
+    static uint64_t mix(uint64_t key) {
+        key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+        return key ^ (key >> 31);
+    }
+
+    ThreadCounters &localCounters() {
+        return this->counters[omp_get_thread_num() % this->counters.size()];
+    }
+
+    std::optional<float> lookup(Bucket &bucket, const uint64_t key) {
+        for (size_t attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+            const uint32_t before = bucket.version.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+
+            std::optional<float> result(std::nullopt);
+            size_t way = 0;
+            for (; way < WAYS; way++) {
+                if (bucket.keys[way].load(std::memory_order_relaxed) == key) {
+                    result = bucket.values[way].load(std::memory_order_relaxed);
+                    break;
+                }
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (bucket.version.load(std::memory_order_relaxed) == before) {
+                if (result.has_value()) {
+                    bucket.referenced[way].store(1, std::memory_order_relaxed);
+                }
+                return result;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    void store(Bucket &bucket, const size_t bucketIndex, const uint64_t key, const float value) {
+        std::lock_guard<std::mutex> lock(this->stripes[bucketIndex % LOCK_STRIPES]);
+
+        // Another thread may have inserted the same entry since this one missed.
+        size_t target = WAYS;
+        for (size_t way = 0; way < WAYS; way++) {
+            const uint64_t existing = bucket.keys[way].load(std::memory_order_relaxed);
+            if (existing == key) {
+                return;
+            }
+            if (existing == EMPTY && target == WAYS) {
+                target = way;
+            }
+        }
+
+        if (target == WAYS) {
+            size_t hand = bucket.hand.load(std::memory_order_relaxed);
+            while (bucket.referenced[hand].load(std::memory_order_relaxed) != 0) {
+                bucket.referenced[hand].store(0, std::memory_order_relaxed);
+                hand = (hand + 1) % WAYS;
+            }
+            target = hand;
+            bucket.hand.store((hand + 1) % WAYS, std::memory_order_relaxed);
+            this->localCounters().evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        const uint32_t version = bucket.version.load(std::memory_order_relaxed);
+        bucket.version.store(version + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        bucket.keys[target].store(key, std::memory_order_relaxed);
+        bucket.values[target].store(value, std::memory_order_relaxed);
+        bucket.referenced[target].store(0, std::memory_order_relaxed);
+
+        bucket.version.store(version + 2, std::memory_order_release);
+    }
+
+    size_t getBucketIndex(const uint64_t key) const {
+        return mix(key) % this->totalBuckets;
+    }
+
+    public:
+    /**
+     * Holds as many entries as fit in budgetBytes, and at least one bucket.
+     */
+    static std::unique_ptr<KernelCache> create(const size_t budgetBytes) {
+        return std::unique_ptr<KernelCache>(new KernelCache(std::max<size_t>(1, budgetBytes / sizeof(Bucket))));
+    }
+
+    KernelCache(const size_t totalBuckets) :
+        totalBuckets(totalBuckets),
+        buckets(new Bucket[totalBuckets]()),
+        stripes(LOCK_STRIPES),
+        counters(omp_get_max_threads())
+    {}
+
+    /**
+     * The cached entry for (row, column), if there is one. Counts as a hit or a miss. Rows and
+     *  columns must be below 2^32.
+     */
+    std::optional<float> find(const size_t row, const size_t column) {
+        const uint64_t key = pack(row, column);
+        const std::optional<float> cached(this->lookup(this->buckets[this->getBucketIndex(key)], key));
+        if (cached.has_value()) {
+            this->localCounters().hits.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            this->localCounters().misses.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        return cached;
+    }
+
+    /**
+     * Caches value for (row, column), evicting another entry of its bucket if the bucket is full.
+     */
+    void insert(const size_t row, const size_t column, const float value) {
+        const uint64_t key = pack(row, column);
+        const size_t bucketIndex = this->getBucketIndex(key);
+        this->store(this->buckets[bucketIndex], bucketIndex, key, value);
+    }
+
+    /**
+     * The cached entry for (row, column), or compute(row, column) which is then cached.
+     */
+    template <typename Compute>
+    float get(const size_t row, const size_t column, Compute compute) {
+        const std::optional<float> cached(this->find(row, column));
+        if (cached.has_value()) {
+            return cached.value();
+        }
+
+        const float value = compute(row, column);
+        this->insert(row, column, value);
+        return value;
+    }
+
+    size_t capacity() const {
+        return this->totalBuckets * WAYS;
+    }
+
+    size_t getStorageBytes() const {
+        return this->totalBuckets * sizeof(Bucket);
+    }
+
+    /**
+     * Totals over every thread. Only exact once no thread is using the cache.
+     */
+    Counters getCounters() const {
+        Counters total{0, 0, 0};
+        for (const ThreadCounters &local : this->counters) {
+            total.hits += local.hits.load(std::memory_order_relaxed);
+            total.misses += local.misses.load(std::memory_order_relaxed);
+            total.evictions += local.evictions.load(std::memory_order_relaxed);
+        }
+
+        return total;
+    }
+};
+
+#endif
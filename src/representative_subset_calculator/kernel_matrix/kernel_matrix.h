@@ -1,10 +1,16 @@
 
 #include <vector>
+#include <algorithm>
 #include <memory>
+#include <optional>
 #include <unordered_map>
 
 #include "relevance_calculator.h"
+#include "packed_symmetric_matrix.h"
+#include "gram_kernels.h"
+#include "kernel_cache.h"
 #include "../../data_tools/base_data.h"
+#include "../../data_tools/simd_kernels.h"
 
 #ifndef KERNEL_MATRIX_H
 #define KERNEL_MATRIX_H
@@ -21,6 +27,22 @@ class KernelMatrix {
 
     virtual size_t size() = 0;
 
+    /**
+     * Writes row j into output, which must hold size() floats.
+     */
+    virtual void copyRow(const size_t j, float* output) {
+        for (size_t i = 0; i < this->size(); i++) {
+            output[i] = this->get(j, i);
+        }
+    }
+
+    /**
+     * Bytes held by the matrix itself, zero for matrices that do not track it.
+     */
+    virtual size_t getStorageBytes() {
+        return 0;
+    }
+
     float getCoverage() {
         return KernelMatrix::getCoverage(this->getDiagonals());
     }
@@ -38,11 +60,7 @@ class KernelMatrix {
     }
 
     static float getDotProduct(const std::vector<float> &a, const std::vector<float> &b) {
-        float res = 0;
-        for (size_t i = 0; i < a.size() && i < b.size(); i++) {
-            res += a[i] * b[i];
-        }
-        return res;
+        return SimdKernels::dot(a.data(), b.data(), std::min(a.size(), b.size()));
     }
 
     static float getCoverage(std::vector<float> diagonals) {
@@ -148,49 +166,184 @@ class ThreadSafeLazyKernelMatrix : public LazyKernelMatrix {
     }
 };
 
+/**
+ * A lazy kernel matrix that many threads can read at once and that never holds more than a
+ *  fixed number of bytes. Entries that fall out of the cache are recomputed on the next get.
+ */
+class CachedLazyKernelMatrix : public LazyKernelMatrix {
+    private:
+    const BaseData &data;
+    RelevanceCalculator& calc;
+    std::unique_ptr<KernelCache> cache;
+
+    // Disable pass by value. This object is too large for pass by value to make sense implicitly.
+    CachedLazyKernelMatrix(const CachedLazyKernelMatrix &);
+
+    public:
+    static std::unique_ptr<CachedLazyKernelMatrix> from(
+        const BaseData &data, 
+        RelevanceCalculator& calc,
+        const size_t budgetBytes) {
+        return std::make_unique<CachedLazyKernelMatrix>(data, calc, KernelCache::create(budgetBytes));
+    }
+
+    CachedLazyKernelMatrix(
+        const BaseData &data, 
+        RelevanceCalculator& calc,
+        std::unique_ptr<KernelCache> cache
+    ) : 
+        data(data),
+        calc(calc),
+        cache(std::move(cache))
+    {}
+
+    size_t size() {
+        return this->data.totalRows();
+    }
+
+    float get(size_t j, size_t i) {
+        return this->cache->get(getRowKey(j, i), getColumnKey(j, i), [this](const size_t row, const size_t column) {
+            return this->calc.get(row, column);
+        });
+    }
+
+    /**
+     * Writes get(j, targets[t]) into output[t] for every t < count. Entries missing from the
+     *  cache are computed together in one batch from the calculator and then cached.
+     */
+    void getRow(const size_t j, const size_t* targets, const size_t count, float* output) {
+        std::vector<size_t> missing;
+        std::vector<size_t> positions;
+        for (size_t t = 0; t < count; t++) {
+            const std::optional<float> cached(this->cache->find(getRowKey(j, targets[t]), getColumnKey(j, targets[t])));
+            if (cached.has_value()) {
+                output[t] = cached.value();
+            } else {
+                missing.push_back(targets[t]);
+                positions.push_back(t);
+            }
+        }
+
+        if (missing.empty()) {
+            return;
+        }
+
+        std::vector<float> computed(missing.size());
+        this->calc.getRow(j, missing.data(), missing.size(), computed.data());
+        for (size_t m = 0; m < missing.size(); m++) {
+            output[positions[m]] = computed[m];
+            this->cache->insert(getRowKey(j, missing[m]), getColumnKey(j, missing[m]), computed[m]);
+        }
+    }
+
+    size_t getStorageBytes() {
+        return this->cache->getStorageBytes();
+    }
+
+    KernelCache::Counters getCounters() const {
+        return this->cache->getCounters();
+    }
+};
+
 class NaiveKernelMatrix : public KernelMatrix {
     private:
-    std::vector<std::vector<float>> kernelMatrix;
+    PackedSymmetricMatrix kernelMatrix;
 
     // Disable pass by value. This object is too large for pass by value to make sense implicitly.
     //  Use an explicit constructor to pass by value.
     NaiveKernelMatrix(const NaiveKernelMatrix &);
 
+    /**
+     * Computes every similarity of calc over data. Naive similarities over rows with raw storage 
+     * go through one of the Gram kernels, anything else is filled one pair at a time. Either 
+     * way every entry is the same as calc.get.
+     */
+    static PackedSymmetricMatrix similarities(const BaseData &data, RelevanceCalculator &calc) {
+        if (dynamic_cast<NaiveRelevanceCalculator*>(&calc) != nullptr) {
+            const GramKernels::RowGatherer rows(GramKernels::RowGatherer::gather(data));
+            if (rows.supported && !rows.dense.empty()) {
+                return GramKernels::blockedGram(rows.dense, rows.columns);
+            }
+            if (rows.supported && !rows.sparse.empty()) {
+                return GramKernels::sparseGram(rows.sparse, rows.columns);
+            }
+        }
+
+        const size_t n = data.totalRows();
+        PackedSymmetricMatrix result(n);
+        std::vector<size_t> targets(n);
+        for (size_t j = 0; j < n; j++) {
+            targets[j] = j;
+        }
+
+        // Row i is one batch of its n - i entries, dynamic scheduling keeps the triangle balanced.
+        #pragma omp parallel
+        {
+            std::vector<float> row(n);
+
+            #pragma omp for schedule(dynamic, 16)
+            for (size_t i = 0; i < n; i++) {
+                calc.getRow(i, targets.data() + i, n - i, row.data());
+                for (size_t j = i; j < n; j++) {
+                    result.set(j, i, row[j - i]);
+                }
+            }
+        }
+
+        return result;
+    }
+
     public:
+    /**
+     * User mode similarities are r_i * S_ij * r_j. S is built first without the weights, so the
+     * Gram kernels still apply, and the weights are applied afterwards in one pass.
+     */
     static std::unique_ptr<NaiveKernelMatrix> from(
         const BaseData &data, 
         RelevanceCalculator &calc) {
-        std::vector<std::vector<float>> result(
-            data.totalRows(), 
-            std::vector<float>(data.totalRows(), 0)
-        );
-
-        // TODO: Verify that this is parallel safe, from a glance this looks super dangerous
-        #pragma omp parallel for
-        for (size_t i = 0; i < data.totalRows(); i++) {
-            for (size_t j = i; j < data.totalRows(); j++) {
-                const float score = calc.get(i, j);
-                result[j][i] = score;
-                result[i][j] = score;
-            }
+        UserModeRelevanceCalculator *userMode = dynamic_cast<UserModeRelevanceCalculator*>(&calc);
+        if (userMode == nullptr) {
+            return std::unique_ptr<NaiveKernelMatrix>(new NaiveKernelMatrix(similarities(data, calc)));
         }
 
+        PackedSymmetricMatrix result(similarities(data, userMode->getDelegate()));
+        const std::vector<double> weights(userMode->getWeights());
+
+        // Same order of operations as UserModeRelevanceCalculator::get.
+        result.transform([&weights](const size_t j, const size_t i, const double s_ji) -> float {
+            return weights[i] * s_ji * weights[j];
+        });
+
         return std::unique_ptr<NaiveKernelMatrix>(new NaiveKernelMatrix(std::move(result)));
     }
 
-    NaiveKernelMatrix(std::vector<std::vector<float>> data) : kernelMatrix(std::move(data)) {}
+    NaiveKernelMatrix(PackedSymmetricMatrix data) : kernelMatrix(std::move(data)) {}
 
     size_t size() {
         return this->kernelMatrix.size();
     }
 
     float get(size_t j, size_t i) {
-        return this->kernelMatrix[j][i];
+        return this->kernelMatrix.get(j, i);
+    }
+
+    /**
+     * Writes row j into output, which must hold size() floats. Cheaper than calling get for
+     * every entry of a row.
+     */
+    void copyRow(const size_t j, float* output) {
+        this->kernelMatrix.copyRow(j, output);
+    }
+
+    size_t getStorageBytes() {
+        return this->kernelMatrix.getStorageBytes();
     }
 
     void printDEBUG() const {
-        for (const auto & r : kernelMatrix) {
-            for (const auto & v : r) {
+        std::vector<float> row(this->kernelMatrix.size());
+        for (size_t j = 0; j < row.size(); j++) {
+            this->kernelMatrix.copyRow(j, row.data());
+            for (const auto & v : row) {
                 std::cout << v << " ";
             }
             std::cout << std::endl;
@@ -198,4 +351,133 @@ class NaiveKernelMatrix : public KernelMatrix {
     }
 };
 
-#endif
\ No newline at end of file
+/**
+ * Computes rows of the kernel matrix only when they are asked for, with the same values
+ * NaiveKernelMatrix would hold. A row costs one pass over the dataset, a dense matrix-vector
+ * product or a sparse scatter through a column index, and nothing of size n * n is ever kept.
+ */
+class MatrixFreeKernelMatrix : public KernelMatrix {
+    private:
+    const BaseData &data;
+
+    // Computes the unweighted similarities of rows that have no raw storage.
+    RelevanceCalculator &similarity;
+
+    // Only set in user mode, see UserModeRelevanceCalculator::getWeights.
+    const std::optional<std::vector<double>> weights;
+
+    const GramKernels::RowGatherer rows;
+
+    // Only built when sparse rows come from a dataset without a column index of its own.
+    const std::unique_ptr<InvertedColumnIndex> ownedIndex;
+    const InvertedColumnIndex* index;
+
+    // Disable pass by value. This object is too large for pass by value to make sense implicitly.
+    MatrixFreeKernelMatrix(const MatrixFreeKernelMatrix &);
+
+    static GramKernels::RowGatherer gather(const BaseData &data, RelevanceCalculator &similarity) {
+        if (dynamic_cast<NaiveRelevanceCalculator*>(&similarity) == nullptr) {
+            GramKernels::RowGatherer unsupported;
+            unsupported.supported = false;
+            return unsupported;
+        }
+
+        return GramKernels::RowGatherer::gather(data);
+    }
+
+    bool isDense() const {
+        return this->rows.supported && !this->rows.dense.empty();
+    }
+
+    bool isSparse() const {
+        return this->rows.supported && !this->rows.sparse.empty();
+    }
+
+    float weigh(const size_t j, const size_t i, const double s_ji) const {
+        if (!this->weights.has_value()) {
+            return s_ji;
+        }
+
+        // Same order of operations as NaiveKernelMatrix, lower index first.
+        const std::vector<double> &w(this->weights.value());
+        return w[std::min(j, i)] * s_ji * w[std::max(j, i)];
+    }
+
+    public:
+    static std::unique_ptr<MatrixFreeKernelMatrix> from(
+        const BaseData &data, 
+        RelevanceCalculator &calc) {
+        UserModeRelevanceCalculator *userMode = dynamic_cast<UserModeRelevanceCalculator*>(&calc);
+        if (userMode == nullptr) {
+            return std::unique_ptr<MatrixFreeKernelMatrix>(
+                new MatrixFreeKernelMatrix(data, calc, std::nullopt)
+            );
+        }
+
+        return std::unique_ptr<MatrixFreeKernelMatrix>(
+            new MatrixFreeKernelMatrix(data, userMode->getDelegate(), userMode->getWeights())
+        );
+    }
+
+    MatrixFreeKernelMatrix(
+        const BaseData &data, 
+        RelevanceCalculator &similarity, 
+        std::optional<std::vector<double>> weights
+    ) : 
+        data(data),
+        similarity(similarity),
+        weights(std::move(weights)),
+        rows(gather(data, similarity)),
+        ownedIndex(
+            this->isSparse() && data.getColumnIndex() == nullptr
+                ? InvertedColumnIndex::fromRows(this->rows.sparse, this->rows.columns) 
+                : nullptr
+        ),
+        index(this->ownedIndex != nullptr ? this->ownedIndex.get() : data.getColumnIndex())
+    {}
+
+    size_t size() {
+        return this->data.totalRows();
+    }
+
+    float get(size_t j, size_t i) {
+        const size_t low = std::min(j, i);
+        const size_t high = std::max(j, i);
+        float s_ji;
+        if (this->isDense()) {
+            s_ji = GramKernels::denseEntry(this->rows.dense[low], this->rows.dense[high], this->rows.columns);
+        } else if (this->isSparse()) {
+            s_ji = GramKernels::sparseEntry(this->rows.sparse[low], this->rows.sparse[high]);
+        } else {
+            s_ji = this->similarity.get(low, high);
+        }
+
+        return this->weigh(j, i, s_ji);
+    }
+
+    void copyRow(const size_t j, float* output) {
+        const size_t n = this->size();
+        if (this->isDense()) {
+            GramKernels::denseRow(this->rows.dense, this->rows.columns, j, output);
+        } else if (this->isSparse()) {
+            GramKernels::sparseRow(this->rows.sparse[j], *this->index, output);
+        } else {
+            this->similarity.getRow(j, output);
+        }
+
+        if (this->weights.has_value()) {
+            #pragma omp parallel for
+            for (size_t i = 0; i < n; i++) {
+                output[i] = this->weigh(j, i, output[i]);
+            }
+        }
+    }
+
+    size_t getStorageBytes() {
+        return this->rows.dense.capacity() * sizeof(const float*)
+            + this->rows.sparse.capacity() * sizeof(GramKernels::SparseRow)
+            + (this->ownedIndex != nullptr ? this->ownedIndex->getStorageBytes() : 0);
+    }
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include "../../data_tools/dense_matrix.h"
+
+#ifndef PACKED_SYMMETRIC_MATRIX_H
+#define PACKED_SYMMETRIC_MATRIX_H
+
+/**
+ * Stores a symmetric n x n matrix as its lower triangle, packed row by row into one aligned
+ * allocation. Row i holds the entries (i, 0) through (i, i), so only n * (n + 1) / 2 floats
+ * are kept. Different entries can be set from different threads.
+ */
+class PackedSymmetricMatrix {
+    private:
+    size_t n;
+    std::vector<float, AlignedAllocator<float, DenseMatrix::ALIGNMENT_BYTES>> values;
+
+    static size_t rowStart(const size_t i) {
+        return i * (i + 1) / 2;
+    }
+
+    static size_t index(const size_t j, const size_t i) {
+        return j >= i ? rowStart(j) + i : rowStart(i) + j;
+    }
+
+    public:
+    PackedSymmetricMatrix(const size_t n) : n(n), values(rowStart(n), 0) {}
+
+    size_t size() const {
+        return this->n;
+    }
+
+    float get(const size_t j, const size_t i) const {
+        return this->values[index(j, i)];
+    }
+
+    void set(const size_t j, const size_t i, const float value) {
+        this->values[index(j, i)] = value;
+    }
+
+    /**
+     * Writes the full row j into output, which must hold size() floats. The first j + 1
+     * entries are one contiguous copy, the rest walk down column j of the triangle.
+     */
+    void copyRow(const size_t j, float* output) const {
+        std::memcpy(output, this->values.data() + rowStart(j), (j + 1) * sizeof(float));
+
+        size_t position = rowStart(j + 1) + j;
+        for (size_t i = j + 1; i < this->n; i++) {
+            output[i] = this->values[position];
+            position += i + 1;
+        }
+    }
+
+    /**
+     * Calls update(j, i, value) for every stored entry, i <= j, and keeps what it returns.
+     */
+    template <typename Update>
+    void transform(Update update) {
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (size_t j = 0; j < this->n; j++) {
+            float* row = this->values.data() + rowStart(j);
+            for (size_t i = 0; i <= j; i++) {
+                row[i] = update(j, i, row[i]);
+            }
+        }
+    }
+
+    size_t getStorageBytes() const {
+        return this->values.capacity() * sizeof(float);
+    }
+};
+
+#endif
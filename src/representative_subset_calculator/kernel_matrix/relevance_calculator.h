@@ -1,6 +1,8 @@
 
+#include <mutex>
 #include <unordered_map>
 
+#include "gram_kernels.h"
 #include "../../data_tools/base_data.h"
 
 #ifndef RELEVANCE_CALCULATOR_H
@@ -10,12 +12,140 @@ class RelevanceCalculator {
     public:
     virtual ~RelevanceCalculator() {}
     virtual float get(const size_t i, const size_t j) = 0;
+
+    /**
+     * The number of rows this calculator compares, the length of a full row.
+     */
+    virtual size_t size() const = 0;
+
+    /**
+     * Writes get(i, targets[t]) into output[t] for every t < count. Runs on the calling thread,
+     *  so many threads can each ask for their own batch.
+     */
+    virtual void getRow(const size_t i, const size_t* targets, const size_t count, float* output) {
+        for (size_t t = 0; t < count; t++) {
+            output[t] = this->get(i, targets[t]);
+        }
+    }
+
+    /**
+     * Writes get(i, j) into output[j] for every row j. Output must hold size() floats.
+     */
+    virtual void getRow(const size_t i, float* output) {
+        #pragma omp parallel for
+        for (size_t j = 0; j < this->size(); j++) {
+            output[j] = this->get(i, j);
+        }
+    }
 };
 
 class NaiveRelevanceCalculator : public RelevanceCalculator {
     private:
     const BaseData &data;
 
+    // Raw storage of every row, gathered by the first call. Calculators handed to the Gram 
+    //  kernels are never asked for entries, so nothing is gathered up front.
+    std::once_flag gathered;
+    GramKernels::RowGatherer rows;
+
+    // Only filled when rows is unsupported, for datasets that mix layouts or store maps.
+    std::vector<RowRef> refs;
+
+    const GramKernels::RowGatherer &getRows() {
+        std::call_once(this->gathered, [this]() {
+            this->rows = GramKernels::RowGatherer::gather(this->data);
+            if (!this->rows.supported) {
+                this->refs.reserve(this->data.totalRows());
+                for (size_t i = 0; i < this->data.totalRows(); i++) {
+                    this->refs.push_back(RowRef::of(this->data.getRow(i)));
+                }
+            }
+        });
+
+        return this->rows;
+    }
+
+    /**
+     * Sum of query[c] * v over the non zeros (c, v) of row, in column order. Columns of row 
+     *  that the scattered query has no value in add zero, which leaves the sum as is, so this 
+     *  is exactly RowKernels::dot of the two sparse rows. Columns past the end of query add 
+     *  nothing.
+     */
+    static float scatteredDot(const std::vector<float> &query, const SparseRowRef &row) {
+        float result = 0;
+        for (size_t k = 0; k < row.nonZeros && row.columns[k] < query.size(); k++) {
+            result += query[row.columns[k]] * row.values[k];
+        }
+
+        return result;
+    }
+
+    /**
+     * Writes the similarity of row i and row target(t) into output[t] for every t < count. 
+     * Row i is decoded once, and the loop over targets reads raw storage without any visitor.
+     * Dense entries go through GramKernels::denseEntry like get. Sparse row i is scattered 
+     * into a dense row once, and every target walks its own non zeros with scatteredDot, 
+     * so sparse entries are the same as get too.
+     */
+    template <typename Target>
+    void batch(const size_t i, const size_t count, Target target, float* output, const bool parallel) {
+        const GramKernels::RowGatherer &rows(this->getRows());
+        if (rows.supported && !rows.dense.empty()) {
+            const float* query = rows.dense[i];
+
+            #pragma omp parallel for if(parallel)
+            for (size_t t = 0; t < count; t++) {
+                output[t] = GramKernels::denseEntry(query, rows.dense[target(t)], rows.columns);
+            }
+        } else if (rows.supported && !rows.sparse.empty()) {
+            std::vector<float> query(rows.columns, 0);
+            const GramKernels::SparseRow &row(rows.sparse[i]);
+            for (size_t k = 0; k < row.nonZeros; k++) {
+                query[row.columns[k]] = row.values[k];
+            }
+
+            #pragma omp parallel for if(parallel)
+            for (size_t t = 0; t < count; t++) {
+                output[t] = scatteredDot(query, rows.sparse[target(t)]);
+            }
+        } else {
+            const RowRef &query(this->refs[i]);
+
+            #pragma omp parallel for if(parallel)
+            for (size_t t = 0; t < count; t++) {
+                output[t] = RowRef::dot(query, this->refs[target(t)]);
+            }
+        }
+    }
+
+    /**
+     * The column index of the dataset if it has one and its rows are sparse. Dense rows keep 
+     *  the dense kernels, which add their products in a different order than a walk would.
+     */
+    const InvertedColumnIndex* getSparseIndex() {
+        const GramKernels::RowGatherer &rows(this->getRows());
+        const InvertedColumnIndex* index = this->data.getColumnIndex();
+        if (index == nullptr || (rows.supported && !rows.dense.empty())) {
+            return nullptr;
+        }
+
+        return index;
+    }
+
+    /**
+     * Row i in column order. Gathered rows are used in place, anything else is decoded into 
+     *  entries, which must outlive the result.
+     */
+    SparseRowRef getSparseRow(const size_t i, InvertedColumnIndex::RowEntries &entries) {
+        const GramKernels::RowGatherer &rows(this->getRows());
+        if (rows.supported && !rows.sparse.empty()) {
+            return rows.sparse[i];
+        }
+
+        this->data.getRow(i).voidVisit(entries);
+        return entries.getRow();
+    }
+
     public:
     NaiveRelevanceCalculator(const BaseData &data) : data(data) {}
 
@@ -23,22 +153,101 @@ class NaiveRelevanceCalculator : public RelevanceCalculator {
         return std::make_unique<NaiveRelevanceCalculator>(data);
     }
 
+    /**
+     * The layout of the dataset is resolved once, so every entry goes straight to the kernel 
+     *  for its pair of layouts. Dense rows use GramKernels::denseEntry, the same sums as the 
+     *  dense kernel matrices, anything else has the same result as DataRow::dotProduct.
+     */
     float get(const size_t i, const size_t j) {
-        return this->data.getRow(i).dotProduct(this->data.getRow(j));
+        const GramKernels::RowGatherer &rows(this->getRows());
+        if (rows.supported && !rows.dense.empty()) {
+            return GramKernels::denseEntry(rows.dense[i], rows.dense[j], rows.columns);
+        } else if (rows.supported && !rows.sparse.empty()) {
+            return RowKernels::dot(rows.sparse[i], rows.sparse[j]);
+        }
+
+        return RowRef::dot(this->refs[i], this->refs[j]);
+    }
+
+    size_t size() const {
+        return this->data.totalRows();
+    }
+
+    /**
+     * With a column index the whole row is summed from the posting lists of row i, which is 
+     *  only cheaper than a batch when the batch asks for a large share of the rows. Otherwise 
+     *  each target adds its products in column order one at a time, so every entry matches 
+     *  get exactly and batches of any shape agree with each other.
+     */
+    void getRow(const size_t i, const size_t* targets, const size_t count, float* output) {
+        const InvertedColumnIndex* index = this->getSparseIndex();
+        const GramKernels::RowGatherer &rows(this->getRows());
+        if (index == nullptr || index->totalRows() == 0) {
+            if (rows.supported && !rows.sparse.empty()) {
+                for (size_t t = 0; t < count; t++) {
+                    output[t] = RowKernels::dot(rows.sparse[i], rows.sparse[targets[t]]);
+                }
+            } else {
+                this->batch(i, count, [targets](const size_t t) { return targets[t]; }, output, false);
+            }
+            return;
+        }
+
+        InvertedColumnIndex::RowEntries entries;
+        const SparseRowRef query(this->getSparseRow(i, entries));
+
+        // A walk clears and then touches one sum per posting, a batch reads every target.
+        const size_t n = index->totalRows();
+        const size_t walk = n + index->getPostingCount(query);
+        const size_t merge = count * (query.nonZeros + index->totalNonZeros() / n);
+        if (walk < merge) {
+            std::vector<float> sums(n, 0);
+            index->accumulate(query, sums.data(), 0, n);
+            for (size_t t = 0; t < count; t++) {
+                output[t] = sums[targets[t]];
+            }
+        } else if (rows.supported) {
+            std::vector<float> dense(index->totalColumns(), 0);
+            for (size_t k = 0; k < query.nonZeros && query.columns[k] < dense.size(); k++) {
+                dense[query.columns[k]] = query.values[k];
+            }
+
+            for (size_t t = 0; t < count; t++) {
+                output[t] = scatteredDot(dense, rows.sparse[targets[t]]);
+            }
+        } else {
+            for (size_t t = 0; t < count; t++) {
+                output[t] = this->get(i, targets[t]);
+            }
+        }
+    }
+
+    void getRow(const size_t i, float* output) {
+        const GramKernels::RowGatherer &rows(this->getRows());
+        if (rows.supported && !rows.dense.empty()) {
+            GramKernels::denseRow(rows.dense, rows.columns, i, output);
+            return;
+        }
+
+        const InvertedColumnIndex* index = this->getSparseIndex();
+        if (index != nullptr) {
+            InvertedColumnIndex::RowEntries entries;
+            GramKernels::sparseRow(this->getSparseRow(i, entries), *index, output);
+            return;
+        }
+
+        this->batch(i, this->size(), [](const size_t t) { return t; }, output, true);
     }
 };
 
 class UserModeRelevanceCalculator : public RelevanceCalculator {
     private:
     std::unique_ptr<RelevanceCalculator> delegate;
-    // not a reference
-    const std::vector<double> ru;
-    const double alpha;
+
+    // r_i = e^(alpha * ru_i) for every local row, computed once when the calculator is built.
+    const std::vector<double> weights;
 
     public:
-    /**
-     * This constructor gets spammed. We should really cache this or otherwise make this more efficent
-     */
     static std::unique_ptr<UserModeRelevanceCalculator> from(
         const BaseData &data, 
         const std::vector<double> userData, 
@@ -46,38 +255,92 @@ class UserModeRelevanceCalculator : public RelevanceCalculator {
     ) {
         const double alpha = calcAlpha(theta);
         SPDLOG_TRACE("calculated alpha of {0:f}", alpha);
+        std::vector<double> weights(userData.size());
+        for (size_t i = 0; i < weights.size(); i++) {
+            weights[i] = getWeight(alpha, userData[i]);
+        }
+
+        return fromWeights(data, std::move(weights));
+    }
+
+    /**
+     * For callers that already hold r_i for every row of data, see getWeight.
+     */
+    static std::unique_ptr<UserModeRelevanceCalculator> fromWeights(
+        const BaseData &data, 
+        std::vector<double> weights
+    ) {
         return std::unique_ptr<UserModeRelevanceCalculator>(
             new UserModeRelevanceCalculator(
                 NaiveRelevanceCalculator::from(data), 
-                std::move(userData), 
-                alpha
+                std::move(weights)
             )
         );
     }
 
+    static double calcAlpha(const double theta) {
+        return 0.5 * (theta / (1.0 - theta));
+    }
+
+    static double getWeight(const double alpha, const double ru) {
+        return std::exp(alpha * ru);
+    }
+
     float get(const size_t i, const size_t j) {
         const double s_ij = this->delegate->get(i, j);
-        const double r_i = getRu(i);
-        const double r_j = getRu(j);
+        const double r_i = this->weights[i];
+        const double r_j = this->weights[j];
         const double result = r_i * s_ij * r_j;
         SPDLOG_TRACE("result for user mode of {0:f} from s_ij of {1:f}, r_i {2:d} of value {3:f}, and r_j {4:d} of value {5:f}", result, s_ij, i, r_i, j, r_j);
         return result;
     }
 
-    private:
-    UserModeRelevanceCalculator(
-        std::unique_ptr<RelevanceCalculator> delegate, 
-        const std::vector<double> ru,
-        const double alpha
-    ) : delegate(std::move(delegate)), ru(std::move(ru)), alpha(alpha) {}
+    size_t size() const {
+        return this->weights.size();
+    }
 
-    double getRu(size_t i) const {
-        return std::exp(this->alpha * this->ru[i]);
+    /**
+     * The delegate fills in s_ij for the whole batch, then the weights are applied in the same
+     *  order of operations as get.
+     */
+    void getRow(const size_t i, const size_t* targets, const size_t count, float* output) {
+        this->delegate->getRow(i, targets, count, output);
+        const double r_i = this->weights[i];
+        for (size_t t = 0; t < count; t++) {
+            output[t] = r_i * (double)output[t] * this->weights[targets[t]];
+        }
     }
 
-    static double calcAlpha(const double theta) {
-        return 0.5 * (theta / (1.0 - theta));
+    void getRow(const size_t i, float* output) {
+        this->delegate->getRow(i, output);
+        const double r_i = this->weights[i];
+
+        #pragma omp parallel for
+        for (size_t j = 0; j < this->size(); j++) {
+            output[j] = r_i * (double)output[j] * this->weights[j];
+        }
     }
+
+    /**
+     * The calculator used for s_ij, before any user weights are applied.
+     */
+    RelevanceCalculator &getDelegate() {
+        return *this->delegate;
+    }
+
+    /**
+     * The diagonal of D in D * S * D, r_i for every row, so that 
+     *  get(i, j) == r_i * delegate.get(i, j) * r_j.
+     */
+    const std::vector<double> &getWeights() const {
+        return this->weights;
+    }
+
+    private:
+    UserModeRelevanceCalculator(
+        std::unique_ptr<RelevanceCalculator> delegate, 
+        std::vector<double> weights
+    ) : delegate(std::move(delegate)), weights(std::move(weights)) {}
 };
 
 #endif
\ No newline at end of file
@@ -6,10 +6,60 @@
 #ifndef RELEVANCE_CALCULATOR_FACTOR_H
 #define RELEVANCE_CALCULATOR_FACTOR_H
 
+/**
+ * A dataset of one row, so that a single row can be scored by any calculator.
+ */
+class SingleRowData : public BaseData {
+    private:
+    const DataRow &row;
+    const size_t globalRow;
+
+    public:
+    SingleRowData(const DataRow& row, const size_t globalRow) 
+    : row(row), globalRow(globalRow) {}
+
+    const DataRow& getRow(size_t _i) const {
+        return row;
+    }
+
+    size_t totalRows() const {
+        return 1;
+    }
+
+    size_t totalColumns() const {
+        return row.size();
+    }
+
+    size_t getRemoteIndexForRow(const size_t localRowIndex) const {
+        if (localRowIndex != 0) {
+            spdlog::error("This dummy data object only has one row, cannot return mapping for {0:d}", localRowIndex);
+        }
+        return globalRow;
+    }
+
+    size_t getLocalIndexFromGlobalIndex(const size_t globalIndex) const {
+        if (globalIndex != globalRow) {
+            spdlog::error("Unrecognized global row of {0:d} but expected {1:d}", globalIndex, globalRow);
+        }
+
+        return globalRow;
+    }
+};
+
 class RelevanceCalculatorFactory {
     public:
     virtual ~RelevanceCalculatorFactory() {}
     virtual std::unique_ptr<RelevanceCalculator> build(const BaseData& d) const = 0;
+
+    /**
+     * The relevance of row with itself, where globalRow is its index in the full dataset. 
+     *  Called once per seed while streaming, so factories should override this when they can 
+     *  score a row without building a calculator.
+     */
+    virtual float getRowScore(const DataRow &row, const size_t globalRow) const {
+        SingleRowData data(row, globalRow);
+        return this->build(data)->get(0, 0);
+    }
 };
 
 class NaiveRelevanceCalculatorFactory : public RelevanceCalculatorFactory {
@@ -17,82 +67,66 @@ class NaiveRelevanceCalculatorFactory : public RelevanceCalculatorFactory {
     std::unique_ptr<RelevanceCalculator> build(const BaseData& d) const {
         return NaiveRelevanceCalculator::from(d);
     }
+
+    float getRowScore(const DataRow &row, const size_t _globalRow) const {
+        return row.dotProduct(row);
+    }
 };
 
 class UserModeNaiveRelevanceCalculatorFactory : public RelevanceCalculatorFactory {
     private:
-    const UserData& user;
-    const double theta;
+    // r = e^(alpha * ru) for every row in the user's cu, by global row. Computed once per user 
+    //  and shared by every calculator this factory builds.
+    const std::unordered_map<unsigned long long, double> globalRowToWeight;
+
+    static std::unordered_map<unsigned long long, double> buildWeights(
+        const UserData& user, 
+        const double theta
+    ) {
+        const double alpha = UserModeRelevanceCalculator::calcAlpha(theta);
+        std::unordered_map<unsigned long long, double> weights;
+        for (const auto & rowAndRu : user.getCuToRuMapping()) {
+            weights.insert({rowAndRu.first, UserModeRelevanceCalculator::getWeight(alpha, rowAndRu.second)});
+        }
+
+        return weights;
+    }
 
     public:
     UserModeNaiveRelevanceCalculatorFactory(
         const UserData& user,
         const double theta
-    ) : user(user), theta(theta) {}
+    ) : globalRowToWeight(buildWeights(user, theta)) {}
 
     std::unique_ptr<RelevanceCalculator> build(const BaseData& d) const {
-        const std::unordered_map<unsigned long long, double>& globalRowToRu(
-            user.getCuToRuMapping()
-        );
-
-        std::vector<double> relativeRu;
+        std::vector<double> weights(d.totalRows());
         for (size_t s = 0; s < d.totalRows(); s++) {
             size_t globalRow = d.getRemoteIndexForRow(s);
             SPDLOG_TRACE("looking at {0:d} for local of {1:d}", globalRow, s);
-            relativeRu.push_back(globalRowToRu.at(globalRow));
+            weights[s] = globalRowToWeight.at(globalRow);
         }
 
-        return UserModeRelevanceCalculator::from(d, std::move(relativeRu), theta);
+        return UserModeRelevanceCalculator::fromWeights(d, std::move(weights));
+    }
+
+    /**
+     * Same order of operations as UserModeRelevanceCalculator::get(0, 0) on a single row.
+     */
+    float getRowScore(const DataRow &row, const size_t globalRow) const {
+        const double s = row.dotProduct(row);
+        const double r = globalRowToWeight.at(globalRow);
+        return r * s * r;
     }
 };
 
 class PerRowRelevanceCalculator {
-    private:
-    class DummyData : public BaseData {
-        private:
-        const DataRow &row;
-        const size_t globalRow;
-
-        public:
-        DummyData(const DataRow& row, const size_t globalRow) 
-        : row(row), globalRow(globalRow) {}
-
-        const DataRow& getRow(size_t _i) const {
-            return row;
-        }
-
-        size_t totalRows() const {
-            return 1;
-        }
-
-        size_t totalColumns() const {
-            return row.size();
-        }
-
-        size_t getRemoteIndexForRow(const size_t localRowIndex) const {
-            if (localRowIndex != 0) {
-                spdlog::error("This dummy data object only has one row, cannot return mapping for {0:d}", localRowIndex);
-            }
-            return globalRow;
-        }
-
-        size_t getLocalIndexFromGlobalIndex(const size_t globalIndex) const {
-            if (globalIndex != globalRow) {
-                spdlog::error("Unrecognized global row of {0:d} but expected {1:d}", globalIndex, globalRow);
-            }
-
-            return globalRow;
-        }
-    };
-
     public:
     static float getScore(
         const DataRow &row, 
         const RelevanceCalculatorFactory &factory,
         const size_t globalRow
     ) {
-        DummyData data(row, globalRow);
-        return factory.build(data)->get(0, 0);
+        return factory.getRowScore(row, globalRow);
     }
 };
 
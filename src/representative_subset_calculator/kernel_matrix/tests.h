@@ -14,4 +14,381 @@ TEST_CASE("Kernel matracies are equivalent") {
             CHECK(naiveValue < lazyValue + LARGEST_ACCEPTABLE_ERROR);
         }
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Blocked dense kernel matrix matches the row by row kernel matrix") {
+    // Large enough to cover several row tiles, a partial tile, and more than one column chunk.
+    const size_t rows = 150;
+    const size_t columns = 700;
+    std::vector<std::vector<float>> raw(randomNormalRows(rows, columns, 42));
+    for (auto & row : raw) {
+        for (auto & v : row) {
+            v /= std::sqrt((float)columns);
+        }
+    }
+
+    std::unique_ptr<FullyLoadedData> rowData(FullyLoadedData::load(raw));
+    std::unique_ptr<DenseMatrixData> matrixData(DenseMatrixData::load(raw));
+    NaiveRelevanceCalculator rowCalc(*rowData);
+    NaiveRelevanceCalculator matrixCalc(*matrixData);
+    std::unique_ptr<NaiveKernelMatrix> expected(NaiveKernelMatrix::from(*rowData, rowCalc));
+    std::unique_ptr<NaiveKernelMatrix> blocked(NaiveKernelMatrix::from(*matrixData, matrixCalc));
+
+    REQUIRE(blocked->size() == rows);
+    for (size_t j = 0; j < rows; j++) {
+        for (size_t i = 0; i < rows; i++) {
+            CHECK(blocked->get(j, i) == blocked->get(i, j));
+            CHECK(blocked->get(j, i) == SimdKernels::dotScalar(raw[j].data(), raw[i].data(), columns));
+            CHECK(blocked->get(j, i) == expected->get(j, i));
+            CHECK(blocked->get(j, i) == matrixCalc.get(j, i));
+        }
+    }
+}
+
+TEST_CASE("Sparse kernel matrix matches the pairwise sparse dot products") {
+    // Enough rows for several dynamic batches, with empty rows and columns no row uses.
+    const size_t rows = 90;
+    const size_t columns = 400;
+    std::vector<std::vector<float>> raw(randomNormalRows(rows, columns, 7, 0.05));
+    for (size_t r = 0; r < rows; r += 10) {
+        std::fill(raw[r].begin(), raw[r].end(), 0);
+    }
+    std::unique_ptr<CompressedSparseRowData> data(sparseRowsOf(raw));
+
+    NaiveRelevanceCalculator calc(*data);
+    std::unique_ptr<NaiveKernelMatrix> matrix(NaiveKernelMatrix::from(*data, calc));
+
+    REQUIRE(matrix->size() == rows);
+    for (size_t j = 0; j < rows; j++) {
+        for (size_t i = 0; i < rows; i++) {
+            CHECK(matrix->get(j, i) == calc.get(j, i));
+        }
+    }
+}
+
+TEST_CASE("Sparse kernel matrix keeps products whose partial sums cancel") {
+    // Row 1 cancels row 0 after two columns and row 3 starts with a stored zero, so both
+    //  partial sums pass through zero before reaching their final value.
+    const std::vector<std::vector<std::pair<size_t, float>>> entries({
+        {{0, 1}, {1, 1}, {2, 1}},
+        {{0, 1}, {1, -1}, {2, 2}},
+        {{0, -2}, {1, 2}, {3, 1}},
+        {{0, 0}, {1, 1}},
+        {}
+    });
+    CompressedSparseRows storage(4);
+    std::vector<size_t> localRowToGlobalRow;
+    for (size_t r = 0; r < entries.size(); r++) {
+        for (const auto &entry : entries[r]) {
+            storage.push(entry.first, entry.second);
+        }
+        storage.finishRow();
+        localRowToGlobalRow.push_back(r);
+    }
+    CompressedSparseRowData data(std::move(storage), std::move(localRowToGlobalRow), std::nullopt);
+
+    NaiveRelevanceCalculator calc(data);
+    std::unique_ptr<NaiveKernelMatrix> matrix(NaiveKernelMatrix::from(data, calc));
+
+    CHECK(matrix->get(0, 1) == 2);
+    CHECK(matrix->get(0, 3) == 1);
+    for (size_t j = 0; j < entries.size(); j++) {
+        for (size_t i = 0; i < entries.size(); i++) {
+            CHECK(matrix->get(j, i) == calc.get(j, i));
+        }
+    }
+}
+
+TEST_CASE("User mode kernel matrix applies weights after the Gram kernel") {
+    std::unique_ptr<UserData> userData(userDataFor({0, 2, 3, 5}));
+    std::unique_ptr<DenseMatrixData> data(DenseMatrixData::load(DENSE_DATA));
+    std::unique_ptr<UserModeDataDecorator> decorator(UserModeDataDecorator::create(*data, *userData));
+
+    std::unique_ptr<UserModeRelevanceCalculator> calc(
+        UserModeRelevanceCalculator::from(*decorator, userData->getRu(), 0.7)
+    );
+    std::unique_ptr<NaiveKernelMatrix> matrix(NaiveKernelMatrix::from(*decorator, *calc));
+    std::unique_ptr<NaiveKernelMatrix> unweighted(NaiveKernelMatrix::from(*decorator, calc->getDelegate()));
+    const std::vector<double> weights(calc->getWeights());
+
+    REQUIRE(matrix->size() == decorator->totalRows());
+    for (size_t j = 0; j < decorator->totalRows(); j++) {
+        for (size_t i = 0; i < decorator->totalRows(); i++) {
+            // The matrix is symmetric, entries are weighted in the order get(min, max) uses.
+            const size_t low = std::min(j, i);
+            const size_t high = std::max(j, i);
+            const float expected = weights[low] * (double)unweighted->get(j, i) * weights[high];
+            CHECK(matrix->get(j, i) == expected);
+            CHECK(std::abs(matrix->get(j, i) - calc->get(j, i)) < 1e-4 * std::abs(calc->get(j, i)));
+        }
+    }
+}
+
+TEST_CASE("Packed symmetric matrix stores the lower triangle") {
+    const size_t n = 37;
+    PackedSymmetricMatrix matrix(n);
+    CHECK(matrix.size() == n);
+    CHECK(matrix.getStorageBytes() >= n * (n + 1) / 2 * sizeof(float));
+    CHECK(matrix.getStorageBytes() < n * n * sizeof(float));
+
+    for (size_t j = 0; j < n; j++) {
+        for (size_t i = 0; i <= j; i++) {
+            matrix.set(i, j, j * 100 + i);
+        }
+    }
+
+    matrix.transform([](const size_t j, const size_t i, const float value) {
+        return value + (j == i ? 0.5 : 0);
+    });
+
+    std::vector<float> row(n);
+    for (size_t j = 0; j < n; j++) {
+        matrix.copyRow(j, row.data());
+        for (size_t i = 0; i < n; i++) {
+            const float expected = std::max(j, i) * 100 + std::min(j, i) + (j == i ? 0.5 : 0);
+            CHECK(matrix.get(j, i) == expected);
+            CHECK(matrix.get(i, j) == expected);
+            CHECK(row[i] == expected);
+        }
+    }
+}
+
+static void checkMatrixFreeMatchesNaive(const BaseData &data, RelevanceCalculator &calc) {
+    std::unique_ptr<NaiveKernelMatrix> naive(NaiveKernelMatrix::from(data, calc));
+    std::unique_ptr<MatrixFreeKernelMatrix> matrixFree(MatrixFreeKernelMatrix::from(data, calc));
+
+    const size_t n = data.totalRows();
+    REQUIRE(matrixFree->size() == n);
+    CHECK(matrixFree->getDiagonals() == naive->getDiagonals());
+
+    std::vector<float> expected(n);
+    std::vector<float> row(n);
+    for (size_t j = 0; j < n; j++) {
+        naive->copyRow(j, expected.data());
+        matrixFree->copyRow(j, row.data());
+        CHECK(row == expected);
+        for (size_t i = 0; i < n; i++) {
+            CHECK(matrixFree->get(j, i) == expected[i]);
+        }
+    }
+}
+
+TEST_CASE("Matrix free kernel rows match the naive kernel matrix") {
+    const size_t rows = 150;
+    const size_t columns = 300;
+    std::vector<std::vector<float>> raw(randomNormalRows(rows, columns, 11, 0.1));
+
+    std::unique_ptr<DenseMatrixData> dense(DenseMatrixData::load(raw));
+    NaiveRelevanceCalculator denseCalc(*dense);
+    checkMatrixFreeMatchesNaive(*dense, denseCalc);
+
+    std::unique_ptr<CompressedSparseRowData> sparse(sparseRowsOf(raw));
+    NaiveRelevanceCalculator sparseCalc(*sparse);
+    checkMatrixFreeMatchesNaive(*sparse, sparseCalc);
+
+    std::unique_ptr<UserData> userData(userDataFor({3, 17, 40, 41, 99, 120}));
+    std::unique_ptr<UserModeDataDecorator> decorator(UserModeDataDecorator::create(*sparse, *userData));
+    std::unique_ptr<UserModeRelevanceCalculator> userCalc(
+        UserModeRelevanceCalculator::from(*decorator, userData->getRu(), 0.7)
+    );
+    checkMatrixFreeMatchesNaive(*decorator, *userCalc);
+
+    // Rows stored as maps have no raw storage and go through the calculator.
+    std::istringstream inputStream(matrixToString(SPARSE_DATA));
+    FromFileLineFactory getter(inputStream);
+    SparseDataRowFactory factory(SPARSE_DATA_TOTAL_COLUMNS);
+    std::unique_ptr<FullyLoadedData> mapRows(FullyLoadedData::load(factory, getter));
+    NaiveRelevanceCalculator mapCalc(*mapRows);
+    checkMatrixFreeMatchesNaive(*mapRows, mapCalc);
+}
+
+TEST_CASE("Kernel cache computes each entry once while it fits") {
+    std::unique_ptr<KernelCache> cache(KernelCache::create(1 << 16));
+    size_t computed = 0;
+    auto compute = [&computed](const size_t row, const size_t column) {
+        computed++;
+        return static_cast<float>(row * 1000 + column);
+    };
+
+    for (size_t repeat = 0; repeat < 2; repeat++) {
+        for (size_t row = 0; row < 20; row++) {
+            for (size_t column = 0; column <= row; column++) {
+                CHECK(cache->get(row, column, compute) == static_cast<float>(row * 1000 + column));
+            }
+        }
+    }
+
+    const size_t entries = 20 * 21 / 2;
+    const KernelCache::Counters counters(cache->getCounters());
+    CHECK(cache->getStorageBytes() <= 1 << 16);
+    CHECK(counters.evictions == 0);
+    CHECK(counters.misses == entries);
+    CHECK(counters.hits == entries);
+    CHECK(computed == entries);
+}
+
+TEST_CASE("Kernel cache counts every lookup of a team larger than it was sized for") {
+    const int maxThreads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    std::unique_ptr<KernelCache> cache(KernelCache::create(1 << 16));
+    omp_set_num_threads(maxThreads);
+
+    const size_t rows = 64;
+    const size_t repeats = 200;
+    #pragma omp parallel for num_threads(4)
+    for (size_t row = 0; row < rows; row++) {
+        for (size_t repeat = 0; repeat < repeats; repeat++) {
+            cache->get(row, 0, [](const size_t row, const size_t column) {
+                return static_cast<float>(row);
+            });
+        }
+    }
+
+    const KernelCache::Counters counters(cache->getCounters());
+    CHECK(counters.hits + counters.misses == rows * repeats);
+    CHECK(counters.misses >= rows);
+}
+
+TEST_CASE("Cached lazy kernel matrix stays within its budget under parallel reads") {
+    const size_t rows = 150;
+    const size_t columns = 40;
+    std::vector<std::vector<float>> raw(randomNormalRows(rows, columns, 5));
+
+    std::unique_ptr<DenseMatrixData> data(DenseMatrixData::load(raw));
+    NaiveRelevanceCalculator calc(*data);
+    const size_t budget = 4096;
+    std::unique_ptr<CachedLazyKernelMatrix> matrix(CachedLazyKernelMatrix::from(*data, calc, budget));
+    CHECK(matrix->getStorageBytes() <= budget);
+
+    const size_t repeats = 3;
+    size_t mismatches = 0;
+    #pragma omp parallel for reduction(+:mismatches)
+    for (size_t j = 0; j < rows; j++) {
+        for (size_t repeat = 0; repeat < repeats; repeat++) {
+            for (size_t i = 0; i < rows; i++) {
+                const float expected = calc.get(std::max(j, i), std::min(j, i));
+                mismatches += static_cast<size_t>(matrix->get(j, i) != expected);
+            }
+        }
+    }
+
+    const KernelCache::Counters counters(matrix->getCounters());
+    CHECK(mismatches == 0);
+    CHECK(counters.hits + counters.misses == rows * rows * repeats);
+    CHECK(counters.hits > 0);
+    CHECK(counters.evictions > 0);
+    CHECK(counters.evictions <= counters.misses);
+}
+
+static void checkBatchedRowsMatchGet(RelevanceCalculator &calc) {
+    const size_t n = calc.size();
+    std::vector<size_t> targets;
+    for (size_t j = 0; j < n; j += 3) {
+        targets.push_back(j);
+    }
+
+    std::vector<float> full(n);
+    std::vector<float> batch(targets.size());
+    for (size_t i = 0; i < n; i++) {
+        calc.getRow(i, full.data());
+        calc.getRow(i, targets.data(), targets.size(), batch.data());
+        for (size_t j = 0; j < n; j++) {
+            CHECK(full[j] == calc.get(i, j));
+        }
+        for (size_t t = 0; t < targets.size(); t++) {
+            CHECK(batch[t] == calc.get(i, targets[t]));
+        }
+    }
+}
+
+TEST_CASE("Batched relevance rows match single entries") {
+    const size_t rows = 90;
+    const size_t columns = 200;
+    std::vector<std::vector<float>> raw(randomNormalRows(rows, columns, 17, 0.1));
+
+    std::unique_ptr<DenseMatrixData> dense(DenseMatrixData::load(raw));
+    NaiveRelevanceCalculator denseCalc(*dense);
+    checkBatchedRowsMatchGet(denseCalc);
+
+    std::unique_ptr<CompressedSparseRowData> sparse(sparseRowsOf(raw));
+    NaiveRelevanceCalculator sparseCalc(*sparse);
+    checkBatchedRowsMatchGet(sparseCalc);
+
+    std::unique_ptr<UserData> userData(userDataFor({3, 17, 40, 41, 88}));
+    std::unique_ptr<UserModeDataDecorator> decorator(UserModeDataDecorator::create(*dense, *userData));
+    std::unique_ptr<UserModeRelevanceCalculator> userCalc(
+        UserModeRelevanceCalculator::from(*decorator, userData->getRu(), 0.7)
+    );
+    checkBatchedRowsMatchGet(*userCalc);
+
+    std::istringstream inputStream(matrixToString(SPARSE_DATA));
+    FromFileLineFactory getter(inputStream);
+    SparseDataRowFactory factory(SPARSE_DATA_TOTAL_COLUMNS);
+    std::unique_ptr<FullyLoadedData> mapRows(FullyLoadedData::load(factory, getter));
+    NaiveRelevanceCalculator mapCalc(*mapRows);
+    checkBatchedRowsMatchGet(mapCalc);
+
+    // Ids may run up to and including the column count, like the last column of SPARSE_DATA.
+    CompressedSparseRows edgeStorage(4);
+    const std::vector<std::vector<std::pair<unsigned int, float>>> edges{{{0, 1}, {4, 2}}, {{4, 3}}, {{1, 1}, {3, 5}}};
+    std::vector<size_t> edgeRowToGlobalRow;
+    for (const auto & row : edges) {
+        for (const auto & [column, value] : row) {
+            edgeStorage.push(column, value);
+        }
+        edgeStorage.finishRow();
+        edgeRowToGlobalRow.push_back(edgeRowToGlobalRow.size());
+    }
+    CompressedSparseRowData edgeRows(std::move(edgeStorage), std::move(edgeRowToGlobalRow), std::nullopt);
+    NaiveRelevanceCalculator edgeCalc(edgeRows);
+    checkBatchedRowsMatchGet(edgeCalc);
+    CHECK(edgeCalc.get(0, 1) == 6);
+}
+
+TEST_CASE("Column index rows match single entries") {
+    const size_t rows = 120;
+    const size_t columns = 250;
+    const std::vector<std::vector<float>> raw(randomNormalRows(rows, columns, 23, 0.05));
+
+    size_t nonZeros = 0;
+    for (const auto & row : raw) {
+        nonZeros += columns - std::count(row.begin(), row.end(), 0.0f);
+    }
+    std::unique_ptr<CompressedSparseRowData> sparse(sparseRowsOf(raw));
+    CHECK(sparse->getColumnIndex() == nullptr);
+    sparse->buildColumnIndex();
+
+    const InvertedColumnIndex* index = sparse->getColumnIndex();
+    REQUIRE(index != nullptr);
+    CHECK(index->totalRows() == rows);
+    CHECK(index->totalNonZeros() == nonZeros);
+    for (size_t c = 0; c < index->totalColumns(); c++) {
+        const unsigned int* postings = index->getPostings(c);
+        CHECK(std::is_sorted(postings, postings + index->getPostingCount(c)));
+    }
+
+    // Rows walked through the index add their products in the same order as get.
+    NaiveRelevanceCalculator calc(*sparse);
+    std::vector<size_t> everyRow(rows);
+    std::iota(everyRow.begin(), everyRow.end(), 0);
+    std::vector<float> full(rows);
+    std::vector<float> batch(rows);
+    for (size_t i = 0; i < rows; i++) {
+        calc.getRow(i, full.data());
+        calc.getRow(i, everyRow.data(), everyRow.size(), batch.data());
+        for (size_t j = 0; j < rows; j++) {
+            CHECK(full[j] == calc.get(i, j));
+            CHECK(batch[j] == full[j]);
+        }
+    }
+    checkBatchedRowsMatchGet(calc);
+    checkMatrixFreeMatchesNaive(*sparse, calc);
+
+    std::istringstream inputStream(matrixToString(SPARSE_DATA));
+    FromFileLineFactory getter(inputStream);
+    SparseDataRowFactory factory(SPARSE_DATA_TOTAL_COLUMNS);
+    std::unique_ptr<FullyLoadedData> mapRows(FullyLoadedData::load(factory, getter));
+    mapRows->buildColumnIndex();
+    NaiveRelevanceCalculator mapCalc(*mapRows);
+    checkBatchedRowsMatchGet(mapCalc);
+}
@@ -0,0 +1,191 @@
+#include <vector>
+#include <math.h>
+#include <omp.h>
+
+#include "kernel_matrix/relevance_calculator.h"
+#include "greedy_checkpoint.h"
+#include "../data_tools/simd_kernels.h"
+
+#ifndef LAZY_CHOLESKY_FACTORS_H
+#define LAZY_CHOLESKY_FACTORS_H
+
+/**
+ * The incremental Cholesky factors of fast greedy, kept per row and only brought up to date
+ * when a row is asked for. c_i holds k floats per row in one shared allocation, and entry t
+ * belongs to the t-th seed, so the overlap of two rows over the first t seeds is one
+ * contiguous dot product. A row only gets its slot the first time it is refreshed, so rows
+ * that are never looked at cost nothing.
+ *
+ * The diagonal of a row is its marginal gain as of its last refresh. A refresh can only lower
+ * it, and the value a row ends up with does not depend on when or in how many steps it was
+ * refreshed.
+ */
+class LazyCholeskyFactors {
+    private:
+    static const size_t NONE = -1;
+
+    RelevanceCalculator &calc;
+    const size_t width;
+    std::vector<size_t> slots;
+    std::vector<float> values;
+    std::vector<float> diagonals;
+
+    // The number of seeds every row has caught up with.
+    std::vector<size_t> u;
+    std::vector<size_t> seeds;
+
+    // One buffer of kernel entries per thread.
+    std::vector<std::vector<float>> kernelValues;
+
+    // Disable pass by value. This object is too large for pass by value to make sense implicitly.
+    LazyCholeskyFactors(const LazyCholeskyFactors &);
+
+    /**
+     * Gives row i its slot if it does not have one yet. Pointers from get are only stable
+     *  until the next row is touched.
+     */
+    void touch(const size_t i) {
+        if (this->slots[i] == NONE) {
+            this->slots[i] = this->values.size() / this->width;
+            this->values.resize(this->values.size() + this->width, 0);
+        }
+    }
+
+    float* get(const size_t i) {
+        return this->values.data() + this->slots[i] * this->width;
+    }
+
+    /**
+     * Only touches state that belongs to row i, so different rows can be refreshed
+     *  concurrently once each has its slot.
+     */
+    void refresh(const size_t i, std::vector<float> &kernelValues) {
+        float *c_i = this->get(i);
+
+        // Every entry off the diagonal is read exactly once, when row i catches up with a seed
+        // selected after its last update, so the entries are asked for in one batch per
+        // update instead of being kept in a kernel matrix.
+        kernelValues.resize(this->seeds.size() - this->u[i]);
+        this->calc.getRow(i, this->seeds.data() + this->u[i], kernelValues.size(), kernelValues.data());
+        for (size_t t = this->u[i]; t < this->seeds.size(); t++) {
+            const size_t j_t = this->seeds[t];
+            const float dotProduct = SimdKernels::dot(c_i, this->get(j_t), t);
+            const float sqrt = std::sqrt(this->diagonals[j_t]);
+            const float newScore = (kernelValues[t - this->u[i]] - dotProduct) / sqrt;
+            c_i[t] = newScore;
+            this->diagonals[i] -= std::pow(newScore, 2);
+        }
+
+        this->u[i] = this->seeds.size();
+    }
+
+    public:
+    /**
+     * Room for k seeds over the given rows. Reads the diagonal of every row up front.
+     */
+    LazyCholeskyFactors(RelevanceCalculator &calc, const size_t rows, const size_t k) :
+        calc(calc),
+        width(std::max<size_t>(1, std::min(k, rows))),
+        slots(rows, NONE),
+        diagonals(rows),
+        u(rows, 0),
+        kernelValues(omp_get_max_threads())
+    {
+        #pragma omp parallel for
+        for (size_t index = 0; index < rows; index++) {
+            this->diagonals[index] = calc.get(index, index);
+        }
+    }
+
+    /**
+     * The marginal gain of every row as of its last refresh, an upper bound on its gain now.
+     */
+    const std::vector<float> &getDiagonals() const {
+        return this->diagonals;
+    }
+
+    const std::vector<size_t> &getSeeds() const {
+        return this->seeds;
+    }
+
+    bool isStale(const size_t i) const {
+        return this->u[i] < this->seeds.size();
+    }
+
+    /**
+     * Brings every row in rows up to date with every seed, in parallel when there is more
+     *  than one row. Rows must be unique.
+     */
+    void refresh(const std::vector<size_t> &rows) {
+        // Slots are handed out before the refreshes so that no slot moves while rows are written.
+        for (const size_t i : rows) {
+            this->touch(i);
+        }
+
+        #pragma omp parallel for schedule(dynamic, 1) if(rows.size() > 1)
+        for (size_t r = 0; r < rows.size(); r++) {
+            this->refresh(rows[r], this->kernelValues[omp_get_thread_num()]);
+        }
+    }
+
+    /**
+     * Row i becomes the next seed. It must be up to date.
+     */
+    void addSeed(const size_t i) {
+        this->touch(i);
+        this->seeds.push_back(i);
+    }
+
+    /**
+     * The number of seeds row i has caught up with, for every row.
+     */
+    std::vector<uint64_t> getCaughtUp() const {
+        return std::vector<uint64_t>(this->u.begin(), this->u.end());
+    }
+
+    /**
+     * Writes the first u[i] entries of c_i for every row in order, the only entries a refresh 
+     *  ever reads.
+     */
+    void writeFactor(std::ostream &output) const {
+        for (size_t i = 0; i < this->u.size(); i++) {
+            if (this->u[i] > 0) {
+                output.write(reinterpret_cast<const char*>(this->values.data() + this->slots[i] * this->width), this->u[i] * sizeof(float));
+            }
+        }
+    }
+
+    size_t getFactorValues() const {
+        size_t total = 0;
+        for (const size_t caughtUp : this->u) {
+            total += caughtUp;
+        }
+
+        return total;
+    }
+
+    /**
+     * Picks up where the run that saved checkpoint left off. The checkpoint must be for the 
+     *  same rows and have fewer seeds than k.
+     */
+    void restore(const GreedyCheckpoint &checkpoint) {
+        this->diagonals = checkpoint.diagonals;
+        this->seeds = checkpoint.seeds;
+        this->u.assign(checkpoint.caughtUp.begin(), checkpoint.caughtUp.end());
+
+        const float *entries = checkpoint.factor.data();
+        for (size_t i = 0; i < this->u.size(); i++) {
+            if (this->u[i] > 0) {
+                this->touch(i);
+                std::copy(entries, entries + this->u[i], this->get(i));
+                entries += this->u[i];
+            }
+        }
+
+        for (const size_t seed : this->seeds) {
+            this->touch(seed);
+        }
+    }
+};
+
+#endif
@@ -1,70 +1,132 @@
 #include <vector>
 #include <math.h>
-#include <unordered_set>
-#include <unordered_map>
+#include <omp.h>
 #include <optional>
 
 #include "representative_subset_calculator.h"
+#include "lazy_cholesky_factors.h"
+#include "greedy_checkpoint.h"
 
 #ifndef LAZY_FAST_REPRESENTATIVE_SUBSET_CALCULATOR_H
 #define LAZY_FAST_REPRESENTATIVE_SUBSET_CALCULATOR_H
 
+/**
+ * Lazy fast greedy. Every row keeps an upper bound on its marginal gain, its diagonal as of 
+ * the last time it was refreshed, and rows are only brought up to date when they reach the 
+ * top of the heap. A row that is up to date and on top beats every other row, since no 
+ * refresh can raise a bound, so it is the next seed.
+ *
+ * In parallel mode each round refreshes a batch of the stale rows on top of the heap at once 
+ * instead of one. Refreshing a row early does not change its value, and ties go to the lower 
+ * row in both modes, so both select exactly the same seeds.
+ */
 class LazyFastSubsetCalculator : public SubsetCalculator {
     private:
     const float epsilon;
+    const bool parallel;
 
+    // Optional, resumes runs from a checkpoint and saves their progress.
+    const GreedyCheckpointer *checkpointer;
+
+    // Weight of the latest selection in the running count of refreshes per selection.
+    static constexpr double REFRESH_HISTORY_WEIGHT = 0.5;
+
+    /**
+     * Highest bound first, lowest row first on ties, so the order does not depend on the 
+     *  layout of the heap.
+     */
     struct HeapComparitor {
         const std::vector<float> &diagonals;
         HeapComparitor(const std::vector<float> &diagonals) : diagonals(diagonals) {}
         bool operator()(size_t a, size_t b) {
-            return diagonals[a] < diagonals[b];
+            return diagonals[a] < diagonals[b] || (diagonals[a] == diagonals[b] && a > b);
         }
     };
 
-    static std::vector<float> getSlice(
-        const std::unordered_map<size_t, float> &row, 
-        const std::vector<size_t>& subset, 
-        size_t count
-    ) {
-        std::vector<float> res(count);
-        for (size_t i = 0; i < count ; i++) {
-            res[i] = row.at(subset[i]);
+    /**
+     * How many rows the next round refreshes. Sequential mode refreshes one at a time. Parallel 
+     *  mode refreshes as many as recent selections needed, up to one per thread. A row 
+     *  refreshed before it was needed may never have been needed at all, so larger batches 
+     *  than the threads can work on at once only add work.
+     */
+    size_t getBatchSize(const double refreshesPerSelection) const {
+        if (!this->parallel) {
+            return 1;
         }
 
-        return res;
+        return std::max<size_t>(1, std::min<size_t>(omp_get_max_threads(), std::ceil(refreshesPerSelection)));
+    }
+
+    /**
+     * The heap is not saved. Its order only depends on the bounds and the rows in it, so it is 
+     *  rebuilt from the diagonals of the unselected rows.
+     */
+    void save(const BaseData &data, const LazyCholeskyFactors &factors, const std::vector<float> &gains) const {
+        this->checkpointer->save(
+            GreedyCheckpoint::buildHeader(GreedyCheckpoint::LAZY, data.totalRows(), data.totalColumns(), factors.getSeeds().size(), 0, factors.getFactorValues()),
+            factors.getSeeds(), 
+            gains, 
+            factors.getDiagonals(), 
+            factors.getCaughtUp(),
+            [&factors](std::ostream &output) {
+                factors.writeFactor(output);
+            }
+        );
     }
 
     public:
-    LazyFastSubsetCalculator(const float epsilon) : epsilon(epsilon) {
+    LazyFastSubsetCalculator(const float epsilon) : LazyFastSubsetCalculator(epsilon, false) {}
+
+    LazyFastSubsetCalculator(const float epsilon, const bool parallel) : epsilon(epsilon), parallel(parallel), checkpointer(nullptr) {
         if (this->epsilon < 0) {
             throw std::invalid_argument("Epsilon is less than 0.");
         }
     }
 
+    LazyFastSubsetCalculator(const float epsilon, const bool parallel, const GreedyCheckpointer &checkpointer) : 
+        LazyFastSubsetCalculator(epsilon, parallel) {
+        this->checkpointer = &checkpointer;
+    }
+
     std::unique_ptr<Subset> getApproximationSet(
         std::unique_ptr<MutableSubset> consumer, 
         RelevanceCalculator& calc,
         const BaseData &data, 
         size_t k
     ) {
-        
-        std::unordered_set<size_t> seen;
-        std::vector<std::unordered_map<size_t, float>> v(data.totalRows());
-        std::vector<size_t> u(data.totalRows(), 0);
-        
-        // Just needs to pass diag(e^(alpha * r_u)) for our per-user calc. Should be an opt 
-        // for the non-user case. For use during all kernel matrix opts
-        std::unique_ptr<LazyKernelMatrix> kernelMatrix(UnsafeLazyKernelMatrix::from(data, calc));
-        spdlog::debug("created lazy fast kernel matrix");
-        
-        // Account for user mode here
-        std::vector<float> diagonals = kernelMatrix->getDiagonals();
+        const GreedyCheckpoint *resume = this->checkpointer == nullptr ? nullptr : 
+            this->checkpointer->getResume(GreedyCheckpoint::LAZY, data.totalRows(), data.totalColumns());
+        if (resume != nullptr && resume->seeds.size() >= k) {
+            for (size_t t = 0; t < k; t++) {
+                consumer->addRow(resume->seeds[t], resume->gains[t]);
+            }
+
+            return MutableSubset::upcast(std::move(consumer));
+        }
+
+        LazyCholeskyFactors factors(calc, data.totalRows(), k);
+        const std::vector<float> &diagonals(factors.getDiagonals());
         spdlog::debug("got diagonals for lazy fast kernel");
+
+        // The gains the seeds so far were selected with, for checkpoints.
+        std::vector<float> gains;
+        std::vector<bool> selected(data.totalRows(), false);
+        if (resume != nullptr) {
+            factors.restore(*resume);
+            gains = resume->gains;
+            for (size_t t = 0; t < resume->seeds.size(); t++) {
+                consumer->addRow(resume->seeds[t], gains[t]);
+                selected[resume->seeds[t]] = true;
+            }
+            spdlog::info("resumed lazy fast greedy from a checkpoint of {0:d} seeds", resume->seeds.size());
+        }
         
         // Initialize priority queue
         std::vector<size_t> priorityQueue;
         for (size_t index = 0; index < data.totalRows(); index++) {
-            priorityQueue.push_back(index);
+            if (!selected[index]) {
+                priorityQueue.push_back(index);
+            }
         }
 
         HeapComparitor comparitor(diagonals);
@@ -72,53 +134,75 @@ class LazyFastSubsetCalculator : public SubsetCalculator {
 
         spdlog::debug("built priority queue");
 
-        std::vector<size_t> in_subset;
-
-        while (consumer->size() < k) {
-            const size_t i = priorityQueue.front();
-            std::pop_heap(priorityQueue.begin(),priorityQueue.end(), comparitor); 
-            priorityQueue.pop_back();
-            
-            // update row
-            for (size_t t = u[i]; t < consumer->size(); t++) {
-                const size_t j_t = in_subset[t]; 
-                const float dotProduct = KernelMatrix::getDotProduct(
-                    this->getSlice(v[i], in_subset, t), 
-                    this->getSlice(v[j_t], in_subset, t)
-                );
-                // account for user mode in ->get()
-                const float sqrt = std::sqrt(diagonals[j_t]);
-                const float newScore = (kernelMatrix->get(i, j_t) - dotProduct) / sqrt;
-                v[i].insert({j_t, newScore});                
-                diagonals[i] -= std::pow(v[i][j_t], 2);
-            }
-            
-            u[i] = consumer->size();
+        std::vector<size_t> batch;
+        double refreshesPerSelection = 0;
 
-            if (priorityQueue.size() == 0) {
-                spdlog::warn("Out of elements!");
-                break;
-            }
-            
-            const float marginalGain = diagonals[i];
-            const float nextScore = diagonals[priorityQueue.front()];
+        // Bounds of the rows refreshed since the last selection, from before their refresh.
+        std::vector<float> staleBounds;
+
+        while (consumer->size() < k && priorityQueue.size() > 0) {
+            const size_t top = priorityQueue.front();
+            if (!factors.isStale(top)) {
+                std::pop_heap(priorityQueue.begin(), priorityQueue.end(), comparitor); 
+                priorityQueue.pop_back();
 
-            if (marginalGain >= nextScore || consumer->size() == data.totalRows() - 1) {
+                if (priorityQueue.size() == 0) {
+                    spdlog::warn("Out of elements!");
+                    break;
+                }
+
+                const float marginalGain = diagonals[top];
                 if (marginalGain < this->epsilon) {
                     spdlog::warn("breaking to ensure Numerical stability; score of {0:f} and size {1:d} was less than {2:f}", marginalGain, consumer->size(), this->epsilon);
                     break;
                 }
 
-                SPDLOG_TRACE("added next row {0:d} of score {1:f}", i, marginalGain);
-                consumer->addRow(i, marginalGain);
-                in_subset.push_back(i);
-            } else {
+                // Sequential lazy greedy refreshes exactly the stale rows with a bound at or above 
+                //  the gain it selects. Counting only those keeps rows refreshed ahead of time 
+                //  from growing the next batches.
+                const size_t needed = std::count_if(staleBounds.begin(), staleBounds.end(), [marginalGain](const float bound) {
+                    return bound >= marginalGain;
+                });
+                refreshesPerSelection = REFRESH_HISTORY_WEIGHT * needed + (1 - REFRESH_HISTORY_WEIGHT) * refreshesPerSelection;
+                staleBounds.clear();
+
+                SPDLOG_TRACE("added next row {0:d} of score {1:f} after {2:d} needed refreshes", top, marginalGain, needed);
+                consumer->addRow(top, marginalGain);
+                factors.addSeed(top);
+                gains.push_back(marginalGain);
+
+                if (this->checkpointer != nullptr && this->checkpointer->isDue(gains.size())) {
+                    this->save(data, factors, gains);
+                }
+                continue;
+            }
+
+            const size_t batchSize = this->getBatchSize(refreshesPerSelection);
+            batch.clear();
+            while (batch.size() < batchSize && priorityQueue.size() > 0) {
+                batch.push_back(priorityQueue.front());
+                std::pop_heap(priorityQueue.begin(), priorityQueue.end(), comparitor); 
+                priorityQueue.pop_back();
+            }
+
+            for (const size_t i : batch) {
+                if (factors.isStale(i)) {
+                    staleBounds.push_back(diagonals[i]);
+                }
+            }
+            factors.refresh(batch);
+
+            for (const size_t i : batch) {
                 priorityQueue.push_back(i);
                 std::push_heap(priorityQueue.begin(), priorityQueue.end(), comparitor);
             }
         }
+
+        if (this->checkpointer != nullptr && this->checkpointer->isSaving()) {
+            this->save(data, factors, gains);
+        }
         return MutableSubset::upcast(std::move(consumer));
     }
 };
 
-#endif
\ No newline at end of file
+#endif
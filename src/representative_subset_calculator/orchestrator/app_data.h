@@ -1,5 +1,6 @@
 
 #include <string>
+#include <vector>
 
 #include <nlohmann/json.hpp>
 
@@ -21,12 +22,15 @@ struct AppData{
         size_t genCols = 0;
         float sparsity = DEFAULT_GENERATED_SPARSITY;
         long unsigned int seed = -1;
+        bool counterBased = false;
     } typedef GenerateInput;
 
     std::string outputFile;
     size_t outputSetSize;
     unsigned int adjacencyListColumnCount = 0;
     bool binaryInput = false;
+    bool buildRowIndex = false;
+    bool collectiveLoad = false;
     float epsilon = -1;
     unsigned int algorithm;
     unsigned int distributedAlgorithm = 2;
@@ -37,6 +41,14 @@ struct AppData{
     bool loadWhileStreaming = false;
     bool sendAllToReceiver = false;
     bool doNotNormalizeOnLoad = false;
+    bool columnIndex = false;
+    bool parallelLazy = false;
+    double stochasticEpsilon = 0.01;
+    unsigned long stochasticSeed = 0;
+    std::vector<size_t> kSweep;
+    std::string checkpointFile = NO_FILE_DEFAULT;
+    size_t checkpointInterval = 0;
+    std::string resumeFile = NO_FILE_DEFAULT;
     
     // user mode config
     std::string userModeFile = NO_FILE_DEFAULT;
@@ -55,6 +67,16 @@ struct AppData{
             {"epsilon", appData.epsilon},
             {"worldSize", appData.worldSize}
         };
+        if (appData.algorithm == 6) {
+            output["stochasticEpsilon"] = appData.stochasticEpsilon;
+            output["stochasticSeed"] = appData.stochasticSeed;
+        }
+        if (!appData.kSweep.empty()) {
+            output["kSweep"] = appData.kSweep;
+        }
+        if (appData.resumeFile != NO_FILE_DEFAULT) {
+            output["resumeFile"] = appData.resumeFile;
+        }
         return output;
     }
     
@@ -68,9 +90,13 @@ struct AppData{
             case 2:
                 return "fast greedy";
             case 3:
-                return "lazy fast greedy";
+                return appData.parallelLazy ? "parallel lazy fast greedy" : "lazy fast greedy";
             case 4:
                 return "streaming";
+            case 5:
+                return "matrix free fast greedy";
+            case 6:
+                return "stochastic greedy";
             default:
                 throw new std::invalid_argument("Could not find algorithm");
         }
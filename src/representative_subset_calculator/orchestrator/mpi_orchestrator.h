@@ -5,6 +5,7 @@
 #include "orchestrator.h"
 #include "../streaming/bucket_titrator.h"
 #include "../../data_tools/base_data.h"
+#include "../../data_tools/mpi_collective_loader.h"
 #include "../streaming/candidate_consumer.h"
 
 #ifndef MPI_ORCHESTRATOR_H
@@ -30,6 +31,20 @@ class MpiOrchestrator : public Orchestrator {
         return aggregateJsonAtZero(localTimerJson, worldRank, worldSize);
     }
 
+    static std::unique_ptr<BaseData> buildCollectiveTextData(
+        const AppData& appData, 
+        const std::vector<unsigned int> &rowToRank
+    ) {
+        return MpiCollectiveLoader::load(
+            appData.loadInput.inputFile, 
+            appData.adjacencyListColumnCount, 
+            !appData.doNotNormalizeOnLoad, 
+            rowToRank, 
+            appData.worldRank,
+            appData.worldSize
+        );
+    }
+
     private:
     static nlohmann::json aggregateJsonAtZero(
         const nlohmann::json json,
@@ -4,10 +4,16 @@
 #include<cstdlib>
 #include <random>
 #include <optional>
+#include <sstream>
+#include <filesystem>
 
 #include "../fast_representative_subset_calculator.h"
 #include "../lazy_fast_representative_subset_calculator.h"
+#include "../stochastic_representative_subset_calculator.h"
 #include "../timers/timers.h"
+#include "../../data_tools/binary_dataset.h"
+#include "../../data_tools/parallel_text_loader.h"
+#include "../../data_tools/row_index.h"
 #include "app_data.h"
 
 #ifndef ORCHESTRATOR_H
@@ -21,7 +27,9 @@ class Orchestrator {
             {"rows", data.totalRows()},
             {"columns", data.totalColumns()},
             {"sparsity", diagnostics.sparsity},
-            {"nonEmptyCells", diagnostics.numberOfNonEmptyCells}
+            {"nonEmptyCells", diagnostics.numberOfNonEmptyCells},
+            {"storageBytes", diagnostics.storageBytes},
+            {"bytesPerNonZero", diagnostics.numberOfNonEmptyCells == 0 ? 0.0 : (double)diagnostics.storageBytes / (double)diagnostics.numberOfNonEmptyCells}
         };
 
         return output;
@@ -35,6 +43,7 @@ class Orchestrator {
     ) {
         nlohmann::json output = buildOutputBase(appData, solution, data, timers);
         output.push_back({"timings", timers.outputToJson()});
+        output.push_back({"dataset", buildDatasetJson(data, appData)});
         return output;
     }
 
@@ -42,14 +51,22 @@ class Orchestrator {
         app.add_option("-o,--output", appData.outputFile, "Path to output file.")->required();
         app.add_option("-k,--outputSetSize", appData.outputSetSize, "Sets the desired size of the representative set.")->required();
         app.add_option("-e,--epsilon", appData.epsilon, "Only used for the fast greedy variants. Determines the threshold for when seed selection is terminated.");
-        app.add_option("-a,--algorithm", appData.algorithm, "Determines the seed selection algorithm. 0) naive, 1) lazy, 2) fast greedy, 3) lazy fast greedy");
+        app.add_option("-a,--algorithm", appData.algorithm, "Determines the seed selection algorithm. 0) naive, 1) lazy, 2) fast greedy, 3) lazy fast greedy, 5) matrix free fast greedy, 6) stochastic greedy");
         app.add_option("--adjacencyListColumnCount", appData.adjacencyListColumnCount, "To load an adjacnency list, set this value to the number of columns per row expected in the underlying matrix.");
         app.add_option("-n,--numberOfRows", appData.numberOfDataRows, "The number of total rows of data in your input file. This is needed to distribute work and is required for multi-machine mode");
-        app.add_flag("--loadBinary", appData.binaryInput, "Use this flag if you want to load a binary input file.");
+        app.add_flag("--loadBinary", appData.binaryInput, "Use this flag if your input file is a binary dataset. Binary datasets are memory mapped instead of parsed.");
         app.add_flag("--stopEarly", appData.stopEarly, "Used excusevly during streaming to stop the execution of the program early. If you use this in conjuntion with randgreedi, you will lose your approximation guarantee");
         app.add_option("-u,--userModeFile", appData.userModeFile, "Path to user mode data. Only set this if you are processing a dataset for a set of users.");
         app.add_option("--userModeTheta", appData.theta, "Only used during user mode. Sets the ratio of relevance to diveristy, where a value of 0.7 is a 70\% focuse on relevance.");
         app.add_flag("--doNotNormalizeOnLoad", appData.doNotNormalizeOnLoad, "Normalize on load");
+        app.add_flag("--columnIndex", appData.columnIndex, "Index the rows of a sparse dataset by column once it is loaded. Whole rows of similarities then only walk the rows that share a column, at the cost of a second copy of the non zeros.");
+        app.add_flag("--parallelLazy", appData.parallelLazy, "Only used with lazy fast greedy. Refreshes a batch of the stale rows on top of the heap at once with OpenMP instead of one row at a time. Selects the same rows.");
+        app.add_option("--stochasticEpsilon", appData.stochasticEpsilon, "Only used with stochastic greedy. Each step samples (n / k) * log(1 / stochasticEpsilon) rows, so smaller values sample more rows for a result closer to greedy. Must be between 0 and 1, defaults to 0.01.");
+        app.add_option("--stochasticSeed", appData.stochasticSeed, "Only used with stochastic greedy. Seeds the row sampling, the same seed always selects the same rows. Defaults to 0.");
+        app.add_option("--kSweep", appData.kSweep, "Comma separated sizes, such as 10,25,50,100. Runs once to the largest size and outputs the solution for every size, each the first rows of the largest one. Sizes must not be larger than k. Not supported by stochastic greedy.")->delimiter(',');
+        app.add_option("--checkpoint", appData.checkpointFile, "Only used with fast and lazy fast greedy on a single machine. Saves the state of the run to this path when it finishes, so a later run can resume from it with --resume.");
+        app.add_option("--checkpointInterval", appData.checkpointInterval, "Only used with --checkpoint. Also saves the state of the run every time this many seeds have been selected, so an interrupted run can resume. Defaults to 0, only saving at the end.");
+        app.add_option("--resume", appData.resumeFile, "Path to a checkpoint written by the same algorithm for the same dataset. Rejected when the input file, how it is loaded or normalized, or the user mode file or theta changed since. The run starts from its seeds instead of from scratch, and a k no larger than the checkpoint is answered without any new work.");
     
         CLI::App *loadInput = app.add_subcommand("loadInput", "loads the requested input from the provided path");
         CLI::App *genInput = app.add_subcommand("generateInput", "generates synthetic data");
@@ -59,6 +76,7 @@ class Orchestrator {
         genInput->add_option("--cols", appData.generateInput.genCols)->required();
         genInput->add_option("--sparsity", appData.generateInput.sparsity, "Note that edges are generated uniformly at random.");
         genInput->add_option("--seed", appData.generateInput.seed)->required();
+        genInput->add_flag("--counterBased", appData.generateInput.counterBased, "Draw numbers from a counter based generator, so any row can be generated without generating the rows before it and sparse rows cost time proportional to their edges. Generates a different dataset than the default for the same seed.");
 
         loadInput->add_option("-i,--input", appData.loadInput.inputFile, "Path to input file. Should contain data in row vector format.")->required();
     }
@@ -70,10 +88,144 @@ class Orchestrator {
         app.add_option("-T,--threeSieveT", appData.threeSieveT, "Only used for ThreeSieveStreaming.");
         app.add_option("--alpha", appData.alpha, "Only used for the truncated setting.");
         app.add_flag("--sendAllToReceiver", appData.sendAllToReceiver, "Enable this flag to skip the greedy calculation on the local nodes and to send all seeds directly to the receiver.");
+        app.add_flag("--buildRowIndex", appData.buildRowIndex, "Build a row index next to the input file if it does not have an up to date one. With a row index each rank only reads the rows assigned to it.");
+        app.add_flag("--collectiveLoad", appData.collectiveLoad, "Only used for text inputs. Each rank reads an equal share of the input with MPI-IO and sends every row it parsed to the rank that owns it, instead of every rank reading the whole input.");
         app.add_flag("--loadWhileStreaming", appData.loadWhileStreaming, "Only used during standalone streaming (or in conjunction with sendAllToReceiver). Only set this to true if your input dataset has already been randomized");
     }
 
-    static std::unique_ptr<SubsetCalculator> getCalculator(const AppData &appData) {
+    /**
+     * Sorts the sizes of a k sweep and shrinks k to the largest of them, which is the only size
+     *  the sweep runs to. Does nothing without a sweep.
+     */
+    static void resolveKSweep(AppData &appData) {
+        if (appData.kSweep.empty()) {
+            return;
+        }
+
+        // Stochastic greedy samples n / k rows a step, so its first rows for a smaller k are not its solution for that k.
+        if (appData.algorithm == 6) {
+            throw std::invalid_argument("kSweep is not supported by stochastic greedy (algorithm 6).");
+        }
+
+        std::sort(appData.kSweep.begin(), appData.kSweep.end());
+        appData.kSweep.erase(std::unique(appData.kSweep.begin(), appData.kSweep.end()), appData.kSweep.end());
+        if (appData.kSweep.front() == 0 || appData.kSweep.back() > appData.outputSetSize) {
+            throw std::invalid_argument("Every size in kSweep must be between 1 and k.");
+        }
+
+        appData.outputSetSize = appData.kSweep.back();
+    }
+
+    /**
+     * The consumer for a single solution, or for every size of the sweep when there is one.
+     */
+    static std::unique_ptr<MutableSubset> getConsumer(const AppData &appData) {
+        if (appData.kSweep.empty()) {
+            return NaiveMutableSubset::makeNew();
+        }
+
+        return KSweepSubset::create(NaiveMutableSubset::makeNew(), appData.kSweep);
+    }
+
+    /**
+     * The solutions to output for a solution built from getConsumer.
+     */
+    static std::vector<std::unique_ptr<Subset>> splitSolution(const AppData &appData, std::unique_ptr<Subset> solution) {
+        if (appData.kSweep.empty()) {
+            std::vector<std::unique_ptr<Subset>> solutions;
+            solutions.push_back(std::move(solution));
+            return solutions;
+        }
+
+        return KSweepSubset::from(*solution).getPrefixes();
+    }
+
+    /**
+     * Null unless the run saves a checkpoint or resumes from one.
+     */
+    static std::unique_ptr<GreedyCheckpointer> getCheckpointer(const AppData &appData) {
+        if (appData.checkpointFile == NO_FILE_DEFAULT && appData.resumeFile == NO_FILE_DEFAULT) {
+            return nullptr;
+        }
+
+        if (appData.algorithm != 2 && appData.algorithm != 3 && appData.algorithm != 5) {
+            throw std::invalid_argument("Checkpoints are only supported by fast greedy (algorithms 2 and 5) and lazy fast greedy (algorithm 3).");
+        }
+
+        return GreedyCheckpointer::create(
+            appData.checkpointFile == NO_FILE_DEFAULT ? "" : appData.checkpointFile, 
+            appData.checkpointInterval, 
+            appData.resumeFile == NO_FILE_DEFAULT ? "" : appData.resumeFile,
+            getCheckpointFingerprint(appData)
+        );
+    }
+
+    /**
+     * Covers every setting the kernel depends on: the input file as it is now, or the settings 
+     *  it was generated with, how it is loaded and normalized, and the user mode file and theta.
+     */
+    static uint64_t getCheckpointFingerprint(const AppData &appData) {
+        std::ostringstream description;
+        description << "input " << describeFile(appData.loadInput.inputFile)
+            << " binary " << appData.binaryInput
+            << " adjacencyListColumnCount " << appData.adjacencyListColumnCount
+            << " doNotNormalizeOnLoad " << appData.doNotNormalizeOnLoad
+            << " generationStrategy " << appData.generateInput.generationStrategy
+            << " genRows " << appData.generateInput.genRows
+            << " genCols " << appData.generateInput.genCols
+            << " sparsity " << appData.generateInput.sparsity
+            << " seed " << appData.generateInput.seed
+            << " counterBased " << appData.generateInput.counterBased
+            << " userModeFile " << describeFile(appData.userModeFile)
+            << " theta " << appData.theta;
+        return GreedyCheckpoint::fingerprint(description.str());
+    }
+
+    /**
+     * The absolute path, size and modification time of path, so a file that was replaced or 
+     *  edited in place describes differently. Just the path when it cannot be read.
+     */
+    static std::string describeFile(const std::string &path) {
+        if (path == NO_FILE_DEFAULT) {
+            return path;
+        }
+
+        std::error_code error;
+        const std::filesystem::path absolute(std::filesystem::absolute(path, error));
+        const uintmax_t bytes = std::filesystem::file_size(path, error);
+        if (error) {
+            return path;
+        }
+        const auto modified = std::filesystem::last_write_time(path, error);
+        if (error) {
+            return path;
+        }
+
+        return absolute.string() + " " + std::to_string(bytes) + " " + std::to_string(modified.time_since_epoch().count());
+    }
+
+    /**
+     * Same as getCalculator, but fast and lazy fast greedy resume from and save to checkpointer 
+     *  when it is not null.
+     */
+    static std::unique_ptr<SubsetCalculator> getCalculator(const AppData &appData, Timers &timers, const GreedyCheckpointer *checkpointer) {
+        if (checkpointer == nullptr) {
+            return getCalculator(appData, timers);
+        }
+
+        switch (appData.algorithm) {
+            case 2:
+                return std::unique_ptr<SubsetCalculator>(new FastSubsetCalculator(appData.epsilon, timers, *checkpointer));
+            case 3: 
+                return std::unique_ptr<SubsetCalculator>(new LazyFastSubsetCalculator(appData.epsilon, appData.parallelLazy, *checkpointer));
+            case 5:
+                return std::unique_ptr<SubsetCalculator>(new MatrixFreeFastSubsetCalculator(appData.epsilon, timers, *checkpointer));
+            default:
+                throw std::invalid_argument("Checkpoints are only supported by fast greedy (algorithms 2 and 5) and lazy fast greedy (algorithm 3).");
+        }
+    }
+
+    static std::unique_ptr<SubsetCalculator> getCalculator(const AppData &appData, Timers &timers) {
         if (appData.sendAllToReceiver) {
             spdlog::warn("rank {0:d} is going to send all seeds to receiver", appData.worldRank);
             return std::unique_ptr<SubsetCalculator>(new AddAllToSubsetCalculator());
@@ -85,9 +237,13 @@ class Orchestrator {
             case 1:
                 throw std::invalid_argument("The naive subset calculator is no longer supported and may not perform as expected. Use algorithm 3 or 2.");
             case 2:
-                return std::unique_ptr<SubsetCalculator>(new FastSubsetCalculator(appData.epsilon));
+                return std::unique_ptr<SubsetCalculator>(new FastSubsetCalculator(appData.epsilon, timers));
             case 3: 
-                return std::unique_ptr<SubsetCalculator>(new LazyFastSubsetCalculator(appData.epsilon));
+                return std::unique_ptr<SubsetCalculator>(new LazyFastSubsetCalculator(appData.epsilon, appData.parallelLazy));
+            case 5:
+                return std::unique_ptr<SubsetCalculator>(new MatrixFreeFastSubsetCalculator(appData.epsilon, timers));
+            case 6:
+                return std::unique_ptr<SubsetCalculator>(new StochasticSubsetCalculator(appData.epsilon, appData.stochasticEpsilon, appData.stochasticSeed, timers));
             default:
                 throw new std::invalid_argument("Could not find algorithm");
         }
@@ -135,6 +291,10 @@ class Orchestrator {
 
     static std::unique_ptr<RandomNumberGenerator> getRandomNumberGeneratorForEdges(const AppData& appData) {
         if (appData.generateInput.generationStrategy == 0) {
+            if (appData.generateInput.counterBased) {
+                return PhiloxNormalRandomNumberGenerator::create(appData.generateInput.seed);
+            }
+
             return NormalRandomNumberGenerator::create(appData.generateInput.seed);
         } else if (appData.generateInput.generationStrategy == 1) {
             if (appData.generateInput.sparsity == DEFAULT_GENERATED_SPARSITY) {
@@ -150,7 +310,15 @@ class Orchestrator {
     static std::unique_ptr<GeneratedLineFactory> getLineGenerator(const AppData& appData) {
         std::unique_ptr<RandomNumberGenerator> rng(getRandomNumberGeneratorForEdges(appData));
 
-        if (appData.generateInput.sparsity != DEFAULT_GENERATED_SPARSITY) {
+        if (appData.generateInput.sparsity != DEFAULT_GENERATED_SPARSITY && appData.generateInput.counterBased) {
+            return GeometricSparseLineFactory::create(
+                appData.generateInput.genRows,
+                appData.generateInput.genCols,
+                appData.generateInput.sparsity,
+                std::move(rng),
+                PhiloxUniformRandomNumberGenerator::create(appData.generateInput.seed + 1)
+            );
+        } else if (appData.generateInput.sparsity != DEFAULT_GENERATED_SPARSITY) {
             std::unique_ptr<RandomNumberGenerator> sparsityRng(UniformRandomNumberGenerator::create(appData.generateInput.seed + 1));
             return GeneratedSparseLineFactory::create(
                     appData.generateInput.genRows,
@@ -173,7 +341,7 @@ class Orchestrator {
         GeneratedLineFactory &getter,
         const std::vector<unsigned int> &rowToRank
     ) {
-        std::unique_ptr<DataRowFactory> factory(getDataRowFactory(appData));
+        std::unique_ptr<DataRowFactory> factory(getGeneratedDataRowFactory(appData));
         return LoadedSegmentedData::loadInParallel(*factory, getter, rowToRank, appData.worldRank);
     }
 
@@ -183,7 +351,11 @@ class Orchestrator {
         const std::vector<unsigned int> &rowToRank
     ) {
         std::unique_ptr<DataRowFactory> factory(getDataRowFactory(appData));
-        return LoadedSegmentedData::load(*factory, getter, rowToRank, appData.worldRank);
+        if (appData.adjacencyListColumnCount > 0) {
+            return CompressedSparseRowData::load(*factory, getter, appData.adjacencyListColumnCount, rowToRank, appData.worldRank);
+        }
+
+        return DenseMatrixData::load(*factory, getter, rowToRank, appData.worldRank);
     }
 
     static std::unique_ptr<BaseData> loadData(const AppData& appData, GeneratedLineFactory &getter) {
@@ -198,13 +370,101 @@ class Orchestrator {
         }
 
         std::unique_ptr<DataRowFactory> factory(getDataRowFactory(appData));
-        return FullyLoadedData::load(*factory, getter);
+        if (appData.adjacencyListColumnCount > 0) {
+            return CompressedSparseRowData::load(*factory, getter, appData.adjacencyListColumnCount);
+        }
+
+        return DenseMatrixData::load(*factory, getter);
+    }
+
+    /**
+     * Loads the text input file with every available thread.
+     */
+    static std::unique_ptr<BaseData> loadTextData(const AppData& appData) {
+        if (appData.numberOfDataRows > 0) {
+            std::vector<unsigned int> rowToRank(appData.numberOfDataRows, 0);
+            return buildMpiTextData(appData, rowToRank);
+        }
+
+        return ParallelTextLoader::load(
+            appData.loadInput.inputFile, 
+            appData.adjacencyListColumnCount, 
+            !appData.doNotNormalizeOnLoad
+        );
+    }
+
+    /**
+     * Seeks straight to the rows of this rank when the input has an up to date row index,
+     * otherwise scans the whole input.
+     */
+    static std::unique_ptr<BaseData> buildMpiTextData(
+        const AppData& appData, 
+        const std::vector<unsigned int> &rowToRank
+    ) {
+        std::optional<RowIndex> index(RowIndex::maybeLoad(appData.loadInput.inputFile, appData.adjacencyListColumnCount));
+        if (index.has_value()) {
+            spdlog::debug("rank {0:d} loading through the row index of {1}", appData.worldRank, appData.loadInput.inputFile);
+            return index.value().load(
+                appData.loadInput.inputFile, 
+                appData.adjacencyListColumnCount, 
+                !appData.doNotNormalizeOnLoad, 
+                rowToRank, 
+                appData.worldRank
+            );
+        }
+
+        return ParallelTextLoader::load(
+            appData.loadInput.inputFile, 
+            appData.adjacencyListColumnCount, 
+            !appData.doNotNormalizeOnLoad, 
+            rowToRank, 
+            appData.worldRank
+        );
+    }
+
+    static std::unique_ptr<BaseData> loadBinaryData(const AppData& appData) {
+        return BinaryDataset::load(appData.loadInput.inputFile, !appData.doNotNormalizeOnLoad);
+    }
+
+    static std::unique_ptr<BaseData> buildMpiBinaryData(
+        const AppData& appData, 
+        const std::vector<unsigned int> &rowToRank
+    ) {
+        return BinaryDataset::load(appData.loadInput.inputFile, !appData.doNotNormalizeOnLoad, rowToRank, appData.worldRank);
     }
 
     static std::unique_ptr<DataRowFactory> getDataRowFactory(const AppData& appData) {
         return getDataRowFactory(appData.adjacencyListColumnCount, !appData.doNotNormalizeOnLoad);
     }
 
+    /**
+     * Same as getDataRowFactory, but for rows read from getLineGenerator. Rows are built
+     * without formatting and parsing the generated lines whenever the generator and the
+     * factory agree on the input format.
+     */
+    static std::unique_ptr<DataRowFactory> getGeneratedDataRowFactory(const AppData& appData) {
+        const bool sparseGenerator = appData.generateInput.sparsity != DEFAULT_GENERATED_SPARSITY;
+        const bool sparseFactory = appData.adjacencyListColumnCount > 0;
+        if (sparseGenerator != sparseFactory) {
+            return getDataRowFactory(appData);
+        }
+
+        DataRowFactory *factory;
+        if (sparseFactory) {
+            factory = dynamic_cast<DataRowFactory*>(new GeneratedSparseDataRowFactory(appData.adjacencyListColumnCount));
+        } else {
+            factory = dynamic_cast<DataRowFactory*>(new GeneratedDenseDataRowFactory());
+        }
+
+        if (!appData.doNotNormalizeOnLoad) {
+            factory = new NormalizedDataRowFactory(
+                std::unique_ptr<DataRowFactory>(factory)
+            );
+        }
+
+        return std::unique_ptr<DataRowFactory>(factory);
+    }
+
     static std::unique_ptr<DataRowFactory> getDataRowFactory(
         const unsigned int columnCount,
         bool normalizeOnLoad) {
@@ -30,3 +30,30 @@ TEST_CASE("Testing the proper blocking of a dataset with an evenly divisible dat
         validateValidRanks(allRanks, appData.worldSize);
     }
 }
+
+TEST_CASE("Checkpoint fingerprints change with the dataset and its settings") {
+    const std::string path((std::filesystem::temp_directory_path() / "rastre_fingerprint_test.csv").string());
+    std::ofstream(path) << "1,2\n3,4\n";
+
+    AppData appData;
+    appData.loadInput.inputFile = path;
+    const uint64_t fingerprint = Orchestrator::getCheckpointFingerprint(appData);
+    CHECK(Orchestrator::getCheckpointFingerprint(appData) == fingerprint);
+
+    AppData otherTheta(appData);
+    otherTheta.theta = 0.5;
+    CHECK(Orchestrator::getCheckpointFingerprint(otherTheta) != fingerprint);
+
+    AppData notNormalized(appData);
+    notNormalized.doNotNormalizeOnLoad = true;
+    CHECK(Orchestrator::getCheckpointFingerprint(notNormalized) != fingerprint);
+
+    AppData userMode(appData);
+    userMode.userModeFile = path;
+    CHECK(Orchestrator::getCheckpointFingerprint(userMode) != fingerprint);
+
+    std::ofstream(path) << "1,2\n3,4\n5,6\n";
+    CHECK(Orchestrator::getCheckpointFingerprint(appData) != fingerprint);
+
+    std::filesystem::remove(path);
+}
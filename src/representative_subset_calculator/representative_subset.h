@@ -1,4 +1,5 @@
 #include <vector>
+#include <algorithm>
 #include <nlohmann/json.hpp>
 
 #ifndef REPRESENTATIVE_SUBSET_H
@@ -81,6 +82,110 @@ class NaiveMutableSubset : public MutableSubset {
     }
 };
 
+/**
+ * Records the score of the subset as it reaches each of the requested sizes. Greedy only ever
+ * appends rows, so the first k rows of a run to a larger size are the solution for size k,
+ * and one run to the largest size answers every smaller one.
+ */
+class KSweepSubset : public MutableSubset {
+    private:
+    std::unique_ptr<MutableSubset> delegate;
+
+    // Sorted and unique, scores[i] is the score at sizes[i] for every size reached so far.
+    const std::vector<size_t> sizes;
+    std::vector<float> scores;
+
+    KSweepSubset(std::unique_ptr<MutableSubset> delegate, std::vector<size_t> sizes) :
+        delegate(std::move(delegate)), sizes(std::move(sizes)) {}
+
+    public:
+    static std::unique_ptr<KSweepSubset> create(std::unique_ptr<MutableSubset> delegate, std::vector<size_t> sizes) {
+        std::sort(sizes.begin(), sizes.end());
+        sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+        if (sizes.empty() || sizes.front() == 0) {
+            throw std::invalid_argument("A k sweep needs at least one size and every size must be larger than 0.");
+        }
+
+        return std::unique_ptr<KSweepSubset>(new KSweepSubset(std::move(delegate), std::move(sizes)));
+    }
+
+    /**
+     * The sweep behind a solution built from a KSweepSubset consumer.
+     */
+    static const KSweepSubset &from(const Subset &solution) {
+        const KSweepSubset *sweep = dynamic_cast<const KSweepSubset*>(&solution);
+        if (sweep == nullptr) {
+            throw std::invalid_argument("Solution was not built from a k sweep.");
+        }
+
+        return *sweep;
+    }
+
+    void addRow(const size_t row, const float marginalGain) {
+        this->delegate->addRow(row, marginalGain);
+        if (this->scores.size() < this->sizes.size() && this->delegate->size() == this->sizes[this->scores.size()]) {
+            this->scores.push_back(this->delegate->getScore());
+        }
+    }
+
+    const std::vector<size_t> &getSizes() const {
+        return this->sizes;
+    }
+
+    /**
+     * The score at every requested size, in the order of getSizes. A run that stopped short of
+     *  a size is its own solution for that size, as a run to that size would have stopped at
+     *  the same row.
+     */
+    std::vector<float> getPrefixScores() const {
+        std::vector<float> prefixScores(this->scores);
+        prefixScores.resize(this->sizes.size(), this->getScore());
+        return prefixScores;
+    }
+
+    /**
+     * The solution for every requested size, in the order of getSizes.
+     */
+    std::vector<std::unique_ptr<Subset>> getPrefixes() const {
+        const std::vector<float> prefixScores(this->getPrefixScores());
+        std::vector<std::unique_ptr<Subset>> prefixes;
+        for (size_t i = 0; i < this->sizes.size(); i++) {
+            const size_t prefixSize = std::min(this->sizes[i], this->size());
+            prefixes.push_back(Subset::ofCopy(std::vector<size_t>(this->begin(), this->begin() + prefixSize), prefixScores[i]));
+        }
+
+        return prefixes;
+    }
+
+    float getScore() const {
+        return this->delegate->getScore();
+    }
+
+    size_t getRow(const size_t index) const {
+        return this->delegate->getRow(index);
+    }
+
+    size_t size() const {
+        return this->delegate->size();
+    }
+
+    const size_t* begin() const {
+        return this->delegate->begin();
+    }
+
+    const size_t* end() const {
+        return this->delegate->end();
+    }
+
+    nlohmann::json toJson() const {
+        return this->delegate->toJson();
+    }
+
+    void finalize() {
+        this->delegate->finalize();
+    }
+};
+
 std::unique_ptr<Subset> Subset::ofCopy(
     const std::vector<size_t> rows, 
     const float score
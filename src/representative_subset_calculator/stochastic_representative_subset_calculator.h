@@ -0,0 +1,149 @@
+#include <vector>
+#include <math.h>
+#include <random>
+#include <numeric>
+#include <algorithm>
+
+#include "representative_subset_calculator.h"
+#include "lazy_cholesky_factors.h"
+#include "timers/timers.h"
+
+#ifndef STOCHASTIC_REPRESENTATIVE_SUBSET_CALCULATOR_H
+#define STOCHASTIC_REPRESENTATIVE_SUBSET_CALCULATOR_H
+
+/**
+ * Stochastic greedy. Every step draws a fresh random sample of (n / k) * log(1 / sampleEpsilon)
+ * unselected rows and selects the one with the highest marginal gain, instead of looking at
+ * every row. Gains come from the same incremental Cholesky update as fast greedy, brought up
+ * to date only for the sampled rows. Every step evaluates n / sampleSize, about 
+ * k / log(1 / sampleEpsilon), times fewer gains than fast greedy, see getExpectedSpeedup. 
+ * The 1 - 1/e - sampleEpsilon bound of stochastic greedy only holds for monotone submodular 
+ * objectives, so it is not claimed for these gains. The same seed always selects the same 
+ * rows. Like fast greedy it stops early only once no unselected row has a gain of at least 
+ * epsilon.
+ */
+class StochasticSubsetCalculator : public SubsetCalculator {
+    private:
+    const float epsilon;
+    const double sampleEpsilon;
+    const unsigned long seed;
+
+    // Optional, records the sample size and expected speedup of every run.
+    Timers *timers;
+
+    public:
+    StochasticSubsetCalculator(const float epsilon, const double sampleEpsilon, const unsigned long seed) :
+        epsilon(epsilon), sampleEpsilon(sampleEpsilon), seed(seed), timers(nullptr) {
+        if (this->epsilon < 0) {
+            throw std::invalid_argument("Epsilon is less than 0.");
+        }
+        if (this->sampleEpsilon <= 0 || this->sampleEpsilon >= 1) {
+            throw std::invalid_argument("The sample epsilon of stochastic greedy must be between 0 and 1.");
+        }
+    }
+
+    StochasticSubsetCalculator(const float epsilon, const double sampleEpsilon, const unsigned long seed, Timers &timers) :
+        StochasticSubsetCalculator(epsilon, sampleEpsilon, seed) {
+        this->timers = &timers;
+    }
+
+    /**
+     * Rows evaluated per step, at least one and never more than there are.
+     */
+    static size_t getSampleSize(const size_t n, const size_t k, const double sampleEpsilon) {
+        if (n == 0 || k == 0) {
+            return 0;
+        }
+
+        const double sampleSize = std::ceil((double)n / (double)k * std::log(1.0 / sampleEpsilon));
+        return std::min(n, std::max<size_t>(1, sampleSize));
+    }
+
+    /**
+     * How many times fewer marginal gains a step evaluates than a step of fast greedy, which
+     *  evaluates every row.
+     */
+    static double getExpectedSpeedup(const size_t n, const size_t k, const double sampleEpsilon) {
+        const size_t sampleSize = getSampleSize(n, k, sampleEpsilon);
+        return sampleSize == 0 ? 1.0 : (double)n / (double)sampleSize;
+    }
+
+    std::unique_ptr<Subset> getApproximationSet(
+        std::unique_ptr<MutableSubset> consumer,
+        RelevanceCalculator& calc,
+        const BaseData &data,
+        size_t k
+    ) {
+        const size_t n = data.totalRows();
+        const size_t sampleSize = getSampleSize(n, k, this->sampleEpsilon);
+        const double expectedSpeedup = getExpectedSpeedup(n, k, this->sampleEpsilon);
+        spdlog::info("stochastic greedy samples {0:d} of {1:d} rows per step, an expected speedup of {2:f} over fast greedy", sampleSize, n, expectedSpeedup);
+        if (this->timers != nullptr) {
+            this->timers->recordStochasticSampling(sampleSize, expectedSpeedup);
+        }
+
+        LazyCholeskyFactors factors(calc, n, k);
+        const std::vector<float> &diagonals(factors.getDiagonals());
+
+        // Unselected rows. Each step shuffles its sample to the front.
+        std::vector<size_t> candidates(n);
+        std::iota(candidates.begin(), candidates.end(), 0);
+
+        std::mt19937_64 eng(this->seed);
+        std::vector<size_t> sample;
+
+        while (consumer->size() < k && candidates.size() > 0) {
+            const size_t stepSize = std::min(sampleSize, candidates.size());
+            for (size_t s = 0; s < stepSize; s++) {
+                std::uniform_int_distribution<size_t> pick(s, candidates.size() - 1);
+                std::swap(candidates[s], candidates[pick(eng)]);
+            }
+
+            sample.assign(candidates.begin(), candidates.begin() + stepSize);
+            factors.refresh(sample);
+
+            // Gains never increase, so sampled rows below epsilon can never be selected and are 
+            //  dropped, moving them past the end of the candidates. The rest of the sample stays in front.
+            const size_t kept = std::partition(
+                candidates.begin(), 
+                candidates.begin() + stepSize, 
+                [this, &diagonals](const size_t row) { return diagonals[row] >= this->epsilon; }
+            ) - candidates.begin();
+            for (size_t s = stepSize; s > kept; s--) {
+                std::swap(candidates[s - 1], candidates.back());
+                candidates.pop_back();
+            }
+
+            if (kept == 0) {
+                continue;
+            }
+
+            // Highest gain in the sample, lowest row first on ties.
+            size_t best = 0;
+            for (size_t s = 1; s < kept; s++) {
+                const float gain = diagonals[candidates[s]];
+                const float bestGain = diagonals[candidates[best]];
+                if (gain > bestGain || (gain == bestGain && candidates[s] < candidates[best])) {
+                    best = s;
+                }
+            }
+
+            const size_t row = candidates[best];
+            const float marginalGain = diagonals[row];
+            SPDLOG_TRACE("added next row {0:d} of score {1:f}", row, marginalGain);
+            consumer->addRow(row, marginalGain);
+            factors.addSeed(row);
+
+            std::swap(candidates[best], candidates.back());
+            candidates.pop_back();
+        }
+
+        if (consumer->size() < std::min(k, n)) {
+            spdlog::warn("breaking to ensure Numerical stability; every remaining row has a score less than {0:f} at size {1:d}", this->epsilon, consumer->size());
+        }
+
+        return MutableSubset::upcast(std::move(consumer));
+    }
+};
+
+#endif
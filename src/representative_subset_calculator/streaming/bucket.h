@@ -1,6 +1,8 @@
 #include <vector>
 #include <memory>
 
+#include "../../data_tools/row_kernels.h"
+
 #ifndef BUCKET_H
 #define BUCKET_H
 
@@ -8,9 +10,9 @@ class ThresholdBucket
 {
     private:
     std::unique_ptr<MutableSubset> solution;
-    std::unique_ptr<std::vector<const DataRow *>> solutionRows; 
+    std::unique_ptr<std::vector<RowRef>> solutionRows; 
     std::unique_ptr<std::vector<float>> d; 
-    std::unique_ptr<std::vector<std::unique_ptr<DenseDataRow>>> b; 
+    std::unique_ptr<std::vector<std::vector<float>>> b; 
 
     const float threshold;
     const int k;
@@ -22,18 +24,18 @@ class ThresholdBucket
         threshold(threshold), 
         k(k), 
         solution(NaiveMutableSubset::makeNew()), 
-        solutionRows(std::make_unique<std::vector<const DataRow *>>()),
+        solutionRows(std::make_unique<std::vector<RowRef>>()),
         d(std::make_unique<std::vector<float>>()),
-        b(std::make_unique<std::vector<std::unique_ptr<DenseDataRow>>>())
+        b(std::make_unique<std::vector<std::vector<float>>>())
     {}
 
     ThresholdBucket(
         const float threshold, 
         const int k, 
         std::unique_ptr<MutableSubset> nextSolution,
-        std::unique_ptr<std::vector<const DataRow *>> solutionRows,
+        std::unique_ptr<std::vector<RowRef>> solutionRows,
         std::unique_ptr<std::vector<float>> d,
-        std::unique_ptr<std::vector<std::unique_ptr<DenseDataRow>>> b
+        std::unique_ptr<std::vector<std::vector<float>>> b
     ) : 
         threshold(threshold), 
         k(k), 
@@ -73,21 +75,29 @@ class ThresholdBucket
     }
 
     bool attemptInsert(size_t rowIndex, const DataRow &data) {
+        return this->attemptInsert(rowIndex, RowRef::of(data));
+    }
+
+    /**
+     * For callers offering the same row to many buckets, so that its layout is resolved once.
+     */
+    bool attemptInsert(size_t rowIndex, const RowRef &data) {
         SPDLOG_TRACE("trying to insert seed {0:d} into bucket with threshold {1:f}", rowIndex, this->threshold);
         if (this->solution->size() >= this->k) {
             return false;
         }
         
         // TODO: Verify the correctness of the +1 here. This might not be right.
-        float d_i = std::sqrt(data.dotProduct(data) + 1);
-        std::unique_ptr<DenseDataRow> c_i(new DenseDataRow());
+        float d_i = std::sqrt(RowRef::dot(data, data) + 1);
+        std::vector<float> c_i;
+        c_i.reserve(this->solution->size());
 
         for (size_t j = 0; j < this->solution->size(); j++) {
             if (!this->passesThreshold(std::log(std::pow(d_i, 2)))) {
                 return false;
             }
-            const float e_i = (data.dotProduct(*(solutionRows->at(j))) - c_i->dotProduct(*b->at(j))) / d->at(j);
-            c_i->push_back(e_i);
+            const float e_i = (RowRef::dot(data, solutionRows->at(j)) - SimdKernels::dot(c_i.data(), b->at(j).data(), j)) / d->at(j);
+            c_i.push_back(e_i);
             d_i = std::sqrt(std::pow(d_i, 2) - std::pow(e_i, 2));
         }
         
@@ -96,7 +106,7 @@ class ThresholdBucket
         if (this->passesThreshold(marginal)) {
             SPDLOG_TRACE("seed {0:d} with mirginal of {1:f} passed threshold of {2:f}", rowIndex, marginal, this->threshold);
             this->solution->addRow(rowIndex, marginal);
-            this->solutionRows->push_back(&data);
+            this->solutionRows->push_back(data);
             this->d->push_back(d_i);
             this->b->push_back(std::move(c_i));
             return true;
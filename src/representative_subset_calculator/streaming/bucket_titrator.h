@@ -441,10 +441,11 @@ class SieveStreamingBucketTitrator : public BucketTitrator {
 
             // attempt insert seed in buckets
             bool seedInserted = false;
+            const RowRef seedRow(RowRef::of(seed->getData()));
             // #pragma omp parallel for num_threads(this->numThreads) reduction(||:seedInserted)
             for (size_t bucketIndex = 0; bucketIndex < this->buckets.size(); bucketIndex++) {
                 SPDLOG_TRACE("looking at bucket {0:d} with threshold {1:f} and seed {2:d}", bucketIndex, this->buckets[bucketIndex]->getThreshold(), seed->getRow());
-                seedInserted = this->buckets[bucketIndex]->attemptInsert(seed->getRow(), seed->getData()) || seedInserted;
+                seedInserted = this->buckets[bucketIndex]->attemptInsert(seed->getRow(), seedRow) || seedInserted;
             }
 
             if (seedInserted) {
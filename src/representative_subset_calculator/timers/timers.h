@@ -1,5 +1,6 @@
 #include <chrono>
 #include <vector>
+#include <algorithm>
 #include <nlohmann/json.hpp>
 
 #ifndef TIMERS_H
@@ -45,6 +46,34 @@ class Timers {
     SingleTimer waitingTime;
     SingleTimer firstSeedTime;
 
+    // Not a timer. The largest kernel matrix held at once, in bytes.
+    size_t kernelMatrixBytes = 0;
+
+    void recordKernelMatrixBytes(const size_t bytes) {
+        this->kernelMatrixBytes = std::max(this->kernelMatrixBytes, bytes);
+    }
+
+    // Not timers. Lookups into a bounded kernel cache, summed over every cache used.
+    size_t kernelCacheHits = 0;
+    size_t kernelCacheMisses = 0;
+    size_t kernelCacheEvictions = 0;
+
+    void recordKernelCache(const size_t hits, const size_t misses, const size_t evictions) {
+        this->kernelCacheHits += hits;
+        this->kernelCacheMisses += misses;
+        this->kernelCacheEvictions += evictions;
+    }
+
+    // Not timers. Rows sampled per step by the last stochastic greedy run, and how many times 
+    //  fewer gains that is than fast greedy evaluates.
+    size_t stochasticSampleSize = 0;
+    double stochasticExpectedSpeedup = 0;
+
+    void recordStochasticSampling(const size_t sampleSize, const double expectedSpeedup) {
+        this->stochasticSampleSize = sampleSize;
+        this->stochasticExpectedSpeedup = expectedSpeedup;
+    }
+
     nlohmann::json outputToJson() const {
         nlohmann::json output {
             {"barrierTime", barrierTime.getTotalTime()},
@@ -58,7 +87,13 @@ class Timers {
             {"insertSeedsTime", insertSeedsTimer.getTotalTime()},
             {"loadingDatasetTime", loadingDatasetTime.getTotalTime()},
             {"waitingTime", waitingTime.getTotalTime()},
-            {"firstSeedTime", firstSeedTime.getTotalTime()}
+            {"firstSeedTime", firstSeedTime.getTotalTime()},
+            {"kernelMatrixBytes", kernelMatrixBytes},
+            {"kernelCacheHits", kernelCacheHits},
+            {"kernelCacheMisses", kernelCacheMisses},
+            {"kernelCacheEvictions", kernelCacheEvictions},
+            {"stochasticSampleSize", stochasticSampleSize},
+            {"stochasticExpectedSpeedup", stochasticExpectedSpeedup}
         };
     
         return output;
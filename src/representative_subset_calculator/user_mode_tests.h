@@ -173,3 +173,35 @@ TEST_CASE("testing calculators with user-data") {
     CHECK(UserScore::calculateMRR(*userData, *translatedFast) > 0);
     CHECK(UserScore::calculateMRR(*userData, *translatedLazyFast) > 0);
 }
+
+TEST_CASE("User mode factory matches a calculator built from ru") {
+    std::unique_ptr<UserData> userData(UserDataImplementation::from(
+        11, 
+        5, 
+        std::vector<unsigned long long>({0, 4, 5}), 
+        std::vector<double>({2.1245, 1.125, 1.43123})));
+    std::unique_ptr<FullyLoadedData> data(FullyLoadedData::load(DENSE_DATA));
+    std::unique_ptr<UserModeDataDecorator> decorator(
+        UserModeDataDecorator::create(*data, *userData)
+    );
+    const double theta = 0.7;
+    std::unique_ptr<UserModeRelevanceCalculator> expected(
+        UserModeRelevanceCalculator::from(*decorator, userData->getRu(), theta)
+    );
+
+    UserModeNaiveRelevanceCalculatorFactory factory(*userData, theta);
+    for (size_t repeat = 0; repeat < 2; repeat++) {
+        std::unique_ptr<RelevanceCalculator> built(factory.build(*decorator));
+        for (size_t j = 0; j < decorator->totalRows(); j++) {
+            for (size_t i = 0; i < decorator->totalRows(); i++) {
+                CHECK(built->get(j, i) == expected->get(j, i));
+            }
+        }
+    }
+
+    for (size_t r = 0; r < decorator->totalRows(); r++) {
+        const size_t globalRow = decorator->getRemoteIndexForRow(r);
+        const float score = PerRowRelevanceCalculator::getScore(decorator->getRow(r), factory, globalRow);
+        CHECK(score == expected->get(r, r));
+    }
+}
@@ -19,6 +19,7 @@ int main(int argc, char** argv) {
     CLI11_PARSE(app, argc, argv);
     appData.worldRank = 0;
     appData.worldSize = 1;
+    Orchestrator::resolveKSweep(appData);
 
     Timers timers;
 
@@ -30,22 +31,23 @@ int main(int argc, char** argv) {
     // Put this somewhere more sane
     const unsigned int DEFAULT_VALUE = -1;
     
-    std::unique_ptr<LineFactory> getter;
-    std::ifstream inputFile;
-    if (appData.loadInput.inputFile != NO_FILE_DEFAULT) {
-        inputFile.open(appData.loadInput.inputFile);
-        getter = std::unique_ptr<FromFileLineFactory>(new FromFileLineFactory(inputFile));
+    std::unique_ptr<BaseData> data;
+    if (appData.binaryInput) {
+        data = Orchestrator::loadBinaryData(appData);
+    } else if (appData.loadInput.inputFile != NO_FILE_DEFAULT) {
+        data = Orchestrator::loadTextData(appData);
     } else if (appData.generateInput.seed != DEFAULT_VALUE) {
-        getter = Orchestrator::getLineGenerator(appData);
+        std::unique_ptr<GeneratedLineFactory> getter(Orchestrator::getLineGenerator(appData));
+        data = Orchestrator::loadData(appData, *getter.get());
     }
 
-    std::unique_ptr<BaseData> data(Orchestrator::loadData(appData, *getter.get()));
-    if (appData.loadInput.inputFile != NO_FILE_DEFAULT) {
-        inputFile.close();
-    } 
-
     spdlog::info("Finished loading dataset of size {0:d} ...", data->totalRows());
 
+    if (appData.columnIndex) {
+        data->buildColumnIndex();
+        spdlog::info("Built a column index of {0:d} non zeros ...", data->getColumnIndex()->totalNonZeros());
+    }
+
     std::vector<std::unique_ptr<UserData>> userData;
     if (appData.userModeFile != NO_FILE_DEFAULT) {
         userData = UserDataImplementation::load(appData.userModeFile);
@@ -58,10 +60,18 @@ int main(int argc, char** argv) {
 
     std::vector<std::unique_ptr<Subset>> solutions;
 
-    std::unique_ptr<SubsetCalculator> calculator(Orchestrator::getCalculator(appData));
+    std::unique_ptr<GreedyCheckpointer> checkpointer(Orchestrator::getCheckpointer(appData));
+    if (checkpointer != nullptr && userData.size() > 0) {
+        throw std::invalid_argument("Checkpoints hold the state of a single run and are not supported in user mode.");
+    }
+
+    std::unique_ptr<SubsetCalculator> calculator(Orchestrator::getCalculator(appData, timers, checkpointer.get()));
     if (userData.size() == 0) {
         NaiveRelevanceCalculator calc(*data);
-        solutions.push_back(calculator->getApproximationSet(NaiveMutableSubset::makeNew(), calc, *data, appData.outputSetSize));
+        solutions = Orchestrator::splitSolution(
+            appData, 
+            calculator->getApproximationSet(Orchestrator::getConsumer(appData), calc, *data, appData.outputSetSize)
+        );
         spdlog::info("Found solution of size {0:d} and score {1:f}", solutions.back()->size(), solutions.back()->getScore());
     } else {
         for (const auto & user : userData) {
@@ -70,9 +80,11 @@ int main(int argc, char** argv) {
             );
             std::unique_ptr<RelevanceCalculator> userCalc(UserModeRelevanceCalculator::from(*decorator, user->getRu(), appData.theta));
             std::unique_ptr<Subset> solution(calculator->getApproximationSet(
-                NaiveMutableSubset::makeNew(), *userCalc, *decorator, appData.outputSetSize)
+                Orchestrator::getConsumer(appData), *userCalc, *decorator, appData.outputSetSize)
             );
-            solutions.push_back(UserOutputInformationSubset::translate(std::move(solution), *user));
+            for (auto & userSolution : Orchestrator::splitSolution(appData, std::move(solution))) {
+                solutions.push_back(UserOutputInformationSubset::translate(std::move(userSolution), *user));
+            }
             spdlog::info("Found solution of size {0:d} and score {1:f}", solutions.back()->size(), solutions.back()->getScore());
         }
     }
@@ -28,14 +28,17 @@ std::pair<std::unique_ptr<Subset>, size_t> loadWhileCalculating(
     const std::optional<UserData*> user,
     Timers& timers
 ) { 
-    std::unique_ptr<DataRowFactory> factory(Orchestrator::getDataRowFactory(appData));
-
+    std::unique_ptr<DataRowFactory> factory;
     std::unique_ptr<LineFactory> getter;
+
+    // Read through a stream rather than a mapping, so pages of the input never count towards the reported peak RSS.
     std::ifstream inputFile;
     if (appData.loadInput.inputFile != NO_FILE_DEFAULT) {
+        factory = Orchestrator::getDataRowFactory(appData);
         inputFile.open(appData.loadInput.inputFile);
         getter = std::unique_ptr<FromFileLineFactory>(new FromFileLineFactory(inputFile));
     } else if (appData.generateInput.seed != DEFAULT_VALUE) {
+        factory = Orchestrator::getGeneratedDataRowFactory(appData);
         getter = Orchestrator::getLineGenerator(appData);
     }
 
@@ -83,14 +86,17 @@ std::pair<std::unique_ptr<Subset>, size_t> loadThenCalculate(
     const std::optional<UserData*> user,
     Timers& timers
 ) {
-    std::unique_ptr<DataRowFactory> factory(Orchestrator::getDataRowFactory(appData));
-
+    std::unique_ptr<DataRowFactory> factory;
     std::unique_ptr<LineFactory> getter;
+
+    // Read through a stream rather than a mapping, so pages of the input never count towards the reported peak RSS.
     std::ifstream inputFile;
     if (appData.loadInput.inputFile != NO_FILE_DEFAULT) {
+        factory = Orchestrator::getDataRowFactory(appData);
         inputFile.open(appData.loadInput.inputFile);
         getter = std::unique_ptr<FromFileLineFactory>(new FromFileLineFactory(inputFile));
     } else if (appData.generateInput.seed != DEFAULT_VALUE) {
+        factory = Orchestrator::getGeneratedDataRowFactory(appData);
         getter = Orchestrator::getLineGenerator(appData);
     }
 
@@ -178,6 +184,18 @@ int main(int argc, char** argv) {
     MpiOrchestrator::addMpiCmdOptions(app, appData);
     CLI11_PARSE(app, argc, argv);
 
+    if (appData.binaryInput) {
+        throw std::invalid_argument("Standalone streaming reads its input one row at a time and does not support --loadBinary.");
+    }
+
+    if (!appData.kSweep.empty()) {
+        throw std::invalid_argument("The first k rows of a streaming solution are not the streaming solution for k, so streaming does not support kSweep.");
+    }
+
+    if (appData.checkpointFile != NO_FILE_DEFAULT || appData.resumeFile != NO_FILE_DEFAULT) {
+        throw std::invalid_argument("Checkpoints are only supported by fast and lazy fast greedy.");
+    }
+
     Timers timers;
 
     spdlog::info("Starting standalone streaming...");
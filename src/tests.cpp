@@ -6,9 +6,14 @@
 #include "data_tools/data_row_visitor.h"
 #include "data_tools/to_binary_visitor.h"
 #include "data_tools/dot_product_visitor.h"
+#include "data_tools/simd_kernels.h"
 #include "data_tools/data_row.h"
 #include "data_tools/data_row_factory.h"
 #include "data_tools/base_data.h"
+#include "data_tools/binary_dataset.h"
+#include "data_tools/dataset_converter.h"
+#include "data_tools/parallel_text_loader.h"
+#include "data_tools/row_index.h"
 #include "representative_subset_calculator/timers/timers.h"
 #include "data_tools/user_mode_data.h"
 #include "representative_subset_calculator/kernel_matrix/relevance_calculator.h"
@@ -16,6 +21,8 @@
 #include "representative_subset_calculator/kernel_matrix/kernel_matrix.h"
 #include "representative_subset_calculator/fast_representative_subset_calculator.h"
 #include "representative_subset_calculator/lazy_fast_representative_subset_calculator.h"
+#include "representative_subset_calculator/stochastic_representative_subset_calculator.h"
+#include "representative_subset_calculator/greedy_checkpoint.h"
 #include "representative_subset_calculator/orchestrator/orchestrator.h"
 #include "representative_subset_calculator/memoryProfiler/MemUsage.h"
 #include "user_mode/user_score.h"
@@ -94,6 +101,48 @@ void checkSolutionsAreEquivalent(const Subset &a, const Subset &b) {
     CHECK(a.getScore() < b.getScore() + LARGEST_ACCEPTABLE_ERROR);
 }
 
+/**
+ * Rows of standard normal values drawn from seed. Below a density of 1 each value is kept 
+ *  with that probability and left at 0 otherwise.
+ */
+std::vector<std::vector<float>> randomNormalRows(const size_t rows, const size_t columns, const unsigned int seed, const float density = 1) {
+    std::default_random_engine eng(seed);
+    std::normal_distribution<float> distribution;
+    std::uniform_real_distribution<float> keep;
+    std::vector<std::vector<float>> raw(rows, std::vector<float>(columns, 0));
+    for (auto & row : raw) {
+        for (auto & v : row) {
+            if (density >= 1 || keep(eng) < density) {
+                v = distribution(eng);
+            }
+        }
+    }
+
+    return raw;
+}
+
+/**
+ * The non zeros of raw as compressed sparse rows, where local row r is global row r.
+ */
+std::unique_ptr<CompressedSparseRowData> sparseRowsOf(const std::vector<std::vector<float>> &raw) {
+    CompressedSparseRows storage(raw.empty() ? 0 : raw[0].size());
+    std::vector<size_t> localRowToGlobalRow;
+    for (const auto & row : raw) {
+        storage.append(DenseDataRowView(row.data(), row.size()));
+        localRowToGlobalRow.push_back(localRowToGlobalRow.size());
+    }
+
+    return std::make_unique<CompressedSparseRowData>(std::move(storage), std::move(localRowToGlobalRow), std::nullopt);
+}
+
+/**
+ * User data for up to six rows, each with a fixed relevance score.
+ */
+std::unique_ptr<UserData> userDataFor(const std::vector<unsigned long long> &rows) {
+    const std::vector<double> ru({2.1245, 1.125, 1.43123, 0.5, 0.9, 1.7});
+    return UserDataImplementation::from(11, 5, rows, std::vector<double>(ru.begin(), ru.begin() + rows.size()));
+}
+
 #include "representative_subset_calculator/correctness_comparison_tests.h"
 #include "data_tools/tests.h"
 